@@ -0,0 +1,353 @@
+#include "Benchmarks.h"
+#include "Perlin.h"
+#include "BuildingGrid.h"
+#include "BuildingBvh.h"
+#include "BuildingRegistry.h"
+
+#include <SDL2/SDL_log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	const int NOISE_GRID_SIZE = 1000;
+	const int NOISE_OCTAVES = 6;
+
+	const int GRID_BUILDING_COUNT = 100000;
+	const int GRID_QUERY_COUNT = 1000;
+
+	const int BVH_BUILDING_COUNT = 100000;
+	const int BVH_RAY_COUNT = 1000;
+
+	const int REGISTRY_SIZES[] = {10000, 100000, 1000000};
+	const int REGISTRY_BACKUP_SIZE = 4; // Texels per side of each building's terrain backup
+	const BuildingType REGISTRY_TYPE_COUNT = 5; // Types in the default catalogue
+
+	// The layout buildings had before BuildingRegistry
+	struct BuildingStruct
+	{
+		glm::vec3 position;
+		BuildingType type;
+		glm::vec3 color;
+		std::vector<float> originalTerrainHeights;
+	};
+
+	// Run the job until at least minDuration passed, and return the items processed per second
+	template <typename JobT>
+	double MeasureThroughput(long long itemsPerRun, JobT job)
+	{
+		const auto minDuration = std::chrono::milliseconds(200);
+
+		long long items = 0;
+		auto start = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::steady_clock::duration::zero();
+		do
+		{
+			job();
+			items += itemsPerRun;
+			elapsed = std::chrono::steady_clock::now() - start;
+		} while (elapsed < minDuration);
+
+		return items / std::chrono::duration<double>(elapsed).count();
+	}
+}
+
+std::string FormatBenchmarkResult(const BenchmarkResult &result)
+{
+	double rate = result.itemsPerSecond;
+	const char *prefix = "";
+	if (rate >= 1e6)
+	{
+		rate /= 1e6;
+		prefix = "M ";
+	}
+	else if (rate >= 1e3)
+	{
+		rate /= 1e3;
+		prefix = "k ";
+	}
+
+	char text[256];
+	std::snprintf(text, sizeof(text), "%s: %.2f %s%s/s (%.2fx)", result.name.c_str(), rate, prefix, result.unit.c_str(), result.speedup);
+	return text;
+}
+
+void LogBenchmarkResults(const char *title, const std::vector<BenchmarkResult> &results)
+{
+	for (const BenchmarkResult &result : results)
+	{
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "[%s] %s", title, FormatBenchmarkResult(result).c_str());
+	}
+}
+
+std::vector<BenchmarkResult> BenchmarkPerlinNoise()
+{
+	PerlinNoise pn(1234);
+	std::vector<BenchmarkResult> results;
+	volatile double sink = 0.0; // Keeps the scalar loop from being optimized away
+
+	results.push_back({"octaveNoise (double)", MeasureThroughput(NOISE_GRID_SIZE * NOISE_GRID_SIZE, [&]()
+																															{
+		double sum = 0.0;
+		for (int y = 0; y < NOISE_GRID_SIZE; ++y)
+		{
+			for (int x = 0; x < NOISE_GRID_SIZE; ++x)
+			{
+				sum += pn.octaveNoise(x * 0.005, y * 0.005, NOISE_OCTAVES, 0.5);
+			}
+		}
+		sink = sink + sum; })});
+
+	std::vector<float> row(NOISE_GRID_SIZE);
+	for (NoiseKernel kernel : {NoiseKernel::Scalar, NoiseKernel::SSE41, NoiseKernel::AVX2})
+	{
+		if (!PerlinNoise::KernelSupported(kernel))
+			continue;
+
+		std::string name = std::string("octaveNoiseSpan (") + PerlinNoise::KernelName(kernel) + ")";
+		results.push_back({name, MeasureThroughput(NOISE_GRID_SIZE * NOISE_GRID_SIZE, [&]()
+																							 {
+			for (int y = 0; y < NOISE_GRID_SIZE; ++y)
+			{
+				pn.octaveNoiseSpan(row.data(), NOISE_GRID_SIZE, 0.0f, 0.005f, y * 0.005f, NOISE_OCTAVES, 0.5f, kernel);
+			}
+			sink = sink + row[0]; })});
+	}
+
+	for (BenchmarkResult &result : results)
+	{
+		result.unit = "samples";
+		result.speedup = result.itemsPerSecond / results.front().itemsPerSecond;
+	}
+
+	LogBenchmarkResults("Perlin noise", results);
+	return results;
+}
+
+std::vector<BenchmarkResult> BenchmarkBuildingGrid()
+{
+	// Footprints of the sizes in the building catalogue, spread over the [-50, 50] world
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> extent(0.75f, 1.5f);
+
+	std::vector<glm::vec2> centers(GRID_BUILDING_COUNT);
+	std::vector<glm::vec2> halfSizes(GRID_BUILDING_COUNT);
+	BuildingGrid grid;
+	grid.Create(glm::vec2(-50.0f), glm::vec2(50.0f), 2.0f);
+	for (int i = 0; i < GRID_BUILDING_COUNT; ++i)
+	{
+		centers[i] = glm::vec2(position(rng), position(rng));
+		halfSizes[i] = glm::vec2(extent(rng), extent(rng)) * 0.5f;
+		grid.Insert(i, centers[i], halfSizes[i] * 2.0f);
+	}
+
+	std::vector<glm::vec2> queries(GRID_QUERY_COUNT);
+	for (glm::vec2 &query : queries)
+		query = glm::vec2(position(rng), position(rng));
+
+	const glm::vec2 queryHalfSize(0.5f);
+	std::vector<BenchmarkResult> results;
+	volatile int sink = 0;
+
+	results.push_back({"Linear scan", MeasureThroughput(GRID_QUERY_COUNT, [&]()
+																											{
+		int hits = 0;
+		for (const glm::vec2 &query : queries)
+		{
+			for (int i = 0; i < GRID_BUILDING_COUNT; ++i)
+			{
+				glm::vec2 distance = glm::abs(query - centers[i]);
+				if (distance.x < halfSizes[i].x + queryHalfSize.x && distance.y < halfSizes[i].y + queryHalfSize.y)
+				{
+					++hits;
+					break;
+				}
+			}
+		}
+		sink = sink + hits; })});
+
+	results.push_back({"BuildingGrid", MeasureThroughput(GRID_QUERY_COUNT, [&]()
+																											 {
+		int hits = 0;
+		for (const glm::vec2 &query : queries)
+			hits += grid.Overlaps(query - queryHalfSize, query + queryHalfSize) ? 1 : 0;
+		sink = sink + hits; })});
+
+	for (BenchmarkResult &result : results)
+	{
+		result.unit = "queries";
+		result.speedup = result.itemsPerSecond / results.front().itemsPerSecond;
+	}
+
+	LogBenchmarkResults("Building grid", results);
+	return results;
+}
+
+std::vector<BenchmarkResult> BenchmarkBuildingBvh()
+{
+	// Boxes of the sizes in the building catalogue, standing on the [-50, 50] world
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> extent(0.75f, 1.5f);
+
+	std::vector<glm::vec3> mins(BVH_BUILDING_COUNT);
+	std::vector<glm::vec3> maxs(BVH_BUILDING_COUNT);
+	BuildingBvh bvh;
+	for (int i = 0; i < BVH_BUILDING_COUNT; ++i)
+	{
+		glm::vec3 size(extent(rng), extent(rng) * 2.0f, extent(rng));
+		mins[i] = glm::vec3(position(rng), 0.0f, position(rng)) - glm::vec3(size.x, 0.0f, size.z) * 0.5f;
+		maxs[i] = mins[i] + size;
+		bvh.Insert(i, mins[i], maxs[i]);
+	}
+
+	// Slanted down from a camera height, ending at the ground
+	std::vector<glm::vec3> origins(BVH_RAY_COUNT);
+	std::vector<glm::vec3> directions(BVH_RAY_COUNT);
+	for (int i = 0; i < BVH_RAY_COUNT; ++i)
+	{
+		origins[i] = glm::vec3(position(rng), 30.0f, position(rng));
+		directions[i] = glm::vec3(position(rng) * 0.5f, -30.0f, position(rng) * 0.5f);
+	}
+
+	std::vector<BenchmarkResult> results;
+	volatile int sink = 0;
+
+	results.push_back({"Linear scan", MeasureThroughput(BVH_RAY_COUNT, [&]()
+																										 {
+		int hits = 0;
+		for (int r = 0; r < BVH_RAY_COUNT; ++r)
+		{
+			glm::vec3 inverseDirection = 1.0f / directions[r];
+			float nearest = 1.0f;
+			bool found = false;
+			for (int i = 0; i < BVH_BUILDING_COUNT; ++i)
+			{
+				glm::vec3 t0 = (mins[i] - origins[r]) * inverseDirection;
+				glm::vec3 t1 = (maxs[i] - origins[r]) * inverseDirection;
+				glm::vec3 tNear = glm::min(t0, t1);
+				glm::vec3 tFar = glm::max(t0, t1);
+				float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+				float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, nearest));
+				if (tEnter <= tExit && tEnter < nearest)
+				{
+					nearest = tEnter;
+					found = true;
+				}
+			}
+			hits += found ? 1 : 0;
+		}
+		sink = sink + hits; })});
+
+	results.push_back({"BuildingBvh", MeasureThroughput(BVH_RAY_COUNT, [&]()
+																										 {
+		int hits = 0;
+		for (int r = 0; r < BVH_RAY_COUNT; ++r)
+		{
+			uint32_t id;
+			float t;
+			hits += bvh.Raycast(origins[r], directions[r], 1.0f, id, t) ? 1 : 0;
+		}
+		sink = sink + hits; })});
+
+	for (BenchmarkResult &result : results)
+	{
+		result.unit = "rays";
+		result.speedup = result.itemsPerSecond / results.front().itemsPerSecond;
+	}
+
+	LogBenchmarkResults("Building BVH", results);
+	return results;
+}
+
+std::vector<BenchmarkResult> BenchmarkBuildingRegistry()
+{
+	std::vector<BenchmarkResult> results;
+	volatile std::size_t sink = 0;
+
+	const TerrainRect backupRect{0, 0, REGISTRY_BACKUP_SIZE, REGISTRY_BACKUP_SIZE};
+	const std::vector<float> backup(REGISTRY_BACKUP_SIZE * REGISTRY_BACKUP_SIZE, 0.5f);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+
+	for (int count : REGISTRY_SIZES)
+	{
+		std::vector<glm::vec3> positions(count);
+		for (glm::vec3 &position : positions)
+			position = glm::vec3(coordinate(rng), 0.0f, coordinate(rng));
+
+		const std::string size = count >= 1000000 ? std::to_string(count / 1000000) + "M" : std::to_string(count / 1000) + "k";
+		auto type = [](int i)
+		{ return static_cast<BuildingType>(i) % REGISTRY_TYPE_COUNT; };
+
+		// Both containers are rebuilt from empty, like a world being filled
+		BenchmarkResult structPlacement{"Struct placement, " + size, MeasureThroughput(count, [&]()
+																																										{
+			std::vector<BuildingStruct> buildings;
+			for (int i = 0; i < count; ++i)
+			{
+				BuildingStruct building;
+				building.position = positions[i];
+				building.type = type(i);
+				building.color = glm::vec3(1.0f);
+				building.originalTerrainHeights = backup;
+				buildings.push_back(std::move(building));
+			}
+			sink = sink + buildings.size(); })};
+
+		BenchmarkResult registryPlacement{"Registry placement, " + size, MeasureThroughput(count, [&]()
+																																												{
+			BuildingRegistry registry;
+			for (int i = 0; i < count; ++i)
+			{
+				uint32_t id = registry.Add(type(i), positions[i], glm::vec3(1.0f), glm::vec2(1.0f));
+				registry.SetTerrainBackup(id, backupRect, backup.data(), TerrainRect(), nullptr);
+			}
+			sink = sink + registry.GetCount(); })};
+
+		// Count the buildings in a box, which only needs the positions
+		std::vector<BuildingStruct> structs(count);
+		BuildingRegistry registry;
+		for (int i = 0; i < count; ++i)
+		{
+			structs[i].position = positions[i];
+			structs[i].type = type(i);
+			structs[i].originalTerrainHeights = backup;
+			uint32_t id = registry.Add(type(i), positions[i], glm::vec3(1.0f), glm::vec2(1.0f));
+			registry.SetTerrainBackup(id, backupRect, backup.data(), TerrainRect(), nullptr);
+		}
+
+		auto inBox = [](const glm::vec3 &position)
+		{ return position.x > -10.0f && position.x < 10.0f && position.z > -10.0f && position.z < 10.0f; };
+
+		BenchmarkResult structScan{"Struct scan, " + size, MeasureThroughput(count, [&]()
+																																			{
+			std::size_t inside = 0;
+			for (const BuildingStruct &building : structs)
+				inside += inBox(building.position) ? 1 : 0;
+			sink = sink + inside; })};
+
+		BenchmarkResult registryScan{"Registry scan, " + size, MeasureThroughput(count, [&]()
+																																					{
+			std::size_t inside = 0;
+			for (const glm::vec3 &position : registry.GetPositions())
+				inside += inBox(position) ? 1 : 0;
+			sink = sink + inside; })};
+
+		registryPlacement.speedup = registryPlacement.itemsPerSecond / structPlacement.itemsPerSecond;
+		registryScan.speedup = registryScan.itemsPerSecond / structScan.itemsPerSecond;
+		for (BenchmarkResult *result : {&structPlacement, &registryPlacement, &structScan, &registryScan})
+		{
+			result->unit = "buildings";
+			results.push_back(*result);
+		}
+	}
+
+	LogBenchmarkResults("Building registry", results);
+	return results;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Microbenchmarks that can be started from the GUI, results are also written to the log
+struct BenchmarkResult
+{
+	std::string name;
+	double itemsPerSecond = 0.0;
+	std::string unit = "items";
+	double speedup = 1.0; // Relative to the baseline of the same comparison
+};
+
+// "name: 12.34 M<unit>/s (1.50x)", with the rate scaled to a readable prefix
+std::string FormatBenchmarkResult(const BenchmarkResult &result);
+void LogBenchmarkResults(const char *title, const std::vector<BenchmarkResult> &results);
+
+// Octave noise over a 1000x1000 grid: the scalar double octaveNoise against the batch kernels
+std::vector<BenchmarkResult> BenchmarkPerlinNoise();
+
+// Collision queries against 100k random footprints: a linear scan against BuildingGrid
+std::vector<BenchmarkResult> BenchmarkBuildingGrid();
+
+// Nearest hit of rays from above the map against 100k random building boxes: a linear scan against BuildingBvh
+std::vector<BenchmarkResult> BenchmarkBuildingBvh();
+
+// Placement and position scans at 10k/100k/1M buildings: per-building structs owning their
+// terrain backup vector against BuildingRegistry's columns and height arena
+std::vector<BenchmarkResult> BenchmarkBuildingRegistry();
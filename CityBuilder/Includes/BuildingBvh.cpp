@@ -0,0 +1,381 @@
+#include "BuildingBvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// The cost of a box is the chance that a random ray hits it, which goes with its surface area
+	float SurfaceArea(const glm::vec3 &min, const glm::vec3 &max)
+	{
+		glm::vec3 size = max - min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	float SurfaceAreaOfUnion(const glm::vec3 &minA, const glm::vec3 &maxA, const glm::vec3 &minB, const glm::vec3 &maxB)
+	{
+		return SurfaceArea(glm::min(minA, minB), glm::max(maxA, maxB));
+	}
+
+	// Entry of the ray into the box, false if it misses it or only enters at or after maxT
+	bool IntersectRay(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &origin, const glm::vec3 &direction,
+										const glm::vec3 &inverseDirection, float maxT, float &tEnter)
+	{
+		tEnter = 0.0f;
+		float tExit = maxT;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// A ray parallel to the slab is inside it everywhere or nowhere
+			if (direction[axis] == 0.0f)
+			{
+				if (origin[axis] < min[axis] || origin[axis] > max[axis])
+					return false;
+				continue;
+			}
+
+			float t0 = (min[axis] - origin[axis]) * inverseDirection[axis];
+			float t1 = (max[axis] - origin[axis]) * inverseDirection[axis];
+			tEnter = std::max(tEnter, std::min(t0, t1));
+			tExit = std::min(tExit, std::max(t0, t1));
+		}
+		return tEnter <= tExit && tEnter < maxT;
+	}
+
+	bool Overlaps(const glm::vec3 &minA, const glm::vec3 &maxA, const glm::vec3 &minB, const glm::vec3 &maxB)
+	{
+		return minA.x <= maxB.x && minB.x <= maxA.x && minA.y <= maxB.y && minB.y <= maxA.y && minA.z <= maxB.z && minB.z <= maxA.z;
+	}
+}
+
+void BuildingBvh::Insert(uint32_t id, const glm::vec3 &min, const glm::vec3 &max)
+{
+	Remove(id);
+	if (id >= m_leafOfId.size())
+		m_leafOfId.resize(id + 1, NO_NODE);
+
+	int leaf = AllocateNode();
+	m_nodes[leaf].min = min;
+	m_nodes[leaf].max = max;
+	m_nodes[leaf].id = id;
+	m_leafOfId[id] = leaf;
+	++m_count;
+
+	if (m_root == NO_NODE)
+	{
+		m_root = leaf;
+		return;
+	}
+
+	// Pairing the leaf with a node adds a parent around both and grows every ancestor. Go down while a child
+	// promises to be cheaper than pairing here; the ancestors grow by the same amount either way
+	int sibling = m_root;
+	while (!m_nodes[sibling].IsLeaf())
+	{
+		const Node &node = m_nodes[sibling];
+		float area = SurfaceArea(node.min, node.max);
+		float combinedArea = SurfaceAreaOfUnion(node.min, node.max, min, max);
+		float pairCost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int c = 0; c < 2; ++c)
+		{
+			const Node &child = m_nodes[node.children[c]];
+			float grownArea = SurfaceAreaOfUnion(child.min, child.max, min, max);
+			childCosts[c] = (child.IsLeaf() ? grownArea : grownArea - SurfaceArea(child.min, child.max)) + inheritedCost;
+		}
+
+		if (pairCost <= childCosts[0] && pairCost <= childCosts[1])
+			break;
+		sibling = node.children[childCosts[0] <= childCosts[1] ? 0 : 1];
+	}
+
+	int oldParent = m_nodes[sibling].parent;
+	int parent = AllocateNode();
+	m_nodes[parent].parent = oldParent;
+	m_nodes[parent].children[0] = sibling;
+	m_nodes[parent].children[1] = leaf;
+	m_nodes[sibling].parent = parent;
+	m_nodes[leaf].parent = parent;
+	if (oldParent == NO_NODE)
+		m_root = parent;
+	else
+		m_nodes[oldParent].children[m_nodes[oldParent].children[0] == sibling ? 0 : 1] = parent;
+
+	Refit(parent);
+}
+
+void BuildingBvh::Remove(uint32_t id)
+{
+	if (id >= m_leafOfId.size() || m_leafOfId[id] == NO_NODE)
+		return;
+
+	int leaf = m_leafOfId[id];
+	m_leafOfId[id] = NO_NODE;
+	--m_count;
+
+	if (leaf == m_root)
+	{
+		m_root = NO_NODE;
+		FreeNode(leaf);
+		return;
+	}
+
+	// The sibling takes the parent's place
+	int parent = m_nodes[leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = m_nodes[parent].children[m_nodes[parent].children[0] == leaf ? 1 : 0];
+	m_nodes[sibling].parent = grandParent;
+	if (grandParent == NO_NODE)
+	{
+		m_root = sibling;
+	}
+	else
+	{
+		m_nodes[grandParent].children[m_nodes[grandParent].children[0] == parent ? 0 : 1] = sibling;
+		Refit(grandParent);
+	}
+
+	FreeNode(parent);
+	FreeNode(leaf);
+}
+
+void BuildingBvh::Clear()
+{
+	m_nodes.clear();
+	m_freeNodes.clear();
+	m_leafOfId.clear();
+	m_root = NO_NODE;
+	m_count = 0;
+}
+
+int BuildingBvh::GetDepth() const
+{
+	if (m_root == NO_NODE)
+		return 0;
+
+	int depth = 0;
+	std::vector<std::pair<int, int>> stack = {{m_root, 1}};
+	while (!stack.empty())
+	{
+		auto [index, nodeDepth] = stack.back();
+		stack.pop_back();
+		depth = std::max(depth, nodeDepth);
+		if (!m_nodes[index].IsLeaf())
+		{
+			stack.push_back({m_nodes[index].children[0], nodeDepth + 1});
+			stack.push_back({m_nodes[index].children[1], nodeDepth + 1});
+		}
+	}
+	return depth;
+}
+
+bool BuildingBvh::Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxT, uint32_t &id, float &t) const
+{
+	if (m_root == NO_NODE)
+		return false;
+
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	float tRoot;
+	if (!IntersectRay(m_nodes[m_root].min, m_nodes[m_root].max, origin, direction, inverseDirection, maxT, tRoot))
+		return false;
+
+	// Nodes with the distance the ray enters them, a node is skipped if a nearer hit turned up since it was pushed
+	bool found = false;
+	float nearest = maxT;
+	std::vector<std::pair<int, float>> stack = {{m_root, tRoot}};
+	while (!stack.empty())
+	{
+		auto [index, tEnter] = stack.back();
+		stack.pop_back();
+		if (tEnter >= nearest)
+			continue;
+
+		const Node &node = m_nodes[index];
+		if (node.IsLeaf())
+		{
+			nearest = tEnter;
+			id = node.id;
+			found = true;
+			continue;
+		}
+
+		// The nearer child goes on top, so it is searched first
+		float tChildren[2];
+		bool hits[2];
+		for (int c = 0; c < 2; ++c)
+		{
+			const Node &child = m_nodes[node.children[c]];
+			hits[c] = IntersectRay(child.min, child.max, origin, direction, inverseDirection, nearest, tChildren[c]);
+		}
+		int first = hits[0] && hits[1] && tChildren[1] < tChildren[0] ? 1 : 0;
+		for (int c : {1 - first, first})
+		{
+			if (hits[c])
+				stack.push_back({node.children[c], tChildren[c]});
+		}
+	}
+
+	if (found)
+		t = nearest;
+	return found;
+}
+
+bool BuildingBvh::IntersectsSegment(const glm::vec3 &a, const glm::vec3 &b) const
+{
+	if (m_root == NO_NODE)
+		return false;
+
+	const glm::vec3 direction = b - a;
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	std::vector<int> stack = {m_root};
+	while (!stack.empty())
+	{
+		const Node &node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		// The end of the segment counts as touching
+		float tEnter;
+		if (!IntersectRay(node.min, node.max, a, direction, inverseDirection, std::nextafter(1.0f, 2.0f), tEnter))
+			continue;
+		if (node.IsLeaf())
+			return true;
+		stack.push_back(node.children[0]);
+		stack.push_back(node.children[1]);
+	}
+	return false;
+}
+
+void BuildingBvh::QueryBox(const glm::vec3 &min, const glm::vec3 &max, std::vector<uint32_t> &ids) const
+{
+	if (m_root == NO_NODE)
+		return;
+
+	std::vector<int> stack = {m_root};
+	while (!stack.empty())
+	{
+		const Node &node = m_nodes[stack.back()];
+		stack.pop_back();
+		if (!Overlaps(node.min, node.max, min, max))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			ids.push_back(node.id);
+			continue;
+		}
+		stack.push_back(node.children[0]);
+		stack.push_back(node.children[1]);
+	}
+}
+
+void BuildingBvh::QueryZone(const BuildingZone &zone, std::vector<uint32_t> &ids) const
+{
+	if (m_root == NO_NODE || zone.corners.size() < 3)
+		return;
+
+	// Only the nodes over the zone's bounds can hold a center inside it
+	glm::vec2 zoneMin(INFINITY);
+	glm::vec2 zoneMax(-INFINITY);
+	for (const glm::vec2 &corner : zone.corners)
+	{
+		zoneMin = glm::min(zoneMin, corner);
+		zoneMax = glm::max(zoneMax, corner);
+	}
+
+	std::vector<int> stack = {m_root};
+	while (!stack.empty())
+	{
+		const Node &node = m_nodes[stack.back()];
+		stack.pop_back();
+		if (node.max.x < zoneMin.x || node.min.x > zoneMax.x || node.max.z < zoneMin.y || node.min.z > zoneMax.y)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			glm::vec3 center = (node.min + node.max) * 0.5f;
+			if (zone.Contains(glm::vec2(center.x, center.z)))
+				ids.push_back(node.id);
+			continue;
+		}
+		stack.push_back(node.children[0]);
+		stack.push_back(node.children[1]);
+	}
+}
+
+int BuildingBvh::AllocateNode()
+{
+	if (!m_freeNodes.empty())
+	{
+		int node = m_freeNodes.back();
+		m_freeNodes.pop_back();
+		m_nodes[node] = Node();
+		return node;
+	}
+
+	m_nodes.push_back(Node());
+	return static_cast<int>(m_nodes.size()) - 1;
+}
+
+void BuildingBvh::FreeNode(int node)
+{
+	m_freeNodes.push_back(node);
+}
+
+void BuildingBvh::Refit(int node)
+{
+	while (node != NO_NODE)
+	{
+		Rotate(node);
+
+		Node &current = m_nodes[node];
+		const Node &left = m_nodes[current.children[0]];
+		const Node &right = m_nodes[current.children[1]];
+		current.min = glm::min(left.min, right.min);
+		current.max = glm::max(left.max, right.max);
+		node = current.parent;
+	}
+}
+
+void BuildingBvh::Rotate(int node)
+{
+	// A child swapping places with a grandchild on the other side leaves node's box as it is, but the other child
+	// shrinks if the child fits the remaining grandchild better than the one it replaces
+	float bestGain = 0.0f;
+	int bestChild = -1;
+	int bestGrandchild = -1;
+	for (int c = 0; c < 2; ++c)
+	{
+		const Node &child = m_nodes[m_nodes[node].children[c]];
+		const Node &other = m_nodes[m_nodes[node].children[1 - c]];
+		if (other.IsLeaf())
+			continue;
+
+		float otherArea = SurfaceArea(other.min, other.max);
+		for (int g = 0; g < 2; ++g)
+		{
+			const Node &kept = m_nodes[other.children[1 - g]];
+			float gain = otherArea - SurfaceAreaOfUnion(child.min, child.max, kept.min, kept.max);
+			if (gain > bestGain)
+			{
+				bestGain = gain;
+				bestChild = c;
+				bestGrandchild = g;
+			}
+		}
+	}
+	if (bestChild < 0)
+		return;
+
+	int child = m_nodes[node].children[bestChild];
+	int other = m_nodes[node].children[1 - bestChild];
+	int grandchild = m_nodes[other].children[bestGrandchild];
+	m_nodes[node].children[bestChild] = grandchild;
+	m_nodes[grandchild].parent = node;
+	m_nodes[other].children[bestGrandchild] = child;
+	m_nodes[child].parent = other;
+
+	Node &otherNode = m_nodes[other];
+	otherNode.min = glm::min(m_nodes[otherNode.children[0]].min, m_nodes[otherNode.children[1]].min);
+	otherNode.max = glm::max(m_nodes[otherNode.children[0]].max, m_nodes[otherNode.children[1]].max);
+}
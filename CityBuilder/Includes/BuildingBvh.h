@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ZoneFill.h"
+
+// Bounding volume hierarchy over the world space boxes of the buildings, for ray casts and area queries. Each leaf
+// is one building. An insert walks down towards the sibling that grows the tree's surface area least, a removal
+// splices the leaf's parent out, and both refit the boxes on the way back up to the root. On the way up a child
+// trades places with a grandchild wherever that shrinks the boxes (tree rotations), which keeps the tree good
+// without ever rebuilding it.
+class BuildingBvh
+{
+public:
+	// id is the building's BuildingRegistry ID, min and max its box in world space
+	void Insert(uint32_t id, const glm::vec3 &min, const glm::vec3 &max);
+	void Remove(uint32_t id);
+	void Clear();
+
+	inline std::size_t GetCount() const noexcept { return m_count; }
+	// Longest path from the root to a leaf, a leaf alone is 1
+	int GetDepth() const;
+
+	// Building whose box the ray enters first before maxT, in units of direction. t is 0 if origin is inside the box
+	bool Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxT, uint32_t &id, float &t) const;
+	// True if any building box touches the segment from a to b, stops at the first one it finds
+	bool IntersectsSegment(const glm::vec3 &a, const glm::vec3 &b) const;
+
+	// Append the buildings whose box overlaps the box
+	void QueryBox(const glm::vec3 &min, const glm::vec3 &max, std::vector<uint32_t> &ids) const;
+	// Append the buildings whose center lies inside the zone on the XZ plane, for lasso selections
+	void QueryZone(const BuildingZone &zone, std::vector<uint32_t> &ids) const;
+
+private:
+	static constexpr int NO_NODE = -1;
+
+	struct Node
+	{
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		int parent = NO_NODE;
+		int children[2] = {NO_NODE, NO_NODE}; // Both NO_NODE for a leaf
+		uint32_t id = 0;											// Building of a leaf
+
+		inline bool IsLeaf() const noexcept { return children[0] == NO_NODE; }
+	};
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	// Boxes of node and its ancestors from their children, rotating where it helps
+	void Refit(int node);
+	void Rotate(int node);
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_freeNodes;
+	std::vector<int> m_leafOfId; // NO_NODE for IDs that are not in the tree
+	int m_root = NO_NODE;
+	std::size_t m_count = 0;
+};
@@ -0,0 +1,102 @@
+#include "BuildingCatalogue.h"
+
+#include <SDL2/SDL.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	std::string Trim(const std::string &text)
+	{
+		const char *whitespace = " \t\r\n";
+		std::size_t begin = text.find_first_not_of(whitespace);
+		if (begin == std::string::npos)
+			return std::string();
+		std::size_t end = text.find_last_not_of(whitespace);
+		return text.substr(begin, end - begin + 1);
+	}
+
+	bool IsComplete(const BuildingTypeDesc &type, const std::string &path)
+	{
+		if (type.meshPath.empty())
+		{
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "%s: building type '%s' has no mesh, skipping it", path.c_str(), type.name.c_str());
+			return false;
+		}
+		if (type.footprint.x <= 0.0f || type.footprint.y <= 0.0f)
+		{
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "%s: building type '%s' has no valid footprint, skipping it", path.c_str(), type.name.c_str());
+			return false;
+		}
+		return true;
+	}
+}
+
+bool BuildingCatalogue::Load(const std::string &path, std::vector<BuildingTypeDesc> &types)
+{
+	types.clear();
+
+	std::ifstream in(path);
+	if (!in)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot open building catalogue %s", path.c_str());
+		return false;
+	}
+
+	bool inSection = false;
+	BuildingTypeDesc current;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(in, line))
+	{
+		++lineNumber;
+		line = Trim(line);
+		if (line.empty() || line[0] == '#' || line[0] == ';')
+			continue;
+
+		if (line.front() == '[' && line.back() == ']')
+		{
+			if (inSection && IsComplete(current, path))
+				types.push_back(current);
+
+			current = BuildingTypeDesc();
+			current.name = Trim(line.substr(1, line.size() - 2));
+			inSection = true;
+			continue;
+		}
+
+		std::size_t equals = line.find('=');
+		if (!inSection || equals == std::string::npos)
+		{
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "%s:%d: ignoring '%s'", path.c_str(), lineNumber, line.c_str());
+			continue;
+		}
+
+		std::string key = Trim(line.substr(0, equals));
+		std::string value = Trim(line.substr(equals + 1));
+		if (key == "mesh")
+		{
+			current.meshPath = value;
+		}
+		else if (key == "texture")
+		{
+			current.texturePath = value;
+		}
+		else if (key == "footprint")
+		{
+			std::istringstream footprint(value);
+			if (!(footprint >> current.footprint.x >> current.footprint.y))
+				current.footprint = glm::vec2(0.0f);
+		}
+		else
+		{
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "%s:%d: unknown key '%s'", path.c_str(), lineNumber, key.c_str());
+		}
+	}
+
+	if (inSection && IsComplete(current, path))
+		types.push_back(current);
+
+	return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// One entry of the building catalogue
+struct BuildingTypeDesc
+{
+	std::string name;
+	std::string meshPath;
+	glm::vec2 footprint = glm::vec2(1.0f);
+	std::string texturePath;
+};
+
+// Text file listing the building types, so new ones need no recompile. Every type is an ini style section:
+//   [Name]
+//   mesh = path of an OBJ file
+//   footprint = width depth
+//   texture = path of the diffuse map
+// Lines starting with # or ; are comments.
+class BuildingCatalogue
+{
+public:
+	// Read the types at path in file order. Returns false if the file cannot be read,
+	// entries without a mesh or with a bad footprint are skipped with a warning
+	static bool Load(const std::string &path, std::vector<BuildingTypeDesc> &types);
+};
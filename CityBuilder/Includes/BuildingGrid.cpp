@@ -0,0 +1,172 @@
+#include "BuildingGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+void BuildingGrid::Create(const glm::vec2 &worldMin, const glm::vec2 &worldMax, float cellSize)
+{
+	m_worldMin = worldMin;
+	m_cellSize = cellSize;
+	m_cellCount = glm::max(glm::ivec2(glm::ceil((worldMax - worldMin) / cellSize)), glm::ivec2(1));
+	m_cells.assign(m_cellCount.x * m_cellCount.y, {});
+	m_footprints.clear();
+	m_maxHalfSize = glm::vec2(0.0f);
+	m_count = 0;
+}
+
+void BuildingGrid::Clear()
+{
+	for (std::vector<uint32_t> &cell : m_cells)
+		cell.clear();
+	m_footprints.clear();
+	m_maxHalfSize = glm::vec2(0.0f);
+	m_count = 0;
+}
+
+void BuildingGrid::Insert(uint32_t id, const glm::vec2 &center, const glm::vec2 &size)
+{
+	if (id >= m_footprints.size())
+		m_footprints.resize(id + 1);
+	else if (m_footprints[id].cell >= 0)
+		Remove(id);
+
+	glm::ivec2 coords = GetCellCoords(center);
+	Footprint &footprint = m_footprints[id];
+	footprint.center = center;
+	footprint.halfSize = size * 0.5f;
+	footprint.cell = coords.y * m_cellCount.x + coords.x;
+
+	m_cells[footprint.cell].push_back(id);
+	m_maxHalfSize = glm::max(m_maxHalfSize, footprint.halfSize);
+	++m_count;
+}
+
+void BuildingGrid::Remove(uint32_t id)
+{
+	if (id >= m_footprints.size() || m_footprints[id].cell < 0)
+		return;
+
+	std::vector<uint32_t> &cell = m_cells[m_footprints[id].cell];
+	auto it = std::find(cell.begin(), cell.end(), id);
+	*it = cell.back();
+	cell.pop_back();
+
+	m_footprints[id].cell = -1;
+	--m_count;
+}
+
+bool BuildingGrid::Overlaps(const glm::vec2 &min, const glm::vec2 &max) const
+{
+	// A footprint reaches at most m_maxHalfSize beyond the cell of its center
+	glm::ivec2 minCell = GetCellCoords(min - m_maxHalfSize);
+	glm::ivec2 maxCell = GetCellCoords(max + m_maxHalfSize);
+
+	for (int y = minCell.y; y <= maxCell.y; ++y)
+	{
+		for (int x = minCell.x; x <= maxCell.x; ++x)
+		{
+			for (uint32_t id : m_cells[y * m_cellCount.x + x])
+			{
+				const Footprint &footprint = m_footprints[id];
+				glm::vec2 otherMin = footprint.center - footprint.halfSize;
+				glm::vec2 otherMax = footprint.center + footprint.halfSize;
+				if (min.x < otherMax.x && max.x > otherMin.x && min.y < otherMax.y && max.y > otherMin.y)
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool BuildingGrid::FindAt(const glm::vec2 &point, uint32_t &id) const
+{
+	glm::ivec2 minCell = GetCellCoords(point - m_maxHalfSize);
+	glm::ivec2 maxCell = GetCellCoords(point + m_maxHalfSize);
+
+	for (int y = minCell.y; y <= maxCell.y; ++y)
+	{
+		for (int x = minCell.x; x <= maxCell.x; ++x)
+		{
+			for (uint32_t candidate : m_cells[y * m_cellCount.x + x])
+			{
+				const Footprint &footprint = m_footprints[candidate];
+				glm::vec2 offset = glm::abs(point - footprint.center);
+				if (offset.x <= footprint.halfSize.x && offset.y <= footprint.halfSize.y)
+				{
+					id = candidate;
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool BuildingGrid::FindNearest(const glm::vec2 &point, float maxDistance, uint32_t &id) const
+{
+	glm::ivec2 center = GetCellCoords(point);
+	int maxRing = static_cast<int>(std::ceil(maxDistance / m_cellSize));
+	maxRing = std::min(maxRing, std::max(m_cellCount.x, m_cellCount.y));
+
+	float bestDistance2 = maxDistance * maxDistance;
+	bool found = false;
+
+	// Rings of cells around the point's cell, until no closer center can be in the next ring
+	for (int ring = 0; ring <= maxRing; ++ring)
+	{
+		if (found && (ring - 1) * m_cellSize > std::sqrt(bestDistance2))
+			break;
+
+		for (int y = center.y - ring; y <= center.y + ring; ++y)
+		{
+			if (y < 0 || y >= m_cellCount.y)
+				continue;
+
+			// Inner rows only have the two cells on the ring's sides
+			int step = (y == center.y - ring || y == center.y + ring) ? 1 : std::max(1, 2 * ring);
+			for (int x = center.x - ring; x <= center.x + ring; x += step)
+			{
+				if (x < 0 || x >= m_cellCount.x)
+					continue;
+
+				for (uint32_t candidate : m_cells[y * m_cellCount.x + x])
+				{
+					glm::vec2 offset = m_footprints[candidate].center - point;
+					float distance2 = glm::dot(offset, offset);
+					if (distance2 <= bestDistance2)
+					{
+						bestDistance2 = distance2;
+						id = candidate;
+						found = true;
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
+
+void BuildingGrid::QueryRadius(const glm::vec2 &center, float radius, std::vector<uint32_t> &ids) const
+{
+	glm::ivec2 minCell = GetCellCoords(center - radius);
+	glm::ivec2 maxCell = GetCellCoords(center + radius);
+
+	for (int y = minCell.y; y <= maxCell.y; ++y)
+	{
+		for (int x = minCell.x; x <= maxCell.x; ++x)
+		{
+			for (uint32_t id : m_cells[y * m_cellCount.x + x])
+			{
+				glm::vec2 offset = m_footprints[id].center - center;
+				if (glm::dot(offset, offset) <= radius * radius)
+					ids.push_back(id);
+			}
+		}
+	}
+}
+
+glm::ivec2 BuildingGrid::GetCellCoords(const glm::vec2 &position) const
+{
+	glm::ivec2 coords(glm::floor((position - m_worldMin) / m_cellSize));
+	return glm::clamp(coords, glm::ivec2(0), m_cellCount - 1);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Uniform grid over the world XZ plane holding the footprint of every building.
+// A building is stored in the cell of its center only; box queries widen their range by the
+// largest half size inserted so far, so every query reads a fixed handful of cells.
+class BuildingGrid
+{
+public:
+	// Positions outside [worldMin, worldMax] are kept in the border cells
+	void Create(const glm::vec2 &worldMin, const glm::vec2 &worldMax, float cellSize);
+	void Clear();
+
+	// id is the caller's index of the building, size its full footprint
+	void Insert(uint32_t id, const glm::vec2 &center, const glm::vec2 &size);
+	void Remove(uint32_t id);
+
+	inline std::size_t GetCount() const noexcept { return m_count; }
+
+	// True if any footprint overlaps the open box (min, max)
+	bool Overlaps(const glm::vec2 &min, const glm::vec2 &max) const;
+
+	// Building whose footprint contains point, false if there is none
+	bool FindAt(const glm::vec2 &point, uint32_t &id) const;
+
+	// Building whose center is closest to point and at most maxDistance away, false if there is none
+	bool FindNearest(const glm::vec2 &point, float maxDistance, uint32_t &id) const;
+
+	// Append the buildings whose center is within radius of center
+	void QueryRadius(const glm::vec2 &center, float radius, std::vector<uint32_t> &ids) const;
+
+private:
+	struct Footprint
+	{
+		glm::vec2 center;
+		glm::vec2 halfSize;
+		int cell = -1; // -1 for ids that are not in the grid
+	};
+
+	glm::ivec2 GetCellCoords(const glm::vec2 &position) const;
+
+	glm::vec2 m_worldMin = glm::vec2(0.0f);
+	float m_cellSize = 1.0f;
+	glm::ivec2 m_cellCount = glm::ivec2(0);
+
+	std::vector<std::vector<uint32_t>> m_cells;
+	std::vector<Footprint> m_footprints; // Indexed by id
+	glm::vec2 m_maxHalfSize = glm::vec2(0.0f);
+	std::size_t m_count = 0;
+};
@@ -0,0 +1,127 @@
+#include "BuildingImpostors.h"
+
+#include <SDL2/SDL.h>
+
+#include <cmath>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+BuildingImpostors::~BuildingImpostors()
+{
+	Destroy();
+}
+
+glm::vec3 BuildingImpostors::GetViewDirection(int x, int y)
+{
+	// Inverse hemi-octahedral mapping of the view's center, the same as in Vert_BuildingImpostor.vert
+	glm::vec2 e = (glm::vec2(x, y) + 0.5f) / static_cast<float>(VIEWS_PER_SIDE) * 2.0f - 1.0f;
+	glm::vec2 p = glm::vec2(e.x + e.y, e.x - e.y) * 0.5f;
+	return glm::normalize(glm::vec3(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y));
+}
+
+void BuildingImpostors::Bake()
+{
+	Destroy();
+
+	const BuildingType typeCount = Buildings::GetTypeCount();
+	const GLsizei atlasSize = VIEWS_PER_SIDE * VIEW_SIZE;
+
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_colorTexture);
+	glTextureStorage3D(m_colorTexture, MIP_LEVELS, GL_RGBA8, atlasSize, atlasSize, typeCount);
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_normalDepthTexture);
+	glTextureStorage3D(m_normalDepthTexture, MIP_LEVELS, GL_RGBA16, atlasSize, atlasSize, typeCount);
+	for (GLuint texture : {m_colorTexture, m_normalDepthTexture})
+	{
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	std::vector<glm::vec4> spheres(typeCount);
+	for (BuildingType type = 0; type < typeCount; ++type)
+		spheres[type] = Buildings::GetBoundingSphere(type);
+	glCreateBuffers(1, &m_typeBuffer);
+	glNamedBufferStorage(m_typeBuffer, spheres.size() * sizeof(glm::vec4), spheres.data(), 0);
+
+	GLuint depthBuffer = 0;
+	glCreateRenderbuffers(1, &depthBuffer);
+	glNamedRenderbufferStorage(depthBuffer, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+
+	GLuint frameBuffer = 0;
+	glCreateFramebuffers(1, &frameBuffer);
+	glNamedFramebufferRenderbuffer(frameBuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+	glNamedFramebufferDrawBuffers(frameBuffer, 2, drawBuffers);
+
+	GLint previousViewport[4];
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glBindVertexArray(Buildings::GetVertexArray());
+	glBindTextureUnit(0, Buildings::GetTextureArray());
+
+	GLint program = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	GLint viewProjLocation = glGetUniformLocation(program, "viewProj");
+
+	const GLfloat clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	const GLfloat clearDepth = 1.0f;
+	for (BuildingType type = 0; type < typeCount; ++type)
+	{
+		glNamedFramebufferTextureLayer(frameBuffer, GL_COLOR_ATTACHMENT0, m_colorTexture, 0, type);
+		glNamedFramebufferTextureLayer(frameBuffer, GL_COLOR_ATTACHMENT1, m_normalDepthTexture, 0, type);
+		if (glCheckNamedFramebufferStatus(frameBuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Building impostor framebuffer is incomplete");
+			break;
+		}
+
+		// Empty texels keep zero coverage, the impostor shader discards them
+		glClearNamedFramebufferfv(frameBuffer, GL_COLOR, 0, clearColor);
+		glClearNamedFramebufferfv(frameBuffer, GL_COLOR, 1, clearColor);
+		glClearNamedFramebufferfv(frameBuffer, GL_DEPTH, 0, &clearDepth);
+
+		// An orthographic camera per view whose box is the bounding cube of the sphere, so the depth is linear over the diameter
+		glm::vec4 sphere = spheres[type];
+		glm::vec3 center = glm::vec3(sphere);
+		float radius = sphere.w;
+		glm::mat4 proj = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+		for (int y = 0; y < VIEWS_PER_SIDE; ++y)
+		{
+			for (int x = 0; x < VIEWS_PER_SIDE; ++x)
+			{
+				// The up vector of a view is the one Vert_BuildingImpostor.vert spans its quad with
+				glm::vec3 direction = GetViewDirection(x, y);
+				glm::vec3 right = direction.y > 0.999f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::normalize(glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), direction));
+				glm::vec3 up = glm::cross(direction, right);
+				glm::mat4 view = glm::lookAt(center + direction * radius, center, up);
+
+				glViewport(x * VIEW_SIZE, y * VIEW_SIZE, VIEW_SIZE, VIEW_SIZE);
+				glUniformMatrix4fv(viewProjLocation, 1, GL_FALSE, glm::value_ptr(proj * view));
+				Buildings::Draw(type);
+			}
+		}
+	}
+
+	glBindTextureUnit(0, 0);
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	glDeleteFramebuffers(1, &frameBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+
+	glGenerateTextureMipmap(m_colorTexture);
+	glGenerateTextureMipmap(m_normalDepthTexture);
+}
+
+void BuildingImpostors::Destroy()
+{
+	glDeleteTextures(1, &m_colorTexture);
+	glDeleteTextures(1, &m_normalDepthTexture);
+	glDeleteBuffers(1, &m_typeBuffer);
+	m_colorTexture = 0;
+	m_normalDepthTexture = 0;
+	m_typeBuffer = 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Buildings.hpp"
+
+// Far-distance stand-ins of the building types. Every type is rendered from a hemisphere of directions into one
+// layer of a color and a normal + depth atlas, a grid of VIEWS_PER_SIDE^2 views laid out by a hemi-octahedral mapping
+// of the view direction. Vert_BuildingImpostor.vert picks the view closest to the camera and draws it as a quad
+// that Frag_BuildingImpostor.frag lights and pushes back to the building's depth.
+class BuildingImpostors
+{
+public:
+	static constexpr int VIEWS_PER_SIDE = 8;
+	static constexpr int VIEW_SIZE = 64;
+	static constexpr int MIP_LEVELS = 4; // Stops while a view still has 8 texels, further down they bleed into each other
+
+	BuildingImpostors() = default;
+	~BuildingImpostors();
+
+	BuildingImpostors(const BuildingImpostors &) = delete;
+	BuildingImpostors &operator=(const BuildingImpostors &) = delete;
+
+	// Render every type of the catalogue with the currently bound Vert_ImpostorBake program
+	void Bake();
+	void Destroy();
+
+	// Direction of view (x, y) of the atlas, pointing from the building to the camera
+	static glm::vec3 GetViewDirection(int x, int y);
+
+	// Layer per type: rgba of the diffuse texture, premultiplied by the coverage in GetNormalDepthTexture's alpha
+	inline GLuint GetColorTexture() const noexcept { return m_colorTexture; }
+	// Layer per type: octahedral world normal in rg, depth along the view in b, coverage in a
+	inline GLuint GetNormalDepthTexture() const noexcept { return m_normalDepthTexture; }
+	// Buildings::GetBoundingSphere of every type, the impostor quads are fitted around it
+	inline GLuint GetTypeBuffer() const noexcept { return m_typeBuffer; }
+
+private:
+	GLuint m_colorTexture = 0;
+	GLuint m_normalDepthTexture = 0;
+	GLuint m_typeBuffer = 0;
+};
@@ -0,0 +1,235 @@
+#include "BuildingMeshCache.h"
+
+#include <SDL2/SDL.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace
+{
+	const char CACHE_DIRECTORY[] = "Cache";
+	const char MAGIC[4] = {'C', 'B', 'B', 'M'};
+
+	struct BuildingMeshCacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		float boundsMin[3];
+		float boundsMax[3];
+		uint64_t verticesOffset;
+		uint64_t indicesOffset;
+	};
+
+	struct PackedVertexHash
+	{
+		std::size_t operator()(const Buildings::PackedVertex &v) const
+		{
+			uint64_t words[2];
+			std::memcpy(words, &v, sizeof(words));
+			return std::hash<uint64_t>()(words[0] * 0x9E3779B97F4A7C15ull ^ words[1]);
+		}
+	};
+
+	struct PackedVertexEqual
+	{
+		bool operator()(const Buildings::PackedVertex &a, const Buildings::PackedVertex &b) const
+		{
+			return std::memcmp(&a, &b, sizeof(Buildings::PackedVertex)) == 0;
+		}
+	};
+
+	constexpr uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Size and modification time of the OBJ, false if it cannot be read
+	bool GetSourceStamp(const std::string &meshPath, uint64_t &size, int64_t &time)
+	{
+		std::error_code error;
+		size = std::filesystem::file_size(meshPath, error);
+		if (error)
+			return false;
+		time = static_cast<int64_t>(std::filesystem::last_write_time(meshPath, error).time_since_epoch().count());
+		return !error;
+	}
+}
+
+std::string BuildingMeshCache::GetPath(const std::string &meshPath)
+{
+	// FNV-1a of the whole path keeps meshes with the same file name in different folders apart
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : meshPath)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+
+	char hashText[17];
+	std::snprintf(hashText, sizeof(hashText), "%016llx", static_cast<unsigned long long>(hash));
+	return std::string(CACHE_DIRECTORY) + "/building_" + std::filesystem::path(meshPath).stem().string() + "_" + hashText + ".bin";
+}
+
+CookedBuildingMesh BuildingMeshCache::Cook(const ObjParser::Mesh &mesh)
+{
+	CookedBuildingMesh cooked;
+	cooked.boundsMin = glm::vec3(INFINITY);
+	cooked.boundsMax = glm::vec3(-INFINITY);
+
+	// Parsed vertices that only differed below the quantization step share one packed vertex
+	std::vector<GLuint> remap(mesh.vertexArray.size());
+	std::unordered_map<Buildings::PackedVertex, GLuint, PackedVertexHash, PackedVertexEqual> vertexIndices;
+	for (std::size_t i = 0; i < mesh.vertexArray.size(); ++i)
+	{
+		const Vertex &vertex = mesh.vertexArray[i];
+		Buildings::PackedVertex packed = Buildings::PackVertex(vertex.position, vertex.normal, vertex.texcoord);
+		auto inserted = vertexIndices.emplace(packed, static_cast<GLuint>(cooked.vertices.size()));
+		if (inserted.second)
+			cooked.vertices.push_back(packed);
+		remap[i] = inserted.first->second;
+
+		cooked.boundsMin = glm::min(cooked.boundsMin, vertex.position);
+		cooked.boundsMax = glm::max(cooked.boundsMax, vertex.position);
+	}
+
+	cooked.indices.reserve(mesh.indexArray.size());
+	for (GLuint index : mesh.indexArray)
+		cooked.indices.push_back(remap[index]);
+
+	return cooked;
+}
+
+bool BuildingMeshCache::Open(const std::string &meshPath)
+{
+	Close();
+
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	if (!GetSourceStamp(meshPath, sourceSize, sourceTime) || !m_file.Open(GetPath(meshPath)))
+		return false;
+
+	BuildingMeshCacheHeader header;
+	if (m_file.GetSize() < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	std::memcpy(&header, m_file.GetData(), sizeof(header));
+
+	uint64_t verticesBytes = static_cast<uint64_t>(header.vertexCount) * sizeof(Buildings::PackedVertex);
+	uint64_t indicesBytes = static_cast<uint64_t>(header.indexCount) * sizeof(GLuint);
+	bool matches = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+								 header.version == FORMAT_VERSION &&
+								 header.sourceSize == sourceSize &&
+								 header.sourceTime == sourceTime &&
+								 header.verticesOffset % alignof(Buildings::PackedVertex) == 0 &&
+								 header.indicesOffset % alignof(GLuint) == 0 &&
+								 header.verticesOffset + verticesBytes <= m_file.GetSize() &&
+								 header.indicesOffset + indicesBytes <= m_file.GetSize();
+	if (!matches)
+	{
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Ignoring stale building mesh cache %s", GetPath(meshPath).c_str());
+		Close();
+		return false;
+	}
+
+	m_verticesOffset = header.verticesOffset;
+	m_indicesOffset = header.indicesOffset;
+	m_vertexCount = header.vertexCount;
+	m_indexCount = header.indexCount;
+	m_boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	m_boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	return true;
+}
+
+void BuildingMeshCache::Close()
+{
+	m_file.Close();
+	m_verticesOffset = 0;
+	m_indicesOffset = 0;
+	m_vertexCount = 0;
+	m_indexCount = 0;
+	m_boundsMin = glm::vec3(0.0f);
+	m_boundsMax = glm::vec3(0.0f);
+}
+
+const Buildings::PackedVertex *BuildingMeshCache::GetVertices() const
+{
+	return reinterpret_cast<const Buildings::PackedVertex *>(m_file.GetData() + m_verticesOffset);
+}
+
+const GLuint *BuildingMeshCache::GetIndices() const
+{
+	return reinterpret_cast<const GLuint *>(m_file.GetData() + m_indicesOffset);
+}
+
+bool BuildingMeshCache::Write(const std::string &meshPath, const CookedBuildingMesh &mesh)
+{
+	BuildingMeshCacheHeader header = {};
+	if (!GetSourceStamp(meshPath, header.sourceSize, header.sourceTime))
+		return false;
+
+	std::error_code error;
+	std::filesystem::create_directories(CACHE_DIRECTORY, error);
+
+	uint64_t verticesBytes = mesh.vertices.size() * sizeof(Buildings::PackedVertex);
+	uint64_t indicesBytes = mesh.indices.size() * sizeof(GLuint);
+
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = FORMAT_VERSION;
+	header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	for (int i = 0; i < 3; ++i)
+	{
+		header.boundsMin[i] = mesh.boundsMin[i];
+		header.boundsMax[i] = mesh.boundsMax[i];
+	}
+	header.verticesOffset = AlignUp(sizeof(header), 16);
+	header.indicesOffset = AlignUp(header.verticesOffset + verticesBytes, 16);
+
+	// Write next to the target and rename, so an interrupted write never leaves a truncated cache behind.
+	// Worker threads cook different meshes, so every file has a single writer
+	std::string path = GetPath(meshPath);
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot write building mesh cache %s", tempPath.c_str());
+			return false;
+		}
+
+		const char padding[16] = {};
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(padding, static_cast<std::streamsize>(header.verticesOffset - sizeof(header)));
+		out.write(reinterpret_cast<const char *>(mesh.vertices.data()), static_cast<std::streamsize>(verticesBytes));
+		out.write(padding, static_cast<std::streamsize>(header.indicesOffset - header.verticesOffset - verticesBytes));
+		out.write(reinterpret_cast<const char *>(mesh.indices.data()), static_cast<std::streamsize>(indicesBytes));
+
+		if (!out)
+		{
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot write building mesh cache %s", tempPath.c_str());
+			out.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot replace building mesh cache %s: %s", path.c_str(), error.message().c_str());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Buildings.hpp"
+#include "MappedFile.h"
+#include "ObjParser.h"
+
+// A building mesh in the layout of the shared building buffers: quantized, deduplicated vertices and indices relative to them
+struct CookedBuildingMesh
+{
+	std::vector<Buildings::PackedVertex> vertices;
+	std::vector<GLuint> indices;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// On-disk copy of a cooked OBJ, so a repeat launch skips parsing and can copy the mapped file straight into the buffers.
+// File layout: a BuildingMeshCacheHeader, then the vertices, then the indices, each starting at a 16 byte aligned offset.
+// The header remembers the size and modification time of the OBJ, a changed file is cooked again.
+class BuildingMeshCache
+{
+public:
+	// Bump whenever the cooking or Buildings::PackedVertex changes
+	static constexpr uint32_t FORMAT_VERSION = 1;
+
+	static std::string GetPath(const std::string &meshPath);
+
+	// Quantize a parsed OBJ and merge the vertices that became identical
+	static CookedBuildingMesh Cook(const ObjParser::Mesh &mesh);
+
+	// Map the cache file of meshPath. Returns false if there is none or the OBJ changed since it was written
+	bool Open(const std::string &meshPath);
+	void Close();
+
+	inline uint32_t GetVertexCount() const noexcept { return m_vertexCount; }
+	inline uint32_t GetIndexCount() const noexcept { return m_indexCount; }
+	inline const glm::vec3 &GetBoundsMin() const noexcept { return m_boundsMin; }
+	inline const glm::vec3 &GetBoundsMax() const noexcept { return m_boundsMax; }
+
+	// Point into the mapping, valid until Close
+	const Buildings::PackedVertex *GetVertices() const;
+	const GLuint *GetIndices() const;
+
+	// Store a freshly cooked mesh for meshPath, replacing an older file
+	static bool Write(const std::string &meshPath, const CookedBuildingMesh &mesh);
+
+private:
+	MappedFile m_file;
+	uint64_t m_verticesOffset = 0;
+	uint64_t m_indicesOffset = 0;
+	uint32_t m_vertexCount = 0;
+	uint32_t m_indexCount = 0;
+	glm::vec3 m_boundsMin = glm::vec3(0.0f);
+	glm::vec3 m_boundsMax = glm::vec3(0.0f);
+};
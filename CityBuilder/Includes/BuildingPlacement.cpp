@@ -0,0 +1,47 @@
+#include "BuildingPlacement.h"
+
+#include <algorithm>
+#include <cmath>
+
+glm::vec2 BuildingPlacementRules::ToUV(const PlacementRules &rules, const glm::vec2 &position)
+{
+	return position / rules.worldSize + 0.5f;
+}
+
+float BuildingPlacementRules::ToWorldHeight(const PlacementRules &rules, float normalizedHeight)
+{
+	return normalizedHeight * rules.heightScale + rules.heightOffset;
+}
+
+float BuildingPlacementRules::GetFootprintSlope(const Terrain &terrain, const PlacementRules &rules, BuildingType type, const glm::vec2 &position)
+{
+	glm::vec2 footprint = Buildings::GetBuildingSize(type);
+	glm::vec2 halfSizeUV = footprint * 0.5f / rules.worldSize;
+	glm::vec2 uv = ToUV(rules, position);
+	TerrainRect rect = terrain.GetTexelRect(uv - halfSizeUV, uv + halfSizeUV);
+
+	float minHeight = terrain.GetHeight(rect.minX, rect.minY);
+	float maxHeight = minHeight;
+	for (int y = rect.minY; y < rect.maxY; ++y)
+	{
+		const float *row = terrain.GetHeightData() + y * terrain.GetSize();
+		auto range = std::minmax_element(row + rect.minX, row + rect.maxX);
+		minHeight = std::min(minHeight, *range.first);
+		maxHeight = std::max(maxHeight, *range.second);
+	}
+
+	return (maxHeight - minHeight) * rules.heightScale / std::max(footprint.x, footprint.y);
+}
+
+bool BuildingPlacementRules::IsGroundSuitable(const Terrain &terrain, const PlacementRules &rules, BuildingType type, const glm::vec2 &position)
+{
+	glm::vec2 halfSize = Buildings::GetBuildingSize(type) * 0.5f;
+	float halfWorld = rules.worldSize * 0.5f;
+	if (std::abs(position.x) + halfSize.x > halfWorld || std::abs(position.y) + halfSize.y > halfWorld)
+		return false;
+
+	if (ToWorldHeight(rules, terrain.SampleHeight(ToUV(rules, position))) < rules.waterLevel)
+		return false;
+
+	return GetFootprintSlope(terrain, rules, type, position) <= rules.maxSlope;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Buildings.hpp"
+#include "Terrain.h"
+
+// A building to be placed, centered at position on the XZ plane
+struct BuildingPlacement
+{
+	BuildingType type = 0;
+	glm::vec2 position = glm::vec2(0.0f);
+	glm::vec3 color = glm::vec3(1.0f);
+};
+
+// How the terrain maps to world units and which ground a building accepts
+struct PlacementRules
+{
+	float worldSize = 100.0f;			// The terrain spans [-worldSize / 2, worldSize / 2] on X and Z
+	float heightScale = 1.0f;			// World height = normalized height * heightScale + heightOffset
+	float heightOffset = 0.0f;
+	float waterLevel = 0.0f;			// World height the center of a building has to be at or above
+	float maxSlope = 1.0f;				// Largest rise over run across the footprint
+};
+
+// Ground checks that only read the terrain, so worker threads can run them side by side
+namespace BuildingPlacementRules
+{
+	glm::vec2 ToUV(const PlacementRules &rules, const glm::vec2 &position);
+	float ToWorldHeight(const PlacementRules &rules, float normalizedHeight);
+
+	// Height difference over the footprint divided by its longer side
+	float GetFootprintSlope(const Terrain &terrain, const PlacementRules &rules, BuildingType type, const glm::vec2 &position);
+
+	// Footprint inside the map, center above the water, footprint not steeper than the rules allow
+	bool IsGroundSuitable(const Terrain &terrain, const PlacementRules &rules, BuildingType type, const glm::vec2 &position);
+}
@@ -0,0 +1,113 @@
+#include "BuildingRegistry.h"
+
+#include <algorithm>
+
+uint32_t BuildingRegistry::Add(BuildingType type, const glm::vec3 &position, const glm::vec3 &color, const glm::vec2 &footprint)
+{
+	uint32_t id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		id = static_cast<uint32_t>(m_indexOfId.size());
+		m_indexOfId.push_back(INVALID_ID);
+	}
+
+	m_indexOfId[id] = static_cast<uint32_t>(m_ids.size());
+	m_ids.push_back(id);
+	m_types.push_back(type);
+	m_positions.push_back(position);
+	m_colors.push_back(color);
+	m_footprints.push_back(footprint);
+	m_heightBackups.push_back(Backup());
+	m_splatBackups.push_back(Backup());
+	return id;
+}
+
+void BuildingRegistry::Remove(uint32_t id)
+{
+	if (!Contains(id))
+		return;
+
+	uint32_t index = m_indexOfId[id];
+	FreeTerrainBackup(index);
+
+	// The last building moves into the hole
+	uint32_t last = static_cast<uint32_t>(m_ids.size() - 1);
+	if (index != last)
+	{
+		m_ids[index] = m_ids[last];
+		m_types[index] = m_types[last];
+		m_positions[index] = m_positions[last];
+		m_colors[index] = m_colors[last];
+		m_footprints[index] = m_footprints[last];
+		m_heightBackups[index] = m_heightBackups[last];
+		m_splatBackups[index] = m_splatBackups[last];
+		m_indexOfId[m_ids[index]] = index;
+	}
+
+	m_ids.pop_back();
+	m_types.pop_back();
+	m_positions.pop_back();
+	m_colors.pop_back();
+	m_footprints.pop_back();
+	m_heightBackups.pop_back();
+	m_splatBackups.pop_back();
+
+	m_indexOfId[id] = INVALID_ID;
+	m_freeIds.push_back(id);
+}
+
+void BuildingRegistry::Clear()
+{
+	m_ids.clear();
+	m_types.clear();
+	m_positions.clear();
+	m_colors.clear();
+	m_footprints.clear();
+	m_heightBackups.clear();
+	m_splatBackups.clear();
+	m_indexOfId.clear();
+	m_freeIds.clear();
+	m_heightArena.Clear();
+	m_splatArena.Clear();
+}
+
+void BuildingRegistry::SetTerrainBackup(uint32_t id, const TerrainRect &heightRect, const float *heights,
+																				const TerrainRect &splatRect, const glm::vec4 *splat)
+{
+	uint32_t index = m_indexOfId[id];
+	FreeTerrainBackup(index);
+
+	if (!heightRect.IsEmpty())
+	{
+		uint32_t count = static_cast<uint32_t>(heightRect.GetWidth() * heightRect.GetHeight());
+		uint32_t offset = m_heightArena.Allocate(count);
+		std::copy_n(heights, count, m_heightArena.GetData(offset));
+		m_heightBackups[index] = {heightRect, offset};
+	}
+
+	if (!splatRect.IsEmpty())
+	{
+		uint32_t count = static_cast<uint32_t>(splatRect.GetWidth() * splatRect.GetHeight());
+		uint32_t offset = m_splatArena.Allocate(count);
+		std::transform(splat, splat + count, m_splatArena.GetData(offset), PackSplat);
+		m_splatBackups[index] = {splatRect, offset};
+	}
+}
+
+void BuildingRegistry::FreeTerrainBackup(uint32_t index)
+{
+	Backup &heights = m_heightBackups[index];
+	if (!heights.rect.IsEmpty())
+		m_heightArena.Free(heights.offset, static_cast<uint32_t>(heights.rect.GetWidth() * heights.rect.GetHeight()));
+	heights = Backup();
+
+	Backup &splat = m_splatBackups[index];
+	if (!splat.rect.IsEmpty())
+		m_splatArena.Free(splat.offset, static_cast<uint32_t>(splat.rect.GetWidth() * splat.rect.GetHeight()));
+	splat = Backup();
+}
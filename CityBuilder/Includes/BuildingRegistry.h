@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Buildings.hpp"
+#include "Terrain.h"
+
+// Pool of blocks for the terrain data buildings replaced. Freed blocks are kept by size and
+// handed out again, which fits the few footprint sizes buildings come in.
+template <typename T>
+class BlockArena
+{
+public:
+	// Offset of a block of count elements
+	uint32_t Allocate(uint32_t count)
+	{
+		m_usedCount += count;
+
+		auto it = m_freeBlocks.find(count);
+		if (it != m_freeBlocks.end() && !it->second.empty())
+		{
+			uint32_t offset = it->second.back();
+			it->second.pop_back();
+			return offset;
+		}
+
+		uint32_t offset = static_cast<uint32_t>(m_data.size());
+		m_data.resize(m_data.size() + count);
+		return offset;
+	}
+
+	void Free(uint32_t offset, uint32_t count)
+	{
+		m_freeBlocks[count].push_back(offset);
+		m_usedCount -= count;
+	}
+
+	void Clear()
+	{
+		m_data.clear();
+		m_freeBlocks.clear();
+		m_usedCount = 0;
+	}
+
+	inline T *GetData(uint32_t offset) noexcept { return m_data.data() + offset; }
+	inline const T *GetData(uint32_t offset) const noexcept { return m_data.data() + offset; }
+
+	// Elements in use and elements reserved, freed blocks included
+	inline std::size_t GetUsedCount() const noexcept { return m_usedCount; }
+	inline std::size_t GetCapacity() const noexcept { return m_data.size(); }
+
+private:
+	std::vector<T> m_data;
+	std::unordered_map<uint32_t, std::vector<uint32_t>> m_freeBlocks; // Offsets by block size
+	std::size_t m_usedCount = 0;
+};
+
+using HeightArena = BlockArena<float>;
+using SplatArena = BlockArena<uint32_t>; // PackSplat values
+
+// Every placed building, one column per property. Indices are dense and change when a building
+// is removed (the last one takes its place); IDs stay the same for a building's lifetime.
+class BuildingRegistry
+{
+public:
+	static constexpr uint32_t INVALID_ID = UINT32_MAX;
+
+	// footprint is the full size on the XZ plane
+	uint32_t Add(BuildingType type, const glm::vec3 &position, const glm::vec3 &color, const glm::vec2 &footprint);
+	void Remove(uint32_t id);
+	void Clear();
+
+	inline std::size_t GetCount() const noexcept { return m_ids.size(); }
+	inline bool Contains(uint32_t id) const noexcept { return id < m_indexOfId.size() && m_indexOfId[id] != INVALID_ID; }
+	inline uint32_t GetIndex(uint32_t id) const noexcept { return m_indexOfId[id]; }
+
+	// Columns, indexed by GetIndex
+	inline const std::vector<uint32_t> &GetIds() const noexcept { return m_ids; }
+	inline const std::vector<BuildingType> &GetTypes() const noexcept { return m_types; }
+	inline const std::vector<glm::vec3> &GetPositions() const noexcept { return m_positions; }
+	inline const std::vector<glm::vec3> &GetColors() const noexcept { return m_colors; }
+	inline const std::vector<glm::vec2> &GetFootprints() const noexcept { return m_footprints; }
+
+	// The terrain from before the building, copied into the arenas so demolishing it can restore the ground
+	void SetTerrainBackup(uint32_t id, const TerrainRect &heightRect, const float *heights,
+												const TerrainRect &splatRect, const glm::vec4 *splat);
+	inline const TerrainRect &GetHeightBackupRect(uint32_t index) const noexcept { return m_heightBackups[index].rect; }
+	inline const float *GetHeightBackup(uint32_t index) const noexcept { return m_heightArena.GetData(m_heightBackups[index].offset); }
+	inline const TerrainRect &GetSplatBackupRect(uint32_t index) const noexcept { return m_splatBackups[index].rect; }
+	inline const uint32_t *GetSplatBackup(uint32_t index) const noexcept { return m_splatArena.GetData(m_splatBackups[index].offset); }
+
+	inline const HeightArena &GetHeightArena() const noexcept { return m_heightArena; }
+	inline const SplatArena &GetSplatArena() const noexcept { return m_splatArena; }
+
+private:
+	// Empty rect if the building did not change that map
+	struct Backup
+	{
+		TerrainRect rect;
+		uint32_t offset = 0;
+	};
+
+	void FreeTerrainBackup(uint32_t index);
+
+	std::vector<uint32_t> m_ids;
+	std::vector<BuildingType> m_types;
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::vec3> m_colors;
+	std::vector<glm::vec2> m_footprints;
+	std::vector<Backup> m_heightBackups;
+	std::vector<Backup> m_splatBackups;
+
+	std::vector<uint32_t> m_indexOfId; // INVALID_ID for unused IDs
+	std::vector<uint32_t> m_freeIds;
+
+	HeightArena m_heightArena;
+	SplatArena m_splatArena;
+};
@@ -0,0 +1,406 @@
+#include "BuildingRenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLUtils.hpp"
+
+namespace
+{
+	constexpr GLuint INSTANCE_BINDING = 1;
+
+	// Buffer of the instance IDs in Vert_BuildingPick.vert
+	constexpr GLuint ID_BUFFER_BINDING = 0;
+
+	constexpr GLuint INSTANCE_POSITION_LOCATION = 3;
+	constexpr GLuint INSTANCE_COLOR_LOCATION = 4;
+
+	constexpr std::size_t INITIAL_CAPACITY = 256;
+
+	// local_size_x of Comp_BuildingCull.comp
+	constexpr GLuint CULL_GROUP_SIZE = 64;
+
+	// Width of the cross-fade band behind the impostor distance, relative to the distance
+	constexpr float IMPOSTOR_FADE_FRACTION = 0.1f;
+
+	// Instance attributes read from the visible buffer at INSTANCE_BINDING
+	void SetupInstanceFormat(GLuint vao)
+	{
+		glVertexArrayBindingDivisor(vao, INSTANCE_BINDING, 1);
+		glEnableVertexArrayAttrib(vao, INSTANCE_POSITION_LOCATION);
+		glVertexArrayAttribFormat(vao, INSTANCE_POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, offsetof(BuildingInstanceData, position));
+		glVertexArrayAttribBinding(vao, INSTANCE_POSITION_LOCATION, INSTANCE_BINDING);
+		glEnableVertexArrayAttrib(vao, INSTANCE_COLOR_LOCATION);
+		glVertexArrayAttribFormat(vao, INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, offsetof(BuildingInstanceData, color));
+		glVertexArrayAttribBinding(vao, INSTANCE_COLOR_LOCATION, INSTANCE_BINDING);
+	}
+}
+
+BuildingRenderer::~BuildingRenderer()
+{
+	Destroy();
+}
+
+void BuildingRenderer::Create()
+{
+	Destroy();
+
+	const BuildingType typeCount = Buildings::GetTypeCount();
+	m_batches.resize(typeCount);
+	m_visibleOffsets.assign(2 * typeCount, 0);
+
+	for (BuildingType type = 0; type < typeCount; ++type)
+		m_batches[type].boundingSphere = Buildings::GetBoundingSphere(type);
+
+	// The meshes of every type are in the shared buffers of Buildings, the instances come on top
+	glCreateVertexArrays(1, &m_vao);
+	Buildings::SetupVertexFormat(m_vao);
+	SetupInstanceFormat(m_vao);
+	glCreateVertexArrays(1, &m_idVao);
+	Buildings::SetupVertexFormat(m_idVao);
+	SetupInstanceFormat(m_idVao);
+
+	// Impostor quads need no vertex data, Vert_BuildingImpostor.vert derives type and corner from gl_VertexID
+	const GLuint quadIndices[] = {0, 1, 2, 0, 2, 3};
+	glCreateBuffers(1, &m_impostorIndexBuffer);
+	glNamedBufferStorage(m_impostorIndexBuffer, sizeof(quadIndices), quadIndices, 0);
+	glCreateVertexArrays(1, &m_impostorVao);
+	glVertexArrayElementBuffer(m_impostorVao, m_impostorIndexBuffer);
+	SetupInstanceFormat(m_impostorVao);
+
+	glCreateBuffers(1, &m_commandBuffer);
+	glNamedBufferStorage(m_commandBuffer, GetCommandCount() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	glCreateBuffers(READBACK_SLOTS, m_readbackBuffers.data());
+	for (GLuint buffer : m_readbackBuffers)
+		glNamedBufferStorage(buffer, GetCommandCount() * sizeof(DrawElementsIndirectCommand), nullptr, GL_CLIENT_STORAGE_BIT);
+
+	for (Batch &batch : m_batches)
+		Reserve(batch, INITIAL_CAPACITY);
+	ReserveVisible();
+}
+
+void BuildingRenderer::Destroy()
+{
+	for (Batch &batch : m_batches)
+	{
+		glDeleteBuffers(1, &batch.instanceBuffer);
+		glDeleteBuffers(1, &batch.idBuffer);
+	}
+	m_batches.clear();
+	m_visibleOffsets.clear();
+
+	for (GLsync &fence : m_readbackFences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (m_readbackBuffers[0] != 0)
+		glDeleteBuffers(READBACK_SLOTS, m_readbackBuffers.data());
+	m_readbackBuffers.fill(0);
+	m_readbackTotals.fill(0);
+	m_nextReadback = 0;
+
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteVertexArrays(1, &m_idVao);
+	glDeleteVertexArrays(1, &m_impostorVao);
+	glDeleteBuffers(1, &m_impostorIndexBuffer);
+	glDeleteBuffers(1, &m_visibleBuffer);
+	glDeleteBuffers(1, &m_commandBuffer);
+	m_vao = 0;
+	m_idVao = 0;
+	m_impostorVao = 0;
+	m_impostorIndexBuffer = 0;
+	m_visibleBuffer = 0;
+	m_visibleCapacity = 0;
+	m_commandBuffer = 0;
+
+	m_visibleCount = 0;
+	m_culledCount = 0;
+	m_impostorCount = 0;
+	m_occludedCount = 0;
+}
+
+void BuildingRenderer::Add(uint32_t id, BuildingType type, const glm::vec3 &position, const glm::vec3 &color)
+{
+	Batch &batch = m_batches[type];
+	if (id >= m_slots.size())
+		m_slots.resize(id + 1);
+	m_slots[id] = {static_cast<int>(type), static_cast<uint32_t>(batch.instances.size())};
+
+	batch.instances.push_back({position, color});
+	batch.ids.push_back(id);
+}
+
+void BuildingRenderer::Remove(uint32_t id)
+{
+	if (id >= m_slots.size() || m_slots[id].type < 0)
+		return;
+
+	Batch &batch = m_batches[m_slots[id].type];
+	uint32_t index = m_slots[id].index;
+
+	// The type's last instance moves into the hole
+	if (index != batch.instances.size() - 1)
+	{
+		batch.instances[index] = batch.instances.back();
+		batch.ids[index] = batch.ids.back();
+		m_slots[batch.ids[index]].index = index;
+	}
+	batch.instances.pop_back();
+	batch.ids.pop_back();
+	m_slots[id] = Slot();
+
+	batch.dirtyBegin = std::min<std::size_t>(batch.dirtyBegin, index);
+	batch.uploadedCount = std::min(batch.uploadedCount, batch.instances.size());
+}
+
+void BuildingRenderer::Clear()
+{
+	for (Batch &batch : m_batches)
+	{
+		batch.instances.clear();
+		batch.ids.clear();
+		batch.uploadedCount = 0;
+		batch.dirtyBegin = 0;
+	}
+	m_slots.clear();
+}
+
+std::size_t BuildingRenderer::GetInstanceCount() const noexcept
+{
+	std::size_t count = 0;
+	for (const Batch &batch : m_batches)
+		count += batch.instances.size();
+	return count;
+}
+
+void BuildingRenderer::Upload()
+{
+	bool grown = false;
+	for (Batch &batch : m_batches)
+	{
+		std::size_t count = batch.instances.size();
+		if (batch.dirtyBegin >= count)
+		{
+			batch.dirtyBegin = batch.uploadedCount = count;
+			continue;
+		}
+
+		if (count > batch.capacity)
+		{
+			Reserve(batch, std::max(count, batch.capacity * 2));
+			grown = true;
+		}
+
+		glNamedBufferSubData(batch.instanceBuffer, batch.dirtyBegin * sizeof(BuildingInstanceData),
+												 (count - batch.dirtyBegin) * sizeof(BuildingInstanceData), batch.instances.data() + batch.dirtyBegin);
+		glNamedBufferSubData(batch.idBuffer, batch.dirtyBegin * sizeof(uint32_t), (count - batch.dirtyBegin) * sizeof(uint32_t),
+												 batch.ids.data() + batch.dirtyBegin);
+		batch.dirtyBegin = batch.uploadedCount = count;
+	}
+
+	if (grown)
+		ReserveVisible();
+}
+
+glm::vec2 BuildingRenderer::GetImpostorRange(float impostorDistance)
+{
+	if (impostorDistance <= 0.0f)
+		return glm::vec2(0.0f);
+	return glm::vec2(impostorDistance, impostorDistance * (1.0f + IMPOSTOR_FADE_FRACTION));
+}
+
+void BuildingRenderer::Cull(const glm::mat4 &viewProj, const glm::vec3 &eye, float maxDistance, float impostorDistance, const HiZBuffer *occluders)
+{
+	ReadBackCounts();
+
+	// Gribb-Hartmann plane extraction, normalized so the sphere test can use the distances directly
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+	glm::vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+												 rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2]};
+	for (glm::vec4 &plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	glUniform4fv(ul("frustumPlanes"), 6, glm::value_ptr(planes[0]));
+	glUniform3fv(ul("cameraPos"), 1, glm::value_ptr(eye));
+	glUniform1f(ul("maxDistance"), maxDistance);
+	glUniform2fv(ul("impostorRange"), 1, glm::value_ptr(GetImpostorRange(impostorDistance)));
+	glUniform1ui(ul("typeCount"), static_cast<GLuint>(m_batches.size()));
+	glUniform1i(ul("occlusionCulling"), occluders != nullptr);
+	if (occluders)
+	{
+		glUniformMatrix4fv(ul("viewProj"), 1, GL_FALSE, glm::value_ptr(viewProj));
+		glUniform1i(ul("hiZ"), 0);
+		glBindTextureUnit(0, occluders->GetPyramidTexture());
+		glBindSampler(0, 0);
+	}
+
+	// Every command starts empty, the compute pass counts the instances in.
+	// The impostor quad of type t is vertices 4t to 4t + 3, and the last two slots only count buildings
+	const GLuint typeCount = static_cast<GLuint>(m_batches.size());
+	std::vector<DrawElementsIndirectCommand> commands(GetCommandCount(), DrawElementsIndirectCommand{});
+	for (GLuint type = 0; type < typeCount; ++type)
+	{
+		const BuildingData &data = Buildings::GetBuildingData(type);
+		commands[type] = {static_cast<GLuint>(data.indexCount), 0, data.firstIndex, data.baseVertex, m_visibleOffsets[type]};
+		commands[typeCount + type] = {6, 0, 0, static_cast<GLint>(4 * type), m_visibleOffsets[typeCount + type]};
+	}
+	glNamedBufferSubData(m_commandBuffer, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_visibleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_commandBuffer);
+
+	GLint ulInstanceCount = ul("instanceCount");
+	GLint ulCommandIndex = ul("commandIndex");
+	GLint ulBoundingSphere = ul("boundingSphere");
+	GLint ulBoundsMin = ul("boundsMin");
+	GLint ulBoundsMax = ul("boundsMax");
+	for (BuildingType type = 0; type < m_batches.size(); ++type)
+	{
+		const Batch &batch = m_batches[type];
+		if (batch.uploadedCount == 0)
+			continue;
+
+		glUniform1ui(ulInstanceCount, static_cast<GLuint>(batch.uploadedCount));
+		glUniform1ui(ulCommandIndex, type);
+		glUniform4fv(ulBoundingSphere, 1, glm::value_ptr(batch.boundingSphere));
+		glUniform3fv(ulBoundsMin, 1, glm::value_ptr(Buildings::GetBuildingData(type).boundsMin));
+		glUniform3fv(ulBoundsMax, 1, glm::value_ptr(Buildings::GetBuildingData(type).boundsMax));
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, batch.instanceBuffer);
+		glDispatchCompute(static_cast<GLuint>((batch.uploadedCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+	}
+
+	for (int i = 0; i < 3; ++i)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+	if (occluders)
+		glBindTextureUnit(0, 0);
+
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	// Keep a copy of the counts for the statistics
+	GLsync &fence = m_readbackFences[m_nextReadback];
+	if (fence)
+		glDeleteSync(fence);
+	glCopyNamedBufferSubData(m_commandBuffer, m_readbackBuffers[m_nextReadback], 0, 0, commands.size() * sizeof(DrawElementsIndirectCommand));
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_readbackTotals[m_nextReadback] = static_cast<unsigned int>(GetInstanceCount());
+	m_nextReadback = (m_nextReadback + 1) % READBACK_SLOTS;
+}
+
+void BuildingRenderer::DrawImpostors() const
+{
+	GLsizei typeCount = static_cast<GLsizei>(m_batches.size());
+	glBindVertexArray(m_impostorVao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+															reinterpret_cast<const void *>(typeCount * sizeof(DrawElementsIndirectCommand)), typeCount, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void BuildingRenderer::Draw() const
+{
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(m_batches.size()), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void BuildingRenderer::DrawIds() const
+{
+	// One instanced draw per type straight from its instance buffer, there are no commands for culled buildings
+	glBindVertexArray(m_idVao);
+	for (BuildingType type = 0; type < m_batches.size(); ++type)
+	{
+		const Batch &batch = m_batches[type];
+		if (batch.uploadedCount == 0)
+			continue;
+
+		const BuildingData &data = Buildings::GetBuildingData(type);
+		glVertexArrayVertexBuffer(m_idVao, INSTANCE_BINDING, batch.instanceBuffer, 0, sizeof(BuildingInstanceData));
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ID_BUFFER_BINDING, batch.idBuffer);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, data.indexCount, GL_UNSIGNED_INT, reinterpret_cast<const void *>(data.firstIndex * sizeof(GLuint)),
+																			static_cast<GLsizei>(batch.uploadedCount), data.baseVertex);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ID_BUFFER_BINDING, 0);
+	glBindVertexArray(0);
+}
+
+void BuildingRenderer::DrawSingle(BuildingType type, const glm::vec3 &position, const glm::vec3 &color)
+{
+	// The shared VAO of Buildings has no instance arrays, so these values apply to every vertex
+	glVertexAttrib3fv(INSTANCE_POSITION_LOCATION, &position[0]);
+	glVertexAttrib3fv(INSTANCE_COLOR_LOCATION, &color[0]);
+
+	glBindVertexArray(Buildings::GetVertexArray());
+	Buildings::Draw(type);
+	glBindVertexArray(0);
+}
+
+void BuildingRenderer::Reserve(Batch &batch, std::size_t capacity)
+{
+	// Immutable storage cannot grow, so a bigger buffer replaces it and receives every instance again
+	glDeleteBuffers(1, &batch.instanceBuffer);
+	glCreateBuffers(1, &batch.instanceBuffer);
+	glNamedBufferStorage(batch.instanceBuffer, capacity * sizeof(BuildingInstanceData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glDeleteBuffers(1, &batch.idBuffer);
+	glCreateBuffers(1, &batch.idBuffer);
+	glNamedBufferStorage(batch.idBuffer, capacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	batch.capacity = capacity;
+	batch.uploadedCount = 0;
+	batch.dirtyBegin = 0;
+}
+
+void BuildingRenderer::ReserveVisible()
+{
+	// Each type gets as much room as its instance buffer for the meshes and again for the impostors,
+	// so the culling pass can never overflow
+	std::size_t capacity = 0;
+	for (std::size_t command = 0; command < m_visibleOffsets.size(); ++command)
+	{
+		m_visibleOffsets[command] = static_cast<GLuint>(capacity);
+		capacity += m_batches[command % m_batches.size()].capacity;
+	}
+
+	if (capacity == m_visibleCapacity)
+		return;
+
+	glDeleteBuffers(1, &m_visibleBuffer);
+	glCreateBuffers(1, &m_visibleBuffer);
+	glNamedBufferStorage(m_visibleBuffer, capacity * sizeof(BuildingInstanceData), nullptr, 0);
+	glVertexArrayVertexBuffer(m_vao, INSTANCE_BINDING, m_visibleBuffer, 0, sizeof(BuildingInstanceData));
+	glVertexArrayVertexBuffer(m_impostorVao, INSTANCE_BINDING, m_visibleBuffer, 0, sizeof(BuildingInstanceData));
+	m_visibleCapacity = capacity;
+}
+
+void BuildingRenderer::ReadBackCounts()
+{
+	// The slot about to be reused was written READBACK_SLOTS frames ago
+	GLsync &fence = m_readbackFences[m_nextReadback];
+	if (!fence)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return;
+
+	std::vector<DrawElementsIndirectCommand> commands(GetCommandCount());
+	glGetNamedBufferSubData(m_readbackBuffers[m_nextReadback], 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+
+	// Buildings in the cross-fade band are in both lists, the drawn counter has each once
+	m_impostorCount = 0;
+	for (std::size_t type = 0; type < m_batches.size(); ++type)
+		m_impostorCount += commands[m_batches.size() + type].instanceCount;
+	m_visibleCount = commands[2 * m_batches.size()].instanceCount;
+	m_occludedCount = commands[2 * m_batches.size() + 1].instanceCount;
+	m_culledCount = m_readbackTotals[m_nextReadback] - m_visibleCount;
+}
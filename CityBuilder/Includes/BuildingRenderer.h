@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Buildings.hpp"
+#include "HiZBuffer.h"
+
+// Per-instance vertex attributes of a building, locations 3 and 4 of Vert_BuildingInstanced.vert
+struct BuildingInstanceData
+{
+	glm::vec3 position;
+	glm::vec3 color;
+};
+
+// Draws every placed building on the GPU's own terms. Each type has an instance buffer that new
+// buildings are appended to (a removed one is replaced by the type's last), and a compute pass culls all of them against the camera into a
+// compacted buffer plus one indirect draw command per type, drawn with a single multi-draw.
+// Beyond the impostor distance the same pass sorts buildings into a second set of commands that draws them as BuildingImpostors quads.
+// Given a HiZBuffer of the occluders it also drops the buildings hidden behind them.
+class BuildingRenderer
+{
+public:
+	BuildingRenderer() = default;
+	~BuildingRenderer();
+
+	BuildingRenderer(const BuildingRenderer &) = delete;
+	BuildingRenderer &operator=(const BuildingRenderer &) = delete;
+
+	// Needs the catalogue of Buildings::Initialize
+	void Create();
+	void Destroy();
+
+	// id is the building's BuildingRegistry ID
+	void Add(uint32_t id, BuildingType type, const glm::vec3 &position, const glm::vec3 &color);
+	void Remove(uint32_t id);
+	void Clear();
+
+	inline std::size_t GetInstanceCount(BuildingType type) const noexcept { return m_batches[type].instances.size(); }
+	std::size_t GetInstanceCount() const noexcept;
+
+	// Send the instances changed since the last call to the GPU
+	void Upload();
+
+	// Fill the draw commands with the currently bound Comp_BuildingCull program.
+	// maxDistance 0 disables distance culling, impostorDistance 0 disables impostors, no occluders disables occlusion culling.
+	// The pyramid of occluders has to be built with the same viewProj
+	void Cull(const glm::mat4 &viewProj, const glm::vec3 &eye, float maxDistance, float impostorDistance, const HiZBuffer *occluders);
+
+	// Cross-fade band from mesh to impostor, the impostorRange uniform of the building programs
+	static glm::vec2 GetImpostorRange(float impostorDistance);
+
+	// Draw the instances that survived Cull as meshes with the currently bound program
+	void Draw() const;
+
+	// Draw the instances that Cull sent to the impostors with the currently bound Vert_BuildingImpostor program
+	void DrawImpostors() const;
+
+	// Draw every instance, culled or not, with the currently bound Vert_BuildingPick program, which finds the
+	// instance's ID in the shader storage buffer at binding 0
+	void DrawIds() const;
+
+	// Draw one building without an instance buffer, through the constant attribute values of the shared Buildings VAO
+	static void DrawSingle(BuildingType type, const glm::vec3 &position, const glm::vec3 &color);
+
+	// Result of the Cull a few frames ago, read back without waiting for the GPU
+	inline unsigned int GetVisibleCount() const noexcept { return m_visibleCount; }
+	inline unsigned int GetCulledCount() const noexcept { return m_culledCount; }
+	inline unsigned int GetImpostorCount() const noexcept { return m_impostorCount; }
+	inline unsigned int GetOccludedCount() const noexcept { return m_occludedCount; } // Part of GetCulledCount
+
+private:
+	// Layout of the commands read by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	struct Batch
+	{
+		GLuint instanceBuffer = 0;
+		std::size_t capacity = 0; // In instances
+		std::size_t uploadedCount = 0;
+		std::size_t dirtyBegin = 0; // Instances from here on differ from the GPU copy
+		std::vector<BuildingInstanceData> instances;
+		std::vector<uint32_t> ids;
+		GLuint idBuffer = 0; // GPU copy of ids, same capacity and dirty range as the instances
+
+		// Bounding sphere of the mesh around the instance position
+		glm::vec4 boundingSphere = glm::vec4(0.0f);
+	};
+
+	static constexpr int READBACK_SLOTS = 3;
+
+	void Reserve(Batch &batch, std::size_t capacity);
+	void ReserveVisible();
+	void ReadBackCounts();
+
+	// A mesh and an impostor command per type, then the counters of drawn and of occluded buildings
+	inline std::size_t GetCommandCount() const noexcept { return 2 * m_batches.size() + 2; }
+
+	std::vector<Batch> m_batches; // One per catalogue type
+
+	// Where each building ID's instance is
+	struct Slot
+	{
+		int type = -1; // -1 for IDs without an instance
+		uint32_t index = 0;
+	};
+	std::vector<Slot> m_slots;
+
+	// The shared mesh buffers of Buildings plus the visible instances, one VAO serves all draw commands
+	GLuint m_vao = 0;
+
+	// The shared mesh buffers of Buildings plus one type's instance buffer at a time, for DrawIds
+	GLuint m_idVao = 0;
+
+	// Index buffer of one quad, the impostors of every type are drawn through it
+	GLuint m_impostorVao = 0;
+	GLuint m_impostorIndexBuffer = 0;
+
+	// Survivors of Cull, each command in its own range starting at its baseInstance
+	GLuint m_visibleBuffer = 0;
+	std::size_t m_visibleCapacity = 0;
+	std::vector<GLuint> m_visibleOffsets; // Per command
+
+	GLuint m_commandBuffer = 0;
+
+	// Copies of the command buffer, read once their fence has passed
+	std::array<GLuint, READBACK_SLOTS> m_readbackBuffers = {};
+	std::array<GLsync, READBACK_SLOTS> m_readbackFences = {};
+	std::array<unsigned int, READBACK_SLOTS> m_readbackTotals = {};
+	int m_nextReadback = 0;
+
+	unsigned int m_visibleCount = 0;
+	unsigned int m_culledCount = 0;
+	unsigned int m_impostorCount = 0;
+	unsigned int m_occludedCount = 0;
+};
@@ -1,330 +1,276 @@
-#include "buildings.hpp"
+#include "Buildings.hpp"
+#include "BuildingCatalogue.h"
+#include "BuildingMeshCache.h"
+#include "GLUtils.hpp"
+#include "ObjParser.h"
+#include "ThreadPool.h"
+#include <SDL2/SDL.h>
+#include <chrono>
 #include <cmath>
-#include <iostream>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <glm/gtc/packing.hpp>
 
-BuildingData Buildings::studioFlatData;
-BuildingData Buildings::smallHouseData;
-BuildingData Buildings::familyHouseData;
-BuildingData Buildings::towerData;
-BuildingData Buildings::apartmentBlockData;
+std::vector<BuildingData> Buildings::types;
 
-void Buildings::Initialize()
-{
-    CreateStudioFlat();
-    CreateSmallHouse();
-    CreateFamilyHouse();
-    CreateTower();
-    CreateApartmentBlock();
-}
+GLuint Buildings::vao = 0;
+GLuint Buildings::vbo = 0;
+GLuint Buildings::ibo = 0;
+GLuint Buildings::textureArray = 0;
 
-void Buildings::Cleanup()
+namespace
 {
-    GLuint vaos[] = {studioFlatData.vao, smallHouseData.vao,
-                     familyHouseData.vao, towerData.vao, apartmentBlockData.vao};
-    GLuint vbos[] = {studioFlatData.vbo, smallHouseData.vbo,
-                     familyHouseData.vbo, towerData.vbo, apartmentBlockData.vbo};
+    // Octahedral mapping of a unit vector to [-1, 1]^2
+    glm::vec2 OctEncode(const glm::vec3 &n)
+    {
+        glm::vec3 v = n / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+        glm::vec2 e(v.x, v.y);
+        if (v.z < 0.0f)
+        {
+            e = (1.0f - glm::abs(glm::vec2(v.y, v.x))) * glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return e;
+    }
 
-    glDeleteVertexArrays(5, vaos);
-    glDeleteBuffers(5, vbos);
+    // A catalogue entry's mesh, mapped from the cache or cooked from the OBJ on this launch
+    struct LoadedMesh
+    {
+        BuildingMeshCache cache;
+        CookedBuildingMesh cooked;
+        bool fromCache = false;
+        bool loaded = false;
+
+        uint32_t GetVertexCount() const { return fromCache ? cache.GetVertexCount() : static_cast<uint32_t>(cooked.vertices.size()); }
+        uint32_t GetIndexCount() const { return fromCache ? cache.GetIndexCount() : static_cast<uint32_t>(cooked.indices.size()); }
+        const Buildings::PackedVertex *GetVertices() const { return fromCache ? cache.GetVertices() : cooked.vertices.data(); }
+        const GLuint *GetIndices() const { return fromCache ? cache.GetIndices() : cooked.indices.data(); }
+        glm::vec3 GetBoundsMin() const { return fromCache ? cache.GetBoundsMin() : cooked.boundsMin; }
+        glm::vec3 GetBoundsMax() const { return fromCache ? cache.GetBoundsMax() : cooked.boundsMax; }
+    };
 }
 
-const BuildingData &Buildings::GetBuildingData(BuildingType type)
+bool Buildings::Initialize(ThreadPool &threadPool)
 {
-    switch (type)
+    Cleanup();
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<BuildingTypeDesc> descs;
+    BuildingCatalogue::Load(CATALOGUE_PATH, descs);
+
+    // A cache hit only maps a file, a miss parses and cooks the OBJ and stores it for the next launch
+    std::vector<LoadedMesh> meshes(descs.size());
+    threadPool.ParallelFor(static_cast<int>(descs.size()), 1, [&](int begin, int end)
+                           {
+        for (int i = begin; i < end; ++i)
+        {
+            LoadedMesh &mesh = meshes[i];
+            const std::string &meshPath = descs[i].meshPath;
+            if (mesh.cache.Open(meshPath))
+            {
+                mesh.fromCache = mesh.loaded = true;
+                continue;
+            }
+
+            try
+            {
+                mesh.cooked = BuildingMeshCache::Cook(ObjParser::parse(meshPath));
+                mesh.loaded = !mesh.cooked.indices.empty();
+            }
+            catch (...)
+            {
+                mesh.loaded = false;
+            }
+
+            if (mesh.loaded)
+                BuildingMeshCache::Write(meshPath, mesh.cooked);
+            else
+                SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot load building mesh %s", meshPath.c_str());
+        } });
+
+    // Types whose mesh failed are left out, the rest keep the catalogue order
+    std::vector<std::string> texturePaths;
+    std::map<std::string, int> textureLayers;
+    std::vector<const LoadedMesh *> typeMeshes;
+    GLint vertexCount = 0;
+    GLuint indexCount = 0;
+    int cachedCount = 0;
+    for (std::size_t i = 0; i < descs.size(); ++i)
     {
-    case STUDIO_FLAT:
-        return studioFlatData;
-    case SMALL_HOUSE:
-        return smallHouseData;
-    case FAMILY_HOUSE:
-        return familyHouseData;
-    case TOWER:
-        return towerData;
-    case APARTMENT_BLOCK:
-        return apartmentBlockData;
-    default:
-        return studioFlatData;
+        const LoadedMesh &mesh = meshes[i];
+        if (!mesh.loaded)
+            continue;
+
+        BuildingData data;
+        data.name = descs[i].name;
+        data.footprint = descs[i].footprint;
+        data.baseVertex = vertexCount;
+        data.firstIndex = indexCount;
+        data.indexCount = static_cast<GLsizei>(mesh.GetIndexCount());
+        data.boundsMin = mesh.GetBoundsMin();
+        data.boundsMax = mesh.GetBoundsMax();
+
+        auto layer = textureLayers.emplace(descs[i].texturePath, static_cast<int>(texturePaths.size()));
+        if (layer.second)
+            texturePaths.push_back(descs[i].texturePath);
+        data.textureLayer = layer.first->second;
+
+        vertexCount += static_cast<GLint>(mesh.GetVertexCount());
+        indexCount += mesh.GetIndexCount();
+        cachedCount += mesh.fromCache ? 1 : 0;
+        types.push_back(data);
+        typeMeshes.push_back(&mesh);
     }
-}
 
-glm::vec2 Buildings::GetBuildingSize(BuildingType type)
-{
-    switch (type)
+    if (types.empty())
     {
-    case STUDIO_FLAT:
-        return glm::vec2(1.0f, 1.0f);
-    case SMALL_HOUSE:
-        return glm::vec2(1.0f, 1.0f);
-    case FAMILY_HOUSE:
-        return glm::vec2(1.5f, 1.0f);
-    case TOWER:
-        return glm::vec2(1.0f, 1.0f);
-    case APARTMENT_BLOCK:
-        return glm::vec2(1.5f, 0.75f);
-    default:
-        return glm::vec2(1.5f, 1.5f);
+        SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "No building type could be loaded from %s", CATALOGUE_PATH);
+        return false;
     }
+
+    // One buffer pair for all types, filled in place through a mapping
+    glCreateBuffers(1, &vbo);
+    glCreateBuffers(1, &ibo);
+    glNamedBufferStorage(vbo, vertexCount * sizeof(PackedVertex), nullptr, GL_MAP_WRITE_BIT);
+    glNamedBufferStorage(ibo, indexCount * sizeof(GLuint), nullptr, GL_MAP_WRITE_BIT);
+    PackedVertex *vertices = static_cast<PackedVertex *>(glMapNamedBufferRange(vbo, 0, vertexCount * sizeof(PackedVertex), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    GLuint *indices = static_cast<GLuint *>(glMapNamedBufferRange(ibo, 0, indexCount * sizeof(GLuint), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+    threadPool.ParallelFor(static_cast<int>(types.size()), 1, [&](int begin, int end)
+                           {
+        for (int type = begin; type < end; ++type)
+        {
+            const BuildingData &data = types[type];
+            const LoadedMesh &mesh = *typeMeshes[type];
+
+            PackedVertex *typeVertices = vertices + data.baseVertex;
+            std::memcpy(typeVertices, mesh.GetVertices(), mesh.GetVertexCount() * sizeof(PackedVertex));
+            std::memcpy(indices + data.firstIndex, mesh.GetIndices(), mesh.GetIndexCount() * sizeof(GLuint));
+
+            // The layer depends on the catalogue, not on the mesh, so the cache leaves it at 0
+            uint16_t layer = glm::packHalf1x16(static_cast<float>(data.textureLayer));
+            for (uint32_t i = 0; i < mesh.GetVertexCount(); ++i)
+            {
+                typeVertices[i].position[3] = layer;
+            }
+        } });
+
+    glUnmapNamedBuffer(vbo);
+    glUnmapNamedBuffer(ibo);
+
+    glCreateVertexArrays(1, &vao);
+    SetupVertexFormat(vao);
+
+    LoadTextures(texturePaths);
+
+    std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Loaded %d building types (%d from cache, %d vertices, %u indices) in %.1f ms",
+                static_cast<int>(types.size()), cachedCount, vertexCount, indexCount, loadTime.count());
+    return true;
 }
 
-void Buildings::SetupVAOVBO(const std::vector<Vertex> &vertices, BuildingData &data)
+void Buildings::Cleanup()
 {
-    glGenVertexArrays(1, &data.vao);
-    glGenBuffers(1, &data.vbo);
-
-    glBindVertexArray(data.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
-    glEnableVertexAttribArray(0);
-    // Normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
-    // Texture coordinate attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, texCoord));
-    glEnableVertexAttribArray(2);
-
-    data.vertexCount = vertices.size();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ibo);
+    glDeleteTextures(1, &textureArray);
+    vao = vbo = ibo = textureArray = 0;
+    types.clear();
 }
 
-void Buildings::AddQuad(std::vector<Vertex> &vertices,
-                        const glm::vec3 &a, const glm::vec3 &b,
-                        const glm::vec3 &c, const glm::vec3 &d,
-                        const glm::vec3 &normal, bool isRoof)
+void Buildings::LoadTextures(const std::vector<std::string> &paths)
 {
+    std::vector<ImageRGBA> images(paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        if (!paths[i].empty())
+            images[i] = ImageFromFile(paths[i]);
+    }
 
-    float texLeft = isRoof ? 0.5f : 0.0f;
-    float texRight = isRoof ? 1.0f : 0.49f;
-
-    vertices.push_back({a, normal, {texLeft, 0.0f}});  // lower left
-    vertices.push_back({b, normal, {texRight, 0.0f}}); // lower right
-    vertices.push_back({c, normal, {texRight, 1.0f}}); // upper right
+    // The array takes the size of the first texture that loaded, a type without one is drawn white
+    const ImageRGBA *reference = nullptr;
+    for (const ImageRGBA &image : images)
+    {
+        if (image.width > 0 && image.height > 0)
+        {
+            reference = &image;
+            break;
+        }
+    }
+    GLsizei width = reference ? reference->width : 1;
+    GLsizei height = reference ? reference->height : 1;
+    std::vector<uint32_t> white(width * height, 0xFFFFFFFFu);
 
-    vertices.push_back({a, normal, {texLeft, 0.0f}});  // lower left
-    vertices.push_back({c, normal, {texRight, 1.0f}}); // upper right
-    vertices.push_back({d, normal, {texLeft, 1.0f}});  // upper left
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &textureArray);
+    glTextureStorage3D(textureArray, reference ? NumberOfMIPLevels(*reference) : 1, GL_RGBA8, width, height, static_cast<GLsizei>(paths.size()));
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        const ImageRGBA &image = images[i];
+        bool fits = image.width == static_cast<unsigned int>(width) && image.height == static_cast<unsigned int>(height);
+        if (!fits && image.width > 0)
+        {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Building texture %s is not %dx%d like the first one, drawing it white",
+                        paths[i].c_str(), width, height);
+        }
+
+        const void *texels = fits ? static_cast<const void *>(image.texelData.data()) : white.data();
+        glTextureSubImage3D(textureArray, 0, 0, 0, static_cast<GLint>(i), width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+    }
+    glGenerateTextureMipmap(textureArray);
 }
 
-void Buildings::AddTriangle(std::vector<Vertex> &vertices,
-                            const glm::vec3 &a, const glm::vec3 &b,
-                            const glm::vec3 &c, const glm::vec3 &normal, bool isRoof)
+void Buildings::SetupVertexFormat(GLuint vertexArray)
 {
-    // Left half (0.0-0.5) for walls, right half (0.5-1.0) for roof
-    float texLeft = isRoof ? 0.5f : 0.0f;
-    float texRight = isRoof ? 1.0f : 0.5f;
-
-    vertices.push_back({a, normal, {texLeft, 0.0f}});
-    vertices.push_back({b, normal, {texRight, 0.0f}});
-    vertices.push_back({c, normal, {texLeft + (texRight - texLeft) * 0.5f, 1.0f}});
+    glVertexArrayVertexBuffer(vertexArray, 0, vbo, 0, sizeof(PackedVertex));
+    glVertexArrayElementBuffer(vertexArray, ibo);
+
+    // Position attribute, w carries the texture layer
+    glEnableVertexArrayAttrib(vertexArray, 0);
+    glVertexArrayAttribFormat(vertexArray, 0, 4, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, position));
+    glVertexArrayAttribBinding(vertexArray, 0, 0);
+    // Normal attribute, decoded from the octahedral mapping in the vertex shader
+    glEnableVertexArrayAttrib(vertexArray, 1);
+    glVertexArrayAttribFormat(vertexArray, 1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal));
+    glVertexArrayAttribBinding(vertexArray, 1, 0);
+    // Texture coordinate attribute
+    glEnableVertexArrayAttrib(vertexArray, 2);
+    glVertexArrayAttribFormat(vertexArray, 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, texCoord));
+    glVertexArrayAttribBinding(vertexArray, 2, 0);
 }
 
-void Buildings::CreateStudioFlat(float sizeXZ)
+void Buildings::Draw(BuildingType type)
 {
-    float sizeY = sizeXZ / 2.0f;
-    float halfXZ = sizeXZ / 2.0f;
-
-    std::vector<Vertex> vertices;
-
-    glm::vec3 positions[8] = {
-        {-halfXZ, 0, halfXZ},     // 0 - front left bottom
-        {halfXZ, 0, halfXZ},      // 1 - front right bottom
-        {halfXZ, sizeY, halfXZ},  // 2 - front right top
-        {-halfXZ, sizeY, halfXZ}, // 3 - front left top
-        {-halfXZ, 0, -halfXZ},    // 4 - back left bottom
-        {halfXZ, 0, -halfXZ},     // 5 - back right bottom
-        {halfXZ, sizeY, -halfXZ}, // 6 - back right top
-        {-halfXZ, sizeY, -halfXZ} // 7 - back left top
-    };
-
-    // Front face
-    AddQuad(vertices, positions[0], positions[1], positions[2], positions[3], {0, 0, 1}, false);
-    // Back face
-    AddQuad(vertices, positions[7], positions[6], positions[5], positions[4], {0, 0, -1}, false);
-    // Right face
-    AddQuad(vertices, positions[1], positions[5], positions[6], positions[2], {1, 0, 0}, false);
-    //// Left face
-    AddQuad(vertices, positions[4], positions[0], positions[3], positions[7], {-1, 0, 0}, false);
-    // Top face
-    AddQuad(vertices, positions[3], positions[2], positions[6], positions[7], {0, 1, 0}, true);
-
-    SetupVAOVBO(vertices, studioFlatData);
+    const BuildingData &data = GetBuildingData(type);
+    glDrawElementsBaseVertex(GL_TRIANGLES, data.indexCount, GL_UNSIGNED_INT,
+                             reinterpret_cast<const void *>(data.firstIndex * sizeof(GLuint)), data.baseVertex);
 }
 
-void Buildings::CreateSmallHouse(float sizeXZ)
+const BuildingData &Buildings::GetBuildingData(BuildingType type)
 {
-    float baseHeight = sizeXZ / 2.0f;
-    float roofHeight = baseHeight;
-    std::vector<Vertex> vertices;
-
-    // Base vertices (same as studio flat)
-    glm::vec3 basePositions[8] = {
-        {-sizeXZ / 2, 0, sizeXZ / 2},
-        {sizeXZ / 2, 0, sizeXZ / 2},
-        {sizeXZ / 2, baseHeight, sizeXZ / 2},
-        {-sizeXZ / 2, baseHeight, sizeXZ / 2},
-        {-sizeXZ / 2, 0, -sizeXZ / 2},
-        {sizeXZ / 2, 0, -sizeXZ / 2},
-        {sizeXZ / 2, baseHeight, -sizeXZ / 2},
-        {-sizeXZ / 2, baseHeight, -sizeXZ / 2}};
-
-    // Add base walls (without top)
-    AddQuad(vertices, basePositions[0], basePositions[1], basePositions[2], basePositions[3], {0, 0, 1}, false);
-    AddQuad(vertices, basePositions[5], basePositions[4], basePositions[7], basePositions[6], {0, 0, -1}, false);
-    AddQuad(vertices, basePositions[1], basePositions[5], basePositions[6], basePositions[2], {1, 0, 0}, false);
-    AddQuad(vertices, basePositions[4], basePositions[0], basePositions[3], basePositions[7], {-1, 0, 0}, false);
-
-    // Roof vertices
-    glm::vec3 roofTop = {0, baseHeight + roofHeight, 0};
-
-    // Roof faces (pyramid)
-    AddTriangle(vertices, basePositions[3], basePositions[2], roofTop,
-                glm::normalize(glm::vec3{-1, roofHeight / (sizeXZ / 2), 0}), true);
-    AddTriangle(vertices, basePositions[2], basePositions[6], roofTop,
-                glm::normalize(glm::vec3{0, roofHeight / (sizeXZ / 2), -1}), true);
-    AddTriangle(vertices, basePositions[6], basePositions[7], roofTop,
-                glm::normalize(glm::vec3{1, roofHeight / (sizeXZ / 2), 0}), true);
-    AddTriangle(vertices, basePositions[7], basePositions[3], roofTop,
-                glm::normalize(glm::vec3{0, roofHeight / (sizeXZ / 2), 1}), true);
-
-    SetupVAOVBO(vertices, smallHouseData);
+    return types[type];
 }
 
-void Buildings::CreateFamilyHouse(float sizeX, float sizeZ, float height)
+glm::vec2 Buildings::GetBuildingSize(BuildingType type)
 {
-    std::vector<Vertex> vertices;
-    height *= 0.5f;
-
-    // Main part of the house (longer part of the L)
-    float mainSizeX = sizeX * 0.6f;
-    float mainSizeZ = sizeZ * 0.6f;
-
-    // Calculate total dimensions including extension
-    float totalSizeX = mainSizeX + sizeX * 0.4f;
-    float centerOffsetX = totalSizeX / 2 - mainSizeX / 2;
-
-    glm::vec3 mainPositions[8] = {
-        {-mainSizeX / 2 - centerOffsetX, 0, mainSizeZ / 2},      // Front-left-bottom
-        {mainSizeX / 2 - centerOffsetX, 0, mainSizeZ / 2},       // Front-right-bottom
-        {mainSizeX / 2 - centerOffsetX, height, mainSizeZ / 2},  // Front-right-top
-        {-mainSizeX / 2 - centerOffsetX, height, mainSizeZ / 2}, // Front-left-top
-        {-mainSizeX / 2 - centerOffsetX, 0, -mainSizeZ / 2},     // Back-left-bottom
-        {mainSizeX / 2 - centerOffsetX, 0, -mainSizeZ / 2},      // Back-right-bottom
-        {mainSizeX / 2 - centerOffsetX, height, -mainSizeZ / 2}, // Back-right-top
-        {-mainSizeX / 2 - centerOffsetX, height, -mainSizeZ / 2} // Back-left-top
-    };
-
-    // Extension part (shorter part of the L)
-    float extSizeX = sizeX * 0.4f;
-    float extSizeZ = sizeZ * 0.4f;
-
-    // Position the extension to form an L shape (attached to the back-right of the main part)
-    float extOffsetX = mainSizeX / 2 - centerOffsetX; // Extend along X-axis (right side)
-    float extOffsetZ = -mainSizeZ / 2;                // Extend along Z-axis (back side)
-
-    glm::vec3 extPositions[8] = {
-        {extOffsetX, 0, extOffsetZ + extSizeZ},                 // Front-left-bottom
-        {extOffsetX + extSizeX, 0, extOffsetZ + extSizeZ},      // Front-right-bottom
-        {extOffsetX + extSizeX, height, extOffsetZ + extSizeZ}, // Front-right-top
-        {extOffsetX, height, extOffsetZ + extSizeZ},            // Front-left-top
-        {extOffsetX, 0, extOffsetZ},                            // Back-left-bottom
-        {extOffsetX + extSizeX, 0, extOffsetZ},                 // Back-right-bottom
-        {extOffsetX + extSizeX, height, extOffsetZ},            // Back-right-top
-        {extOffsetX, height, extOffsetZ}                        // Back-left-top
-    };
-
-    // Add main part walls
-    AddQuad(vertices, mainPositions[0], mainPositions[1], mainPositions[2], mainPositions[3], {0, 0, 1}, false);  // Front
-    AddQuad(vertices, mainPositions[5], mainPositions[4], mainPositions[7], mainPositions[6], {0, 0, -1}, false); // Back
-    AddQuad(vertices, mainPositions[1], mainPositions[5], mainPositions[6], mainPositions[2], {1, 0, 0}, false);  // Right
-    AddQuad(vertices, mainPositions[4], mainPositions[0], mainPositions[3], mainPositions[7], {-1, 0, 0}, false); // Left
-    AddQuad(vertices, mainPositions[3], mainPositions[2], mainPositions[6], mainPositions[7], {0, 1, 0}, true);   // Top
-
-    // Add extension walls (excluding the wall that connects to the main part)
-    AddQuad(vertices, extPositions[0], extPositions[1], extPositions[2], extPositions[3], {0, 0, 1}, false);  // Front
-    AddQuad(vertices, extPositions[5], extPositions[4], extPositions[7], extPositions[6], {0, 0, -1}, false); // Back
-    AddQuad(vertices, extPositions[1], extPositions[5], extPositions[6], extPositions[2], {1, 0, 0}, false);  // Right
-    // Left wall is not added (it connects to the main part)
-    AddQuad(vertices, extPositions[3], extPositions[2], extPositions[6], extPositions[7], {0, 1, 0}, true); // Top
-
-    // Add connecting wall between main and extension
-    glm::vec3 conn1 = mainPositions[5]; // Main back-right-bottom
-    glm::vec3 conn2 = extPositions[4];  // Ext back-left-bottom
-    glm::vec3 conn3 = extPositions[7];  // Ext back-left-top
-    glm::vec3 conn4 = mainPositions[6]; // Main back-right-top
-
-    AddQuad(vertices, conn1, conn2, conn3, conn4,
-            glm::normalize(glm::cross(conn2 - conn1, conn3 - conn1)), false);
-
-    SetupVAOVBO(vertices, familyHouseData);
+    return types[type].footprint;
 }
 
-void Buildings::CreateTower(float radius, float height)
+glm::vec4 Buildings::GetBoundingSphere(BuildingType type)
 {
-    std::vector<Vertex> vertices;
-    const int segments = 8;
-    const float pi = 3.14159265358979323846f;
-
-    // Cylinder side (reverse vertex order to flip normals)
-    for (int i = 0; i < segments; i++)
-    {
-        float angle1 = 2.0f * pi * float(i) / float(segments);
-        float angle2 = 2.0f * pi * float(i + 1) / float(segments);
-
-        glm::vec3 p1 = {radius * cosf(angle1), 0, radius * sinf(angle1)};
-        glm::vec3 p2 = {radius * cosf(angle2), 0, radius * sinf(angle2)};
-        glm::vec3 p3 = {radius * cosf(angle2), height, radius * sinf(angle2)};
-        glm::vec3 p4 = {radius * cosf(angle1), height, radius * sinf(angle1)};
-
-        glm::vec3 normal = {cosf(angle1), 0, sinf(angle1)};
-
-        // Reverse vertex order to flip the face
-        AddQuad(vertices, p4, p3, p2, p1, normal, false);
-    }
-
-    // Top circle (roof) - reverse vertex order
-    glm::vec3 centerTop = {0, height, 0};
-    for (int i = 0; i < segments; i++)
-    {
-        float angle1 = 2.0f * pi * float(i) / float(segments);
-        float angle2 = 2.0f * pi * float(i + 1) / float(segments);
-
-        glm::vec3 p1 = {radius * cosf(angle1), height, radius * sinf(angle1)};
-        glm::vec3 p2 = {radius * cosf(angle2), height, radius * sinf(angle2)};
-
-        // Reverse vertex order to flip the face
-        AddTriangle(vertices, centerTop, p2, p1, {0, 1, 0}, true);
-    }
-
-    SetupVAOVBO(vertices, towerData);
+    const BuildingData &data = types[type];
+    glm::vec3 center = (data.boundsMin + data.boundsMax) * 0.5f;
+    return glm::vec4(center, glm::distance(center, data.boundsMax));
 }
 
-void Buildings::CreateApartmentBlock(float sizeXY)
+Buildings::PackedVertex Buildings::PackVertex(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoord)
 {
-    float sizeZ = sizeXY / 2.0f;
-    std::vector<Vertex> vertices;
-
-    glm::vec3 positions[8] = {
-        {-sizeXY / 2, 0, sizeZ / 2},
-        {sizeXY / 2, 0, sizeZ / 2},
-        {sizeXY / 2, sizeXY, sizeZ / 2},
-        {-sizeXY / 2, sizeXY, sizeZ / 2},
-        {-sizeXY / 2, 0, -sizeZ / 2},
-        {sizeXY / 2, 0, -sizeZ / 2},
-        {sizeXY / 2, sizeXY, -sizeZ / 2},
-        {-sizeXY / 2, sizeXY, -sizeZ / 2}};
-
-    // Front face
-    AddQuad(vertices, positions[0], positions[1], positions[2], positions[3], {0, 0, 1}, false);
-    // Back face
-    AddQuad(vertices, positions[5], positions[4], positions[7], positions[6], {0, 0, -1}, false);
-    // Right face
-    AddQuad(vertices, positions[1], positions[5], positions[6], positions[2], {1, 0, 0}, false);
-    // Left face
-    AddQuad(vertices, positions[4], positions[0], positions[3], positions[7], {-1, 0, 0}, false);
-    // Top face (roof)
-    AddQuad(vertices, positions[3], positions[2], positions[6], positions[7], {0, 1, 0}, true);
-    // Bottom face (not added - covered by terrain)
-
-    SetupVAOVBO(vertices, apartmentBlockData);
-}
\ No newline at end of file
+    PackedVertex packed;
+    packed.position[0] = glm::packHalf1x16(position.x);
+    packed.position[1] = glm::packHalf1x16(position.y);
+    packed.position[2] = glm::packHalf1x16(position.z);
+    packed.position[3] = 0;
+    packed.normal = glm::packSnorm2x16(OctEncode(glm::normalize(normal)));
+    packed.texCoord = glm::packUnorm2x16(glm::clamp(texCoord, 0.0f, 1.0f));
+    return packed;
+}
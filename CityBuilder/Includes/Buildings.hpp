@@ -3,60 +3,78 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
 #include <vector>
 
-enum BuildingType
-{
-    STUDIO_FLAT,
-    SMALL_HOUSE,
-    FAMILY_HOUSE,
-    TOWER,
-    APARTMENT_BLOCK
-};
+class ThreadPool;
+
+// Index of a building type in the catalogue
+using BuildingType = uint32_t;
 
+// A building type of the catalogue and its range in the shared vertex and index buffers
 struct BuildingData
 {
-    GLuint vao;
-    GLuint vbo;
-    int vertexCount;
+    std::string name;
+    glm::vec2 footprint;
+    GLint baseVertex;
+    GLuint firstIndex;
+    GLsizei indexCount;
+    int textureLayer;
+    glm::vec3 boundsMin; // Exact box of the mesh in model space
+    glm::vec3 boundsMax;
 };
 
 class Buildings
 {
 public:
-    static void Initialize();
+    // Quantized vertex of the shared buffer: half float position, octahedral snorm16 normal, unorm16 texture coordinates
+    struct PackedVertex
+    {
+        uint16_t position[4]; // xyz, w is the layer of the type's texture
+        uint32_t normal;
+        uint32_t texCoord;
+    };
+
+    static constexpr const char *CATALOGUE_PATH = "Assets/Buildings/Catalogue.txt";
+
+    // Load every type of the catalogue, the meshes in parallel on the pool. Returns false if no type could be loaded
+    static bool Initialize(ThreadPool &threadPool);
     static void Cleanup();
+
+    static BuildingType GetTypeCount() { return static_cast<BuildingType>(types.size()); }
     static const BuildingData &GetBuildingData(BuildingType type);
     static glm::vec2 GetBuildingSize(BuildingType type);
 
+    // Sphere around the center of the type's box in model space, xyz center and w radius
+    static glm::vec4 GetBoundingSphere(BuildingType type);
+
+    // Every type's mesh lives in these, indexed with GLuint indices relative to the type's base vertex
+    static GLuint GetVertexArray() { return vao; }
+    static GLuint GetVertexBuffer() { return vbo; }
+    static GLuint GetIndexBuffer() { return ibo; }
+
+    // Diffuse maps of the types, one layer per distinct texture of the catalogue
+    static GLuint GetTextureArray() { return textureArray; }
+
+    // Attributes 0-2 of the shared buffer on binding 0 of the given VAO
+    static void SetupVertexFormat(GLuint vertexArray);
+
+    // Draw one building with the bound program, the shared VAO has to be bound
+    static void Draw(BuildingType type);
+
+    // Quantize a vertex into the layout of the shared buffer
+    static PackedVertex PackVertex(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoord);
+
 private:
-    static void CreateStudioFlat(float sizeXZ = 2.0f);
-    static void CreateSmallHouse(float sizeXZ = 2.0f);
-    static void CreateFamilyHouse(float sizeX = 3.0f, float sizeZ = 4.0f, float height = 2.5f);
-    static void CreateTower(float radius = 1.0f, float height = 4.0f);
-    static void CreateApartmentBlock(float sizeXY = 3.0f);
-
-    static BuildingData studioFlatData;
-    static BuildingData smallHouseData;
-    static BuildingData familyHouseData;
-    static BuildingData towerData;
-    static BuildingData apartmentBlockData;
-
-    struct Vertex
-    {
-        glm::vec3 position;
-        glm::vec3 normal;
-        glm::vec2 texCoord;
-    };
+    static std::vector<BuildingData> types;
+
+    static GLuint vao;
+    static GLuint vbo;
+    static GLuint ibo;
+    static GLuint textureArray;
 
-    static void SetupVAOVBO(const std::vector<Vertex> &vertices, BuildingData &data);
-    static void AddQuad(std::vector<Vertex> &vertices,
-                        const glm::vec3 &a, const glm::vec3 &b,
-                        const glm::vec3 &c, const glm::vec3 &d,
-                        const glm::vec3 &normal, bool isRoof);
-    static void AddTriangle(std::vector<Vertex> &vertices,
-                            const glm::vec3 &a, const glm::vec3 &b,
-                            const glm::vec3 &c, const glm::vec3 &normal, bool isRoof);
+    static void LoadTextures(const std::vector<std::string> &paths);
 };
 
-#endif
\ No newline at end of file
+#endif
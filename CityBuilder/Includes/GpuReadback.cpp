@@ -0,0 +1,177 @@
+#include "GpuReadback.h"
+
+#include <utility>
+
+namespace
+{
+	// Keeps every slot aligned for any pixel type we read
+	constexpr std::size_t SLOT_ALIGNMENT = 16;
+
+	// Waiting longer than this in Flush means the GPU is badly behind, give up on the request
+	constexpr GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+}
+
+GpuReadback::~GpuReadback()
+{
+	Destroy();
+}
+
+void GpuReadback::Create(std::size_t slotSize)
+{
+	Destroy();
+
+	m_slotSize = (slotSize + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+	const GLsizeiptr totalSize = static_cast<GLsizeiptr>(m_slotSize * SLOT_COUNT);
+	const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &m_ringBuffer);
+	glNamedBufferStorage(m_ringBuffer, totalSize, nullptr, flags);
+	m_mapped = static_cast<const unsigned char *>(glMapNamedBufferRange(m_ringBuffer, 0, totalSize, flags));
+}
+
+void GpuReadback::Destroy()
+{
+	for (Request &request : m_requests)
+	{
+		glDeleteSync(request.fence);
+		glDeleteBuffers(1, &request.buffer);
+	}
+	m_requests.clear();
+	m_slotBusy.fill(false);
+
+	if (m_ringBuffer != 0)
+	{
+		glUnmapNamedBuffer(m_ringBuffer);
+		glDeleteBuffers(1, &m_ringBuffer);
+	}
+	m_ringBuffer = 0;
+	m_mapped = nullptr;
+	m_slotSize = 0;
+}
+
+void GpuReadback::ReadPixels(GLuint framebuffer, int x, int y, int width, int height, GLenum format, GLenum type, std::size_t size, Callback callback)
+{
+	Request request = Allocate(size, std::move(callback));
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, GetBuffer(request));
+	glReadPixels(x, y, width, height, format, type, reinterpret_cast<void *>(request.offset));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	Submit(std::move(request));
+}
+
+void GpuReadback::ReadTexture(GLuint texture, int level, GLenum format, GLenum type, std::size_t size, Callback callback)
+{
+	Request request = Allocate(size, std::move(callback));
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, GetBuffer(request));
+	glGetTextureImage(texture, level, format, type, static_cast<GLsizei>(size), reinterpret_cast<void *>(request.offset));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	Submit(std::move(request));
+}
+
+void GpuReadback::ReadBuffer(GLuint buffer, std::size_t offset, std::size_t size, Callback callback)
+{
+	Request request = Allocate(size, std::move(callback));
+	glCopyNamedBufferSubData(buffer, GetBuffer(request), static_cast<GLintptr>(offset), static_cast<GLintptr>(request.offset), static_cast<GLsizeiptr>(size));
+	Submit(std::move(request));
+}
+
+void GpuReadback::Update()
+{
+	// In order, a later copy is not done before an earlier one anyway
+	while (!m_requests.empty())
+	{
+		GLenum status = glClientWaitSync(m_requests.front().fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+
+		// Popped first, the callback may queue new requests
+		Request request = std::move(m_requests.front());
+		m_requests.pop_front();
+		Complete(request);
+	}
+}
+
+void GpuReadback::Flush()
+{
+	while (!m_requests.empty())
+	{
+		Request request = std::move(m_requests.front());
+		m_requests.pop_front();
+
+		GLenum status = glClientWaitSync(request.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			Complete(request);
+			continue;
+		}
+
+		glDeleteSync(request.fence);
+		glDeleteBuffers(1, &request.buffer);
+		if (request.slot >= 0)
+			m_slotBusy[request.slot] = false;
+	}
+}
+
+GpuReadback::Request GpuReadback::Allocate(std::size_t size, Callback callback)
+{
+	Request request;
+	request.size = size;
+	request.callback = std::move(callback);
+
+	if (m_mapped != nullptr && size <= m_slotSize)
+	{
+		for (int slot = 0; slot < SLOT_COUNT; ++slot)
+		{
+			if (!m_slotBusy[slot])
+			{
+				m_slotBusy[slot] = true;
+				request.slot = slot;
+				request.offset = slot * m_slotSize;
+				return request;
+			}
+		}
+	}
+
+	glCreateBuffers(1, &request.buffer);
+	glNamedBufferStorage(request.buffer, static_cast<GLsizeiptr>(size), nullptr, GL_MAP_READ_BIT);
+	return request;
+}
+
+GLuint GpuReadback::GetBuffer(const Request &request) const
+{
+	return request.buffer != 0 ? request.buffer : m_ringBuffer;
+}
+
+void GpuReadback::Submit(Request request)
+{
+	request.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_requests.push_back(std::move(request));
+}
+
+void GpuReadback::Complete(Request &request)
+{
+	glDeleteSync(request.fence);
+	request.fence = nullptr;
+
+	if (request.buffer != 0)
+	{
+		// Own buffers are mapped only now that the copy is done, so the map never waits
+		const void *data = glMapNamedBufferRange(request.buffer, 0, static_cast<GLsizeiptr>(request.size), GL_MAP_READ_BIT);
+		if (data != nullptr && request.callback)
+			request.callback(data, request.size);
+		glUnmapNamedBuffer(request.buffer);
+		glDeleteBuffers(1, &request.buffer);
+		request.buffer = 0;
+		return;
+	}
+
+	// Freed only after the callback, a request it queues must not overwrite the data it is reading
+	if (request.callback)
+		request.callback(m_mapped + request.offset, request.size);
+	m_slotBusy[request.slot] = false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <functional>
+
+#include <GL/glew.h>
+
+// Copies GPU data back to the CPU without stalling the pipeline. A request records the copy into a pixel pack buffer
+// and fences it, Update polls the fences once a frame and hands every finished copy to its callback, usually a frame
+// or two after the request. Small requests share a persistently mapped ring of slots, larger ones and those that find
+// the ring full get a buffer of their own. Callbacks run on the GL thread inside Update, in the order of the requests.
+class GpuReadback
+{
+public:
+	// data is only valid during the call
+	using Callback = std::function<void(const void *data, std::size_t size)>;
+
+	static constexpr int SLOT_COUNT = 8;
+
+	GpuReadback() = default;
+	~GpuReadback();
+
+	GpuReadback(const GpuReadback &) = delete;
+	GpuReadback &operator=(const GpuReadback &) = delete;
+
+	void Create(std::size_t slotSize);
+	// Requests still in flight are dropped without calling back
+	void Destroy();
+
+	// size is the byte count of the pixels in the current pack state, i.e. with GL_PACK_ALIGNMENT padding.
+	// framebuffer 0 reads the window
+	void ReadPixels(GLuint framebuffer, int x, int y, int width, int height, GLenum format, GLenum type, std::size_t size, Callback callback);
+	void ReadTexture(GLuint texture, int level, GLenum format, GLenum type, std::size_t size, Callback callback);
+	void ReadBuffer(GLuint buffer, std::size_t offset, std::size_t size, Callback callback);
+
+	// Call back the finished requests, never waits
+	void Update();
+	// Wait for every request and call back, for a caller that cannot go on without the data
+	void Flush();
+
+	inline std::size_t GetPendingCount() const noexcept { return m_requests.size(); }
+
+private:
+	struct Request
+	{
+		GLsync fence = nullptr;
+		GLuint buffer = 0; // Own buffer of the request, 0 if it uses a slot of the ring
+		int slot = -1;
+		std::size_t offset = 0; // In buffer, or in the ring
+		std::size_t size = 0;
+		Callback callback;
+	};
+
+	// A free slot of the ring if size fits, an own buffer otherwise
+	Request Allocate(std::size_t size, Callback callback);
+	GLuint GetBuffer(const Request &request) const;
+	void Submit(Request request);
+	void Complete(Request &request);
+
+	GLuint m_ringBuffer = 0;
+	const unsigned char *m_mapped = nullptr;
+	std::size_t m_slotSize = 0;
+	std::array<bool, SLOT_COUNT> m_slotBusy = {};
+
+	std::deque<Request> m_requests;
+};
@@ -0,0 +1,45 @@
+#include "GpuTimer.h"
+
+GpuTimer::~GpuTimer()
+{
+	Destroy();
+}
+
+void GpuTimer::Create()
+{
+	Destroy();
+	glCreateQueries(GL_TIME_ELAPSED, QUERY_COUNT, m_queries.data());
+}
+
+void GpuTimer::Destroy()
+{
+	if (m_queries[0] != 0)
+		glDeleteQueries(QUERY_COUNT, m_queries.data());
+
+	m_queries.fill(0);
+	m_pending.fill(false);
+	m_next = 0;
+}
+
+void GpuTimer::Begin()
+{
+	GLuint query = m_queries[m_next];
+
+	// The slot was used QUERY_COUNT frames ago, its result is normally long available
+	if (m_pending[m_next])
+	{
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		m_lastMs = static_cast<float>(nanoseconds / 1e6);
+		++m_resultCount;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void GpuTimer::End()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	m_pending[m_next] = true;
+	m_next = (m_next + 1) % QUERY_COUNT;
+}
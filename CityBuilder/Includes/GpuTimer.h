@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+
+#include <GL/glew.h>
+
+// Measures the GPU time of the commands between Begin and End with GL_TIME_ELAPSED queries.
+// Each query is only read back when its slot comes around again a few frames later, so it never stalls.
+class GpuTimer
+{
+public:
+	GpuTimer() = default;
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer &) = delete;
+	GpuTimer &operator=(const GpuTimer &) = delete;
+
+	void Create();
+	void Destroy();
+
+	void Begin();
+	void End();
+
+	// Most recent finished measurement, and how many measurements finished so far
+	inline float GetLastMs() const noexcept { return m_lastMs; }
+	inline unsigned int GetResultCount() const noexcept { return m_resultCount; }
+
+private:
+	static constexpr int QUERY_COUNT = 4;
+
+	std::array<GLuint, QUERY_COUNT> m_queries = {};
+	std::array<bool, QUERY_COUNT> m_pending = {};
+	int m_next = 0;
+
+	float m_lastMs = 0.0f;
+	unsigned int m_resultCount = 0;
+};
@@ -0,0 +1,89 @@
+#include "HiZBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "GLUtils.hpp"
+
+namespace
+{
+	// local_size_x and local_size_y of Comp_HiZReduce.comp
+	constexpr int REDUCE_GROUP_SIZE = 8;
+}
+
+HiZBuffer::~HiZBuffer()
+{
+	Destroy();
+}
+
+void HiZBuffer::Resize(int viewportWidth, int viewportHeight)
+{
+	Destroy();
+	m_width = std::max(1, viewportWidth / RESOLUTION_DIVISOR);
+	m_height = std::max(1, viewportHeight / RESOLUTION_DIVISOR);
+	m_levelCount = static_cast<int>(std::floor(std::log2(static_cast<float>(std::max(m_width, m_height))))) + 1;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_depthTexture);
+	glTextureStorage2D(m_depthTexture, 1, GL_DEPTH_COMPONENT32F, m_width, m_height);
+	glTextureParameteri(m_depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_pyramidTexture);
+	glTextureStorage2D(m_pyramidTexture, m_levelCount, GL_R32F, m_width, m_height);
+	glTextureParameteri(m_pyramidTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(m_pyramidTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(m_pyramidTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_pyramidTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glCreateFramebuffers(1, &m_frameBuffer);
+	glNamedFramebufferTexture(m_frameBuffer, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
+	glNamedFramebufferDrawBuffer(m_frameBuffer, GL_NONE);
+}
+
+void HiZBuffer::Destroy()
+{
+	glDeleteFramebuffers(1, &m_frameBuffer);
+	glDeleteTextures(1, &m_depthTexture);
+	glDeleteTextures(1, &m_pyramidTexture);
+	m_frameBuffer = 0;
+	m_depthTexture = 0;
+	m_pyramidTexture = 0;
+	m_width = m_height = m_levelCount = 0;
+}
+
+void HiZBuffer::BeginDepthPass()
+{
+	glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+	glViewport(0, 0, m_width, m_height);
+
+	const GLfloat clearDepth = 1.0f;
+	glClearNamedFramebufferfv(m_frameBuffer, GL_DEPTH, 0, &clearDepth);
+}
+
+void HiZBuffer::EndDepthPass()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+}
+
+void HiZBuffer::BuildPyramid()
+{
+	// Level 0 is a copy of the depth, every further level reads the one before it
+	glUniform1i(ul("source"), 0);
+	GLint ulSourceLevel = ul("sourceLevel");
+	for (int level = 0; level < m_levelCount; ++level)
+	{
+		int width = std::max(1, m_width >> level);
+		int height = std::max(1, m_height >> level);
+
+		glBindTextureUnit(0, level == 0 ? m_depthTexture : m_pyramidTexture);
+		glUniform1i(ulSourceLevel, std::max(0, level - 1));
+		glBindImageTexture(0, m_pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindTextureUnit(0, 0);
+}
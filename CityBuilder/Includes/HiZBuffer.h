@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Depth of the occluders at a fraction of the viewport resolution, and a pyramid of it where every texel holds
+// the farthest depth of the texels below it. Anything whose nearest depth is farther than a pyramid texel
+// covering its screen rectangle is hidden, whatever level the texel is on.
+class HiZBuffer
+{
+public:
+	static constexpr int RESOLUTION_DIVISOR = 2;
+
+	HiZBuffer() = default;
+	~HiZBuffer();
+
+	HiZBuffer(const HiZBuffer &) = delete;
+	HiZBuffer &operator=(const HiZBuffer &) = delete;
+
+	void Resize(int viewportWidth, int viewportHeight);
+	void Destroy();
+
+	// Bind and clear the depth target, the occluders are drawn with any program in between
+	void BeginDepthPass();
+	void EndDepthPass();
+
+	// Reduce the depth into the pyramid with the currently bound Comp_HiZReduce program
+	void BuildPyramid();
+
+	inline GLuint GetPyramidTexture() const noexcept { return m_pyramidTexture; }
+	inline int GetWidth() const noexcept { return m_width; }
+	inline int GetHeight() const noexcept { return m_height; }
+	inline int GetLevelCount() const noexcept { return m_levelCount; }
+
+private:
+	GLuint m_frameBuffer = 0;
+	GLuint m_depthTexture = 0;
+	GLuint m_pyramidTexture = 0; // R32F, full mip chain
+
+	int m_width = 0;
+	int m_height = 0;
+	int m_levelCount = 0;
+
+	GLint m_previousViewport[4] = {};
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// Map the file at path, replacing any previous mapping. Returns false if it cannot be opened or is empty
+	bool Open(const std::string &path);
+	void Close();
+
+	inline bool IsOpen() const noexcept { return m_data != nullptr; }
+	inline const unsigned char *GetData() const noexcept { return m_data; }
+	inline std::size_t GetSize() const noexcept { return m_size; }
+
+private:
+	const unsigned char *m_data = nullptr;
+	std::size_t m_size = 0;
+
+#ifdef _WIN32
+	void *m_file = nullptr;
+	void *m_mapping = nullptr;
+#endif
+};
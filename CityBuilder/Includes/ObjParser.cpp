@@ -110,6 +110,10 @@ ObjParser::Mesh ObjParser::parse(const std::filesystem::path &fileName)
 	{
 		std::string_view token = tokenizer.NextToken();
 
+		// Only whitespace was left after the last line
+		if (token.empty())
+			break;
+
 		if (token[0] == '#')
 		{
 			tokenizer.ToNextLine();
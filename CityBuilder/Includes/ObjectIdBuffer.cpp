@@ -0,0 +1,89 @@
+#include "ObjectIdBuffer.h"
+#include "GpuReadback.h"
+
+#include <algorithm>
+#include <cstring>
+
+ObjectIdBuffer::~ObjectIdBuffer()
+{
+	Destroy();
+}
+
+void ObjectIdBuffer::Resize(int viewportWidth, int viewportHeight)
+{
+	Destroy();
+	m_viewportWidth = std::max(1, viewportWidth);
+	m_viewportHeight = std::max(1, viewportHeight);
+	m_width = std::max(1, viewportWidth / RESOLUTION_DIVISOR);
+	m_height = std::max(1, viewportHeight / RESOLUTION_DIVISOR);
+
+	glCreateRenderbuffers(1, &m_idBuffer);
+	glNamedRenderbufferStorage(m_idBuffer, GL_R32UI, m_width, m_height);
+	glCreateRenderbuffers(1, &m_depthBuffer);
+	glNamedRenderbufferStorage(m_depthBuffer, GL_DEPTH_COMPONENT24, m_width, m_height);
+
+	glCreateFramebuffers(1, &m_frameBuffer);
+	glNamedFramebufferRenderbuffer(m_frameBuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_idBuffer);
+	glNamedFramebufferRenderbuffer(m_frameBuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	glNamedFramebufferReadBuffer(m_frameBuffer, GL_COLOR_ATTACHMENT0);
+}
+
+void ObjectIdBuffer::Destroy()
+{
+	glDeleteFramebuffers(1, &m_frameBuffer);
+	glDeleteRenderbuffers(1, &m_idBuffer);
+	glDeleteRenderbuffers(1, &m_depthBuffer);
+	m_frameBuffer = 0;
+	m_idBuffer = 0;
+	m_depthBuffer = 0;
+	m_viewportWidth = m_viewportHeight = m_width = m_height = 0;
+	m_values.clear();
+}
+
+void ObjectIdBuffer::BeginPass()
+{
+	glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+	glViewport(0, 0, m_width, m_height);
+
+	const GLuint clearObject = NO_OBJECT;
+	const GLfloat clearDepth = 1.0f;
+	glClearNamedFramebufferuiv(m_frameBuffer, GL_COLOR, 0, &clearObject);
+	glClearNamedFramebufferfv(m_frameBuffer, GL_DEPTH, 0, &clearDepth);
+}
+
+void ObjectIdBuffer::EndPass()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+}
+
+void ObjectIdBuffer::ReadBack(GpuReadback &readback, std::function<void()> onReady)
+{
+	// Rows of four byte texels need no padding at the default pack alignment
+	const std::size_t size = static_cast<std::size_t>(m_width) * m_height * sizeof(uint32_t);
+	readback.ReadPixels(m_frameBuffer, 0, 0, m_width, m_height, GL_RED_INTEGER, GL_UNSIGNED_INT, size, [this, onReady](const void *data, std::size_t size)
+											{
+		// A resize in the meantime makes the copy useless
+		if (size == static_cast<std::size_t>(m_width) * m_height * sizeof(uint32_t))
+		{
+			m_values.resize(size / sizeof(uint32_t));
+			std::memcpy(m_values.data(), data, size);
+		}
+		onReady(); });
+}
+
+uint32_t ObjectIdBuffer::GetObject(const glm::ivec2 &cursor) const
+{
+	if (m_values.empty() || cursor.x < 0 || cursor.y < 0 || cursor.x >= m_viewportWidth || cursor.y >= m_viewportHeight)
+		return NO_OBJECT;
+
+	int x = std::min(cursor.x * m_width / m_viewportWidth, m_width - 1);
+	int y = std::min((m_viewportHeight - 1 - cursor.y) * m_height / m_viewportHeight, m_height - 1);
+	return m_values[y * m_width + x];
+}
+
+glm::vec2 ObjectIdBuffer::GetTerrainUV(uint32_t object)
+{
+	return glm::vec2(object & 0xFFFFu, (object >> 16) & 0x7FFFu) / glm::vec2(65535.0f, 32767.0f);
+}
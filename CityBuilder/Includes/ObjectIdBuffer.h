@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class GpuReadback;
+
+// Stable ID of the object covering every pixel, at a fraction of the viewport resolution. Drawn only when something
+// has to be looked up in it and copied back to the CPU whole, so further clicks on the same view need no GPU work.
+// Buildings write their BuildingRegistry ID with BUILDING_BIT set (Frag_BuildingPick.frag), the terrain is object 0
+// and packs its heightmap UV into the remaining 31 bits (Frag_TerrainPick.frag).
+class ObjectIdBuffer
+{
+public:
+	static constexpr int RESOLUTION_DIVISOR = 2;
+
+	static constexpr uint32_t NO_OBJECT = UINT32_MAX; // The sky
+	static constexpr uint32_t BUILDING_BIT = 0x80000000u;
+
+	ObjectIdBuffer() = default;
+	~ObjectIdBuffer();
+
+	ObjectIdBuffer(const ObjectIdBuffer &) = delete;
+	ObjectIdBuffer &operator=(const ObjectIdBuffer &) = delete;
+
+	// Drops the CPU copy as well, it belongs to the old size
+	void Resize(int viewportWidth, int viewportHeight);
+	void Destroy();
+
+	// Bind and clear the target, the objects are drawn with their pick programs in between
+	void BeginPass();
+	void EndPass();
+
+	// Copy the target to the CPU, onReady runs once GetObject answers from the copy
+	void ReadBack(GpuReadback &readback, std::function<void()> onReady);
+
+	inline bool HasValues() const noexcept { return !m_values.empty(); }
+	// Object at a window position, origin at the top left as in mouse events, of the last copy
+	uint32_t GetObject(const glm::ivec2 &cursor) const;
+
+	static inline bool IsBuilding(uint32_t object) noexcept { return object != NO_OBJECT && (object & BUILDING_BIT) != 0; }
+	static inline uint32_t GetBuildingId(uint32_t object) noexcept { return object & ~BUILDING_BIT; }
+	static inline bool IsTerrain(uint32_t object) noexcept { return (object & BUILDING_BIT) == 0; }
+	// Inverse of the packing in Frag_TerrainPick.frag
+	static glm::vec2 GetTerrainUV(uint32_t object);
+
+	inline int GetWidth() const noexcept { return m_width; }
+	inline int GetHeight() const noexcept { return m_height; }
+
+private:
+	GLuint m_frameBuffer = 0;
+	GLuint m_idBuffer = 0;		// R32UI
+	GLuint m_depthBuffer = 0;
+
+	int m_viewportWidth = 0;
+	int m_viewportHeight = 0;
+	int m_width = 0;
+	int m_height = 0;
+
+	std::vector<uint32_t> m_values; // Bottom row first, as GL reads them
+
+	GLint m_previousViewport[4] = {};
+};
@@ -0,0 +1,392 @@
+#include "Perlin.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PERLIN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC allows intrinsics of any instruction set without extra flags
+#define PERLIN_TARGET(isa)
+#else
+// GCC/Clang only emit the instructions inside functions marked for them; the CPU is checked at runtime
+#define PERLIN_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+// All kernels below evaluate the same float expressions in the same order (no FMA contraction),
+// which keeps their output identical to noise2D().
+
+namespace
+{
+    inline float Fade(float t)
+    {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    }
+
+    inline float Lerp(float t, float a, float b)
+    {
+        return a + t * (b - a);
+    }
+
+    // grad() with z = 0
+    inline float Grad2(int hash, float x, float y)
+    {
+        int h = hash & 15;
+        float u = h < 8 ? x : y;
+        float v = h < 4 ? y : h == 12 || h == 14 ? x
+                                                 : 0.0f;
+        return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+    }
+
+    inline float Noise2D(const int *p, float x, float y)
+    {
+        float xFloor = std::floor(x);
+        float yFloor = std::floor(y);
+        int X = (int)xFloor & 255;
+        int Y = (int)yFloor & 255;
+
+        x -= xFloor;
+        y -= yFloor;
+
+        float u = Fade(x);
+        float v = Fade(y);
+
+        int A = p[X] + Y, AA = p[A], AB = p[A + 1];
+        int B = p[X + 1] + Y, BA = p[B], BB = p[B + 1];
+
+        return Lerp(v, Lerp(u, Grad2(p[AA], x, y), Grad2(p[BA], x - 1.0f, y)),
+                    Lerp(u, Grad2(p[AB], x, y - 1.0f), Grad2(p[BB], x - 1.0f, y - 1.0f)));
+    }
+
+    inline float OctaveMaxValue(int octaves, float persistence)
+    {
+        float maxValue = 0.0f;
+        float amplitude = 1.0f;
+        for (int i = 0; i < octaves; i++)
+        {
+            maxValue += amplitude;
+            amplitude *= persistence;
+        }
+        return maxValue;
+    }
+
+    void OctaveSpanScalar(const int *p, float *out, int begin, int count, float x0, float dx, float y, int octaves, float persistence)
+    {
+        const float maxValue = OctaveMaxValue(octaves, persistence);
+
+        for (int i = begin; i < count; i++)
+        {
+            float x = x0 + (float)i * dx;
+            float total = 0.0f;
+            float frequency = 1.0f;
+            float amplitude = 1.0f;
+
+            for (int o = 0; o < octaves; o++)
+            {
+                total += Noise2D(p, x * frequency, y * frequency) * amplitude;
+                amplitude *= persistence;
+                frequency *= 2.0f;
+            }
+
+            out[i] = total / maxValue;
+        }
+    }
+
+#ifdef PERLIN_X86
+
+    // ---------- SSE4.1: 4 samples per iteration, gathers done lane by lane ----------
+
+    PERLIN_TARGET("sse4.1")
+    inline __m128i Gather4(const int *p, __m128i index)
+    {
+        return _mm_setr_epi32(p[_mm_extract_epi32(index, 0)], p[_mm_extract_epi32(index, 1)],
+                              p[_mm_extract_epi32(index, 2)], p[_mm_extract_epi32(index, 3)]);
+    }
+
+    PERLIN_TARGET("sse4.1")
+    inline __m128 Fade4(__m128 t)
+    {
+        __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+        return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+    }
+
+    PERLIN_TARGET("sse4.1")
+    inline __m128 Lerp4(__m128 t, __m128 a, __m128 b)
+    {
+        return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+    }
+
+    PERLIN_TARGET("sse4.1")
+    inline __m128 Grad2x4(__m128i hash, __m128 x, __m128 y)
+    {
+        __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+
+        __m128 below8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+        __m128 below4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+        __m128 is12or14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+
+        __m128 u = _mm_blendv_ps(y, x, below8);
+        __m128 v = _mm_blendv_ps(_mm_and_ps(is12or14, x), y, below4);
+
+        // Bit 0 negates u, bit 1 negates v
+        __m128 signU = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+        __m128 signV = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+
+        return _mm_add_ps(_mm_xor_ps(u, signU), _mm_xor_ps(v, signV));
+    }
+
+    PERLIN_TARGET("sse4.1")
+    inline __m128 Noise2Dx4(const int *p, __m128 x, __m128 y)
+    {
+        __m128 xFloor = _mm_floor_ps(x);
+        __m128 yFloor = _mm_floor_ps(y);
+        __m128i X = _mm_and_si128(_mm_cvttps_epi32(xFloor), _mm_set1_epi32(255));
+        __m128i Y = _mm_and_si128(_mm_cvttps_epi32(yFloor), _mm_set1_epi32(255));
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128 oneF = _mm_set1_ps(1.0f);
+
+        x = _mm_sub_ps(x, xFloor);
+        y = _mm_sub_ps(y, yFloor);
+
+        __m128 u = Fade4(x);
+        __m128 v = Fade4(y);
+
+        __m128i A = _mm_add_epi32(Gather4(p, X), Y);
+        __m128i B = _mm_add_epi32(Gather4(p, _mm_add_epi32(X, one)), Y);
+        __m128i AA = Gather4(p, A), AB = Gather4(p, _mm_add_epi32(A, one));
+        __m128i BA = Gather4(p, B), BB = Gather4(p, _mm_add_epi32(B, one));
+
+        __m128 x1 = _mm_sub_ps(x, oneF);
+        __m128 y1 = _mm_sub_ps(y, oneF);
+
+        return Lerp4(v, Lerp4(u, Grad2x4(Gather4(p, AA), x, y), Grad2x4(Gather4(p, BA), x1, y)),
+                     Lerp4(u, Grad2x4(Gather4(p, AB), x, y1), Grad2x4(Gather4(p, BB), x1, y1)));
+    }
+
+    PERLIN_TARGET("sse4.1")
+    void OctaveSpanSSE41(const int *p, float *out, int count, float x0, float dx, float y, int octaves, float persistence)
+    {
+        const float maxValue = OctaveMaxValue(octaves, persistence);
+        const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 x = _mm_add_ps(_mm_set1_ps(x0), _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), lane), _mm_set1_ps(dx)));
+            __m128 total = _mm_setzero_ps();
+            float frequency = 1.0f;
+            float amplitude = 1.0f;
+
+            for (int o = 0; o < octaves; o++)
+            {
+                __m128 n = Noise2Dx4(p, _mm_mul_ps(x, _mm_set1_ps(frequency)), _mm_set1_ps(y * frequency));
+                total = _mm_add_ps(total, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+                amplitude *= persistence;
+                frequency *= 2.0f;
+            }
+
+            _mm_storeu_ps(out + i, _mm_div_ps(total, _mm_set1_ps(maxValue)));
+        }
+
+        OctaveSpanScalar(p, out, i, count, x0, dx, y, octaves, persistence);
+    }
+
+    // ---------- AVX2: 8 samples per iteration with hardware gathers ----------
+
+    PERLIN_TARGET("avx2")
+    inline __m256i Gather8(const int *p, __m256i index)
+    {
+        return _mm256_i32gather_epi32(p, index, 4);
+    }
+
+    PERLIN_TARGET("avx2")
+    inline __m256 Fade8(__m256 t)
+    {
+        __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+        return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+    }
+
+    PERLIN_TARGET("avx2")
+    inline __m256 Lerp8(__m256 t, __m256 a, __m256 b)
+    {
+        return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+    }
+
+    PERLIN_TARGET("avx2")
+    inline __m256 Grad2x8(__m256i hash, __m256 x, __m256 y)
+    {
+        __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+
+        __m256 below8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+        __m256 below4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+        __m256 is12or14 = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+
+        __m256 u = _mm256_blendv_ps(y, x, below8);
+        __m256 v = _mm256_blendv_ps(_mm256_and_ps(is12or14, x), y, below4);
+
+        // Bit 0 negates u, bit 1 negates v
+        __m256 signU = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+        __m256 signV = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+
+        return _mm256_add_ps(_mm256_xor_ps(u, signU), _mm256_xor_ps(v, signV));
+    }
+
+    PERLIN_TARGET("avx2")
+    inline __m256 Noise2Dx8(const int *p, __m256 x, __m256 y)
+    {
+        __m256 xFloor = _mm256_floor_ps(x);
+        __m256 yFloor = _mm256_floor_ps(y);
+        __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(xFloor), _mm256_set1_epi32(255));
+        __m256i Y = _mm256_and_si256(_mm256_cvttps_epi32(yFloor), _mm256_set1_epi32(255));
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256 oneF = _mm256_set1_ps(1.0f);
+
+        x = _mm256_sub_ps(x, xFloor);
+        y = _mm256_sub_ps(y, yFloor);
+
+        __m256 u = Fade8(x);
+        __m256 v = Fade8(y);
+
+        __m256i A = _mm256_add_epi32(Gather8(p, X), Y);
+        __m256i B = _mm256_add_epi32(Gather8(p, _mm256_add_epi32(X, one)), Y);
+        __m256i AA = Gather8(p, A), AB = Gather8(p, _mm256_add_epi32(A, one));
+        __m256i BA = Gather8(p, B), BB = Gather8(p, _mm256_add_epi32(B, one));
+
+        __m256 x1 = _mm256_sub_ps(x, oneF);
+        __m256 y1 = _mm256_sub_ps(y, oneF);
+
+        return Lerp8(v, Lerp8(u, Grad2x8(Gather8(p, AA), x, y), Grad2x8(Gather8(p, BA), x1, y)),
+                     Lerp8(u, Grad2x8(Gather8(p, AB), x, y1), Grad2x8(Gather8(p, BB), x1, y1)));
+    }
+
+    PERLIN_TARGET("avx2")
+    void OctaveSpanAVX2(const int *p, float *out, int count, float x0, float dx, float y, int octaves, float persistence)
+    {
+        const float maxValue = OctaveMaxValue(octaves, persistence);
+        const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 x = _mm256_add_ps(_mm256_set1_ps(x0), _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)i), lane), _mm256_set1_ps(dx)));
+            __m256 total = _mm256_setzero_ps();
+            float frequency = 1.0f;
+            float amplitude = 1.0f;
+
+            for (int o = 0; o < octaves; o++)
+            {
+                __m256 n = Noise2Dx8(p, _mm256_mul_ps(x, _mm256_set1_ps(frequency)), _mm256_set1_ps(y * frequency));
+                total = _mm256_add_ps(total, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+                amplitude *= persistence;
+                frequency *= 2.0f;
+            }
+
+            _mm256_storeu_ps(out + i, _mm256_div_ps(total, _mm256_set1_ps(maxValue)));
+        }
+
+        OctaveSpanScalar(p, out, i, count, x0, dx, y, octaves, persistence);
+    }
+
+    struct CpuFeatures
+    {
+        bool sse41 = false;
+        bool avx2 = false;
+
+        CpuFeatures()
+        {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            sse41 = (info[2] & (1 << 19)) != 0;
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            // AVX registers are only usable if the OS saves them on context switches
+            if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+            {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+#else
+            __builtin_cpu_init();
+            sse41 = __builtin_cpu_supports("sse4.1");
+            avx2 = __builtin_cpu_supports("avx2");
+#endif
+        }
+    };
+
+    const CpuFeatures &GetCpuFeatures()
+    {
+        static const CpuFeatures features;
+        return features;
+    }
+
+#endif // PERLIN_X86
+}
+
+float PerlinNoise::noise2D(float x, float y) const
+{
+    return Noise2D(p.data(), x, y);
+}
+
+void PerlinNoise::octaveNoiseSpan(float *out, int count, float x0, float dx, float y, int octaves, float persistence,
+                                  NoiseKernel kernel) const
+{
+    if (!KernelSupported(kernel))
+        kernel = NoiseKernel::Scalar;
+
+    switch (kernel)
+    {
+#ifdef PERLIN_X86
+    case NoiseKernel::AVX2:
+        OctaveSpanAVX2(p.data(), out, count, x0, dx, y, octaves, persistence);
+        break;
+    case NoiseKernel::SSE41:
+        OctaveSpanSSE41(p.data(), out, count, x0, dx, y, octaves, persistence);
+        break;
+#endif
+    default:
+        OctaveSpanScalar(p.data(), out, 0, count, x0, dx, y, octaves, persistence);
+        break;
+    }
+}
+
+NoiseKernel PerlinNoise::BestKernel()
+{
+    if (KernelSupported(NoiseKernel::AVX2))
+        return NoiseKernel::AVX2;
+    if (KernelSupported(NoiseKernel::SSE41))
+        return NoiseKernel::SSE41;
+    return NoiseKernel::Scalar;
+}
+
+bool PerlinNoise::KernelSupported(NoiseKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef PERLIN_X86
+    case NoiseKernel::AVX2:
+        return GetCpuFeatures().avx2;
+    case NoiseKernel::SSE41:
+        return GetCpuFeatures().sse41;
+#endif
+    case NoiseKernel::Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char *PerlinNoise::KernelName(NoiseKernel kernel)
+{
+    switch (kernel)
+    {
+    case NoiseKernel::AVX2:
+        return "AVX2";
+    case NoiseKernel::SSE41:
+        return "SSE4.1";
+    default:
+        return "Scalar";
+    }
+}
@@ -1,14 +1,25 @@
 #pragma once
+#include <array>
 #include <vector>
 #include <glm/glm.hpp>
 #include <random>
 #include <numeric>   // For std::iota
 #include <algorithm> // For std::shuffle
 
+// Instruction sets the batch noise functions can run on
+enum class NoiseKernel
+{
+    Scalar,
+    SSE41,
+    AVX2
+};
+
 class PerlinNoise
 {
 private:
-    std::vector<int> p;
+    // Permutation table, duplicated so that p[i + 1] never needs wrapping.
+    // Kept as contiguous 32-bit ints so the SIMD kernels can gather from it directly.
+    std::array<int, 512> p;
 
     double fade(double t) const
     {
@@ -30,13 +41,14 @@ private:
     }
 
 public:
+    static constexpr int PERMUTATION_SIZE = 512;
+
     PerlinNoise(unsigned int seed = 0)
     {
-        p.resize(256);
-        std::iota(p.begin(), p.end(), 0);
+        std::iota(p.begin(), p.begin() + 256, 0);
         std::default_random_engine engine(seed);
-        std::shuffle(p.begin(), p.end(), engine);
-        p.insert(p.end(), p.begin(), p.end());
+        std::shuffle(p.begin(), p.begin() + 256, engine);
+        std::copy(p.begin(), p.begin() + 256, p.begin() + 256);
     }
 
     double noise(double x, double y, double z = 0) const
@@ -79,4 +91,25 @@ public:
 
         return total / maxValue;
     }
-};
\ No newline at end of file
+
+    // The duplicated permutation table, e.g. for uploading it to a shader
+    const int *permutation() const
+    {
+        return p.data();
+    }
+
+    // Single precision 2D noise, equal to noise(x, y, 0) without the unused z lanes.
+    // This is the reference the batch kernels reproduce bit for bit.
+    float noise2D(float x, float y) const;
+
+    // Batch version of octaveNoise over a horizontal span:
+    // out[i] = octave noise at (x0 + i * dx, y) for i in [0, count).
+    // Every kernel gives the same result, so the choice only affects speed.
+    void octaveNoiseSpan(float *out, int count, float x0, float dx, float y, int octaves, float persistence = 0.5f,
+                         NoiseKernel kernel = BestKernel()) const;
+
+    // Fastest kernel the running CPU supports
+    static NoiseKernel BestKernel();
+    static bool KernelSupported(NoiseKernel kernel);
+    static const char *KernelName(NoiseKernel kernel);
+};
@@ -0,0 +1,235 @@
+#include "Terrain.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Staging memory per frame, enough for a few hundred building footprints in both maps
+	constexpr std::size_t UPLOAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+}
+
+Terrain::~Terrain()
+{
+	Destroy();
+}
+
+void Terrain::Create(int size)
+{
+	Destroy();
+
+	m_size = size;
+	m_heights.assign(size * size, 0.0f);
+	m_splat.assign(size * size, glm::vec4(0.0f));
+	m_heightDeltas.assign(size * size, glm::vec2(0.0f));
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_heightmapTexture);
+	glTextureStorage2D(m_heightmapTexture, 1, GL_R32F, size, size);
+	glTextureParameteri(m_heightmapTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_heightmapTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_heightmapTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_heightmapTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_splatmapTexture);
+	glTextureStorage2D(m_splatmapTexture, 1, GL_RGBA32F, size, size);
+	glTextureParameteri(m_splatmapTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_splatmapTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_splatmapTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_splatmapTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Half floats keep the small differences of gentle slopes, which 8 bit normals would flatten
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_normalTexture);
+	glTextureStorage2D(m_normalTexture, 1, GL_RG16F, size, size);
+	glTextureParameteri(m_normalTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_normalTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_normalTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_normalTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	m_uploader.Create(UPLOAD_BYTES_PER_FRAME);
+}
+
+void Terrain::Destroy()
+{
+	m_uploader.Destroy();
+
+	glDeleteTextures(1, &m_heightmapTexture);
+	glDeleteTextures(1, &m_splatmapTexture);
+	glDeleteTextures(1, &m_normalTexture);
+	m_heightmapTexture = 0;
+	m_splatmapTexture = 0;
+	m_normalTexture = 0;
+
+	m_size = 0;
+	m_heights.clear();
+	m_splat.clear();
+	m_heightDeltas.clear();
+	m_dirtyHeights.clear();
+	m_dirtySplat.clear();
+}
+
+float Terrain::SampleHeight(const glm::vec2 &uv) const
+{
+	glm::vec2 clampedUV = glm::clamp(uv, 0.0f, 1.0f);
+	int x = static_cast<int>(clampedUV.x * (m_size - 1));
+	int y = static_cast<int>(clampedUV.y * (m_size - 1));
+	return GetHeight(x, y);
+}
+
+TerrainRect Terrain::GetTexelRect(const glm::vec2 &minUV, const glm::vec2 &maxUV) const
+{
+	glm::vec2 clampedMin = glm::clamp(minUV, 0.0f, 1.0f);
+	glm::vec2 clampedMax = glm::clamp(maxUV, 0.0f, 1.0f);
+
+	TerrainRect rect;
+	rect.minX = static_cast<int>(clampedMin.x * (m_size - 1));
+	rect.minY = static_cast<int>(clampedMin.y * (m_size - 1));
+	rect.maxX = static_cast<int>(clampedMax.x * (m_size - 1)) + 1;
+	rect.maxY = static_cast<int>(clampedMax.y * (m_size - 1)) + 1;
+	return rect;
+}
+
+void Terrain::CopyHeights(const TerrainRect &rect, float *heights) const
+{
+	for (int y = rect.minY; y < rect.maxY; ++y)
+		heights = std::copy_n(m_heights.data() + y * m_size + rect.minX, rect.GetWidth(), heights);
+}
+
+void Terrain::WriteHeights(const TerrainRect &rect, const float *heights)
+{
+	for (int y = rect.minY; y < rect.maxY; ++y, heights += rect.GetWidth())
+		std::copy_n(heights, rect.GetWidth(), m_heights.data() + y * m_size + rect.minX);
+	MarkHeightsDirty(rect);
+}
+
+void Terrain::CopySplat(const TerrainRect &rect, glm::vec4 *splat) const
+{
+	for (int y = rect.minY; y < rect.maxY; ++y)
+		splat = std::copy_n(m_splat.data() + y * m_size + rect.minX, rect.GetWidth(), splat);
+}
+
+void Terrain::WriteSplat(const TerrainRect &rect, const glm::vec4 *splat)
+{
+	for (int y = rect.minY; y < rect.maxY; ++y, splat += rect.GetWidth())
+		std::copy_n(splat, rect.GetWidth(), m_splat.data() + y * m_size + rect.minX);
+	MarkSplatDirty(rect);
+}
+
+void Terrain::Load(const float *heights, const glm::vec4 *splat)
+{
+	std::copy_n(heights, m_heights.size(), m_heights.begin());
+	std::copy_n(splat, m_splat.size(), m_splat.begin());
+
+	glTextureSubImage2D(m_heightmapTexture, 0, 0, 0, m_size, m_size, GL_RED, GL_FLOAT, heights);
+	glTextureSubImage2D(m_splatmapTexture, 0, 0, 0, m_size, m_size, GL_RGBA, GL_FLOAT, splat);
+	UpdateNormals();
+
+	m_dirtyHeights.clear();
+	m_dirtySplat.clear();
+}
+
+void Terrain::UpdateNormals()
+{
+	ComputeHeightDeltas({0, 0, m_size, m_size});
+	glTextureSubImage2D(m_normalTexture, 0, 0, 0, m_size, m_size, GL_RG, GL_FLOAT, m_heightDeltas.data());
+}
+
+void Terrain::MarkHeightsDirty(const TerrainRect &rect)
+{
+	if (!rect.IsEmpty())
+		m_dirtyHeights.push_back(rect);
+}
+
+void Terrain::MarkSplatDirty(const TerrainRect &rect)
+{
+	if (!rect.IsEmpty())
+		m_dirtySplat.push_back(rect);
+}
+
+void Terrain::MarkAllDirty()
+{
+	TerrainRect all{0, 0, m_size, m_size};
+	m_dirtyHeights.assign(1, all);
+	m_dirtySplat.assign(1, all);
+}
+
+void Terrain::UploadDirty()
+{
+	MergeRects(m_dirtyHeights);
+	MergeRects(m_dirtySplat);
+
+	// A normal depends on the heights next to it, so the normals change one texel beyond each edit
+	std::vector<TerrainRect> dirtyNormals;
+	dirtyNormals.reserve(m_dirtyHeights.size());
+	for (const TerrainRect &rect : m_dirtyHeights)
+	{
+		dirtyNormals.push_back({std::max(0, rect.minX - 1), std::max(0, rect.minY - 1),
+														std::min(m_size, rect.maxX + 1), std::min(m_size, rect.maxY + 1)});
+	}
+	MergeRects(dirtyNormals);
+
+	for (const TerrainRect &rect : m_dirtyHeights)
+	{
+		m_uploader.Upload(m_heightmapTexture, rect.minX, rect.minY, rect.GetWidth(), rect.GetHeight(),
+											GL_RED, GL_FLOAT, m_heights.data(), m_size, sizeof(float));
+	}
+	for (const TerrainRect &rect : dirtyNormals)
+	{
+		ComputeHeightDeltas(rect);
+		m_uploader.Upload(m_normalTexture, rect.minX, rect.minY, rect.GetWidth(), rect.GetHeight(),
+											GL_RG, GL_FLOAT, m_heightDeltas.data(), m_size, sizeof(glm::vec2));
+	}
+	for (const TerrainRect &rect : m_dirtySplat)
+	{
+		m_uploader.Upload(m_splatmapTexture, rect.minX, rect.minY, rect.GetWidth(), rect.GetHeight(),
+											GL_RGBA, GL_FLOAT, m_splat.data(), m_size, sizeof(glm::vec4));
+	}
+	m_uploader.EndFrame();
+
+	m_dirtyHeights.clear();
+	m_dirtySplat.clear();
+}
+
+void Terrain::ComputeHeightDeltas(const TerrainRect &rect)
+{
+	// Central differences like the shaders used to take with textureOffset, clamped at the border
+	for (int y = rect.minY; y < rect.maxY; ++y)
+	{
+		int down = std::max(0, y - 1);
+		int up = std::min(m_size - 1, y + 1);
+		for (int x = rect.minX; x < rect.maxX; ++x)
+		{
+			int left = std::max(0, x - 1);
+			int right = std::min(m_size - 1, x + 1);
+			m_heightDeltas[y * m_size + x] = glm::vec2(GetHeight(left, y) - GetHeight(right, y),
+																									GetHeight(x, down) - GetHeight(x, up));
+		}
+	}
+}
+
+void Terrain::MergeRects(std::vector<TerrainRect> &rects)
+{
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (std::size_t i = 0; i < rects.size(); ++i)
+		{
+			for (std::size_t j = i + 1; j < rects.size();)
+			{
+				if (rects[i].Touches(rects[j]))
+				{
+					rects[i].minX = std::min(rects[i].minX, rects[j].minX);
+					rects[i].minY = std::min(rects[i].minY, rects[j].minY);
+					rects[i].maxX = std::max(rects[i].maxX, rects[j].maxX);
+					rects[i].maxY = std::max(rects[i].maxY, rects[j].maxY);
+					rects[j] = rects.back();
+					rects.pop_back();
+					merged = true;
+				}
+				else
+				{
+					++j;
+				}
+			}
+		}
+	}
+}
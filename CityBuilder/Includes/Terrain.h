@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "TextureUploader.h"
+
+// Texel rectangle of the terrain maps, min inclusive and max exclusive
+struct TerrainRect
+{
+	int minX = 0;
+	int minY = 0;
+	int maxX = 0;
+	int maxY = 0;
+
+	inline int GetWidth() const noexcept { return maxX - minX; }
+	inline int GetHeight() const noexcept { return maxY - minY; }
+	inline bool IsEmpty() const noexcept { return maxX <= minX || maxY <= minY; }
+
+	// True if the rectangles overlap or share an edge
+	inline bool Touches(const TerrainRect &other) const noexcept
+	{
+		return minX <= other.maxX && other.minX <= maxX && minY <= other.maxY && other.minY <= maxY;
+	}
+};
+
+// Splat weights as RGBA8, for the copies kept of edited areas
+inline uint32_t PackSplat(const glm::vec4 &splat) noexcept
+{
+	glm::uvec4 bytes(glm::clamp(splat, 0.0f, 1.0f) * 255.0f + 0.5f);
+	return bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+}
+
+inline glm::vec4 UnpackSplat(uint32_t packed) noexcept
+{
+	return glm::vec4(packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF, packed >> 24) / 255.0f;
+}
+
+// Heightmap and splatmap of the terrain. The CPU copies are the source of truth: every query is
+// answered from them, edits go to them, and the textures only receive the rectangles that changed.
+// A normal map derived from the heights follows them, so shading never needs neighbouring height samples.
+class Terrain
+{
+public:
+	Terrain() = default;
+	~Terrain();
+
+	Terrain(const Terrain &) = delete;
+	Terrain &operator=(const Terrain &) = delete;
+
+	// Allocate size x size maps and their textures
+	void Create(int size);
+	void Destroy();
+
+	inline int GetSize() const noexcept { return m_size; }
+	inline GLuint GetHeightmapTexture() const noexcept { return m_heightmapTexture; }
+	inline GLuint GetSplatmapTexture() const noexcept { return m_splatmapTexture; }
+
+	// RG16F, (left - right, down - up) height differences per texel, the normal is normalize(vec3(r, 2, g))
+	inline GLuint GetNormalTexture() const noexcept { return m_normalTexture; }
+
+	// Row-major map contents. Whoever writes through these marks the touched area dirty
+	inline float *GetHeightData() noexcept { return m_heights.data(); }
+	inline const float *GetHeightData() const noexcept { return m_heights.data(); }
+	inline glm::vec4 *GetSplatData() noexcept { return m_splat.data(); }
+	inline const glm::vec4 *GetSplatData() const noexcept { return m_splat.data(); }
+
+	inline float GetHeight(int x, int y) const { return m_heights[y * m_size + x]; }
+	inline glm::vec4 &GetSplat(int x, int y) { return m_splat[y * m_size + x]; }
+
+	// Normalized height at uv, clamped to the map, from the texel containing it
+	float SampleHeight(const glm::vec2 &uv) const;
+
+	// Texel rectangle covering [minUV, maxUV], clamped to the map
+	TerrainRect GetTexelRect(const glm::vec2 &minUV, const glm::vec2 &maxUV) const;
+
+	// Copy a rectangle of a map out, row by row, or write one back and mark it dirty
+	void CopyHeights(const TerrainRect &rect, float *heights) const;
+	void WriteHeights(const TerrainRect &rect, const float *heights);
+	void CopySplat(const TerrainRect &rect, glm::vec4 *splat) const;
+	void WriteSplat(const TerrainRect &rect, const glm::vec4 *splat);
+
+	// Replace both maps, uploading them straight from the given memory
+	void Load(const float *heights, const glm::vec4 *splat);
+
+	// Rebuild the whole normal map, for heights written without marking them dirty
+	void UpdateNormals();
+
+	void MarkHeightsDirty(const TerrainRect &rect);
+	void MarkSplatDirty(const TerrainRect &rect);
+	void MarkAllDirty();
+
+	// Height edits queued since the last UploadDirty, for anything derived from the heights
+	inline const std::vector<TerrainRect> &GetDirtyHeightRects() const noexcept { return m_dirtyHeights; }
+
+	// Merge the edits queued since the last call and send them to the textures, once per frame
+	void UploadDirty();
+
+	// Statistics of the last UploadDirty
+	inline int GetUploadCount() const noexcept { return m_uploader.GetUploadCount(); }
+	inline std::size_t GetUploadedBytes() const noexcept { return m_uploader.GetUploadedBytes(); }
+
+private:
+	// Replace rectangles that touch by their bounding box until no two touch
+	static void MergeRects(std::vector<TerrainRect> &rects);
+
+	void ComputeHeightDeltas(const TerrainRect &rect);
+
+	int m_size = 0;
+	std::vector<float> m_heights;
+	std::vector<glm::vec4> m_splat;
+
+	GLuint m_heightmapTexture = 0;
+	GLuint m_splatmapTexture = 0;
+
+	std::vector<glm::vec2> m_heightDeltas;
+	GLuint m_normalTexture = 0;
+
+	std::vector<TerrainRect> m_dirtyHeights;
+	std::vector<TerrainRect> m_dirtySplat;
+	TextureUploader m_uploader;
+};
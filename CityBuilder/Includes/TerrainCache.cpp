@@ -0,0 +1,181 @@
+#include "TerrainCache.h"
+
+#include <SDL2/SDL.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	const char CACHE_DIRECTORY[] = "Cache";
+	const char MAGIC[4] = {'C', 'B', 'T', 'C'};
+
+	struct TerrainCacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t seed;
+		int32_t mapSize;
+		uint32_t generator;
+		uint32_t noiseHash;
+		uint64_t heightmapOffset;
+		uint64_t splatmapOffset;
+	};
+
+	constexpr uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint64_t HeightmapBytes(const TerrainGenParams &params)
+	{
+		return static_cast<uint64_t>(params.mapSize) * params.mapSize * sizeof(float);
+	}
+
+	uint64_t SplatmapBytes(const TerrainGenParams &params)
+	{
+		return static_cast<uint64_t>(params.mapSize) * params.mapSize * sizeof(glm::vec4);
+	}
+
+	void HashBytes(uint32_t &hash, const void *data, std::size_t size)
+	{
+		const unsigned char *bytes = static_cast<const unsigned char *>(data);
+		for (std::size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 16777619u;
+	}
+}
+
+std::string TerrainCache::GetPath(const TerrainGenParams &params)
+{
+	char noiseHash[9];
+	std::snprintf(noiseHash, sizeof(noiseHash), "%08x", HashNoise(params.noise));
+	return std::string(CACHE_DIRECTORY) + "/terrain_" + std::to_string(params.seed) + "_" + std::to_string(params.mapSize) +
+				 (params.generator == TerrainGenerator::GPU ? "_gpu_" : "_cpu_") + noiseHash + ".bin";
+}
+
+uint32_t TerrainCache::HashNoise(const TerrainNoiseParams &noise)
+{
+	// Field by field, so padding never reaches the hash
+	uint32_t hash = 2166136261u;
+	HashBytes(hash, &noise.heightFrequency, sizeof(noise.heightFrequency));
+	HashBytes(hash, &noise.heightOctaves, sizeof(noise.heightOctaves));
+	HashBytes(hash, &noise.islandInnerRadius, sizeof(noise.islandInnerRadius));
+	HashBytes(hash, &noise.islandOuterRadius, sizeof(noise.islandOuterRadius));
+	HashBytes(hash, &noise.coastRadius, sizeof(noise.coastRadius));
+	HashBytes(hash, &noise.coastFrequency, sizeof(noise.coastFrequency));
+	HashBytes(hash, &noise.coastOctaves, sizeof(noise.coastOctaves));
+	HashBytes(hash, &noise.coastAmplitude, sizeof(noise.coastAmplitude));
+	HashBytes(hash, &noise.splatFrequencies[0], sizeof(float) * 3);
+	HashBytes(hash, &noise.splatOctaves[0], sizeof(int) * 3);
+	HashBytes(hash, &noise.persistence, sizeof(noise.persistence));
+	return hash;
+}
+
+bool TerrainCache::Open(const TerrainGenParams &params)
+{
+	Close();
+
+	if (!m_file.Open(GetPath(params)))
+		return false;
+
+	TerrainCacheHeader header;
+	if (m_file.GetSize() < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	std::memcpy(&header, m_file.GetData(), sizeof(header));
+
+	bool matches = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+								 header.version == FORMAT_VERSION &&
+								 header.seed == params.seed &&
+								 header.mapSize == params.mapSize &&
+								 header.generator == static_cast<uint32_t>(params.generator) &&
+								 header.noiseHash == HashNoise(params.noise) &&
+								 header.heightmapOffset % alignof(glm::vec4) == 0 &&
+								 header.splatmapOffset % alignof(glm::vec4) == 0 &&
+								 header.heightmapOffset + HeightmapBytes(params) <= m_file.GetSize() &&
+								 header.splatmapOffset + SplatmapBytes(params) <= m_file.GetSize();
+	if (!matches)
+	{
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Ignoring stale terrain cache %s", GetPath(params).c_str());
+		Close();
+		return false;
+	}
+
+	m_heightmapOffset = header.heightmapOffset;
+	m_splatmapOffset = header.splatmapOffset;
+	return true;
+}
+
+void TerrainCache::Close()
+{
+	m_file.Close();
+	m_heightmapOffset = 0;
+	m_splatmapOffset = 0;
+}
+
+const float *TerrainCache::GetHeightmap() const
+{
+	return reinterpret_cast<const float *>(m_file.GetData() + m_heightmapOffset);
+}
+
+const glm::vec4 *TerrainCache::GetSplatmap() const
+{
+	return reinterpret_cast<const glm::vec4 *>(m_file.GetData() + m_splatmapOffset);
+}
+
+bool TerrainCache::Write(const TerrainGenParams &params, const float *heightmap, const glm::vec4 *splatmap)
+{
+	std::error_code error;
+	std::filesystem::create_directories(CACHE_DIRECTORY, error);
+
+	TerrainCacheHeader header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = FORMAT_VERSION;
+	header.seed = params.seed;
+	header.mapSize = params.mapSize;
+	header.generator = static_cast<uint32_t>(params.generator);
+	header.noiseHash = HashNoise(params.noise);
+	header.heightmapOffset = AlignUp(sizeof(header), alignof(glm::vec4));
+	header.splatmapOffset = AlignUp(header.heightmapOffset + HeightmapBytes(params), alignof(glm::vec4));
+
+	// Write next to the target and rename, so an interrupted write never leaves a truncated cache behind
+	std::string path = GetPath(params);
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot write terrain cache %s", tempPath.c_str());
+			return false;
+		}
+
+		const char padding[16] = {};
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(padding, static_cast<std::streamsize>(header.heightmapOffset - sizeof(header)));
+		out.write(reinterpret_cast<const char *>(heightmap), static_cast<std::streamsize>(HeightmapBytes(params)));
+		out.write(padding, static_cast<std::streamsize>(header.splatmapOffset - header.heightmapOffset - HeightmapBytes(params)));
+		out.write(reinterpret_cast<const char *>(splatmap), static_cast<std::streamsize>(SplatmapBytes(params)));
+
+		if (!out)
+		{
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot write terrain cache %s", tempPath.c_str());
+			out.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot replace terrain cache %s: %s", path.c_str(), error.message().c_str());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "MappedFile.h"
+
+// Shape of the noise both generators evaluate, coordinates in map sizes
+struct TerrainNoiseParams
+{
+	float heightFrequency = 5.0f;
+	int32_t heightOctaves = 6;
+	float islandInnerRadius = 0.6f; // The island mask fades from 1 to 0 between these distances from the center,
+	float islandOuterRadius = 1.0f; // in half map sizes
+	float coastRadius = 0.7f;				// Coast noise is added beyond this distance
+	float coastFrequency = 10.0f;
+	int32_t coastOctaves = 2;
+	float coastAmplitude = 0.2f;
+	glm::vec3 splatFrequencies = glm::vec3(5.0f, 10.0f, 20.0f); // Weights of the first three ground textures
+	glm::ivec3 splatOctaves = glm::ivec3(3, 4, 2);
+	float persistence = 0.5f; // Amplitude of an octave relative to the one before
+};
+
+// CPU threads and Comp_TerrainGen.comp round differently, so their maps are cached apart
+enum class TerrainGenerator : uint32_t
+{
+	CPU,
+	GPU
+};
+
+// Inputs that fully determine the generated heightmap and splatmap
+struct TerrainGenParams
+{
+	uint32_t seed = 0;
+	int32_t mapSize = 0;
+	TerrainGenerator generator = TerrainGenerator::CPU;
+	TerrainNoiseParams noise;
+};
+
+// On-disk copy of a generated world, so a repeat launch with the same parameters skips generation.
+// File layout: a TerrainCacheHeader, then the heightmap (mapSize^2 floats), then the splatmap (mapSize^2 vec4s),
+// each starting at a 16 byte aligned offset.
+class TerrainCache
+{
+public:
+	// Bump whenever the generators change, so that old files are regenerated instead of reused
+	static constexpr uint32_t FORMAT_VERSION = 2;
+
+	static std::string GetPath(const TerrainGenParams &params);
+	// FNV-1a over the fields, stored in the file instead of the parameters themselves
+	static uint32_t HashNoise(const TerrainNoiseParams &noise);
+
+	// Map the cache file for params. Returns false if there is none or it does not match params
+	bool Open(const TerrainGenParams &params);
+	void Close();
+
+	// Point into the mapping, valid until Close
+	const float *GetHeightmap() const;
+	const glm::vec4 *GetSplatmap() const;
+
+	// Store freshly generated maps for params, replacing an older file
+	static bool Write(const TerrainGenParams &params, const float *heightmap, const glm::vec4 *splatmap);
+
+private:
+	MappedFile m_file;
+	uint64_t m_heightmapOffset = 0;
+	uint64_t m_splatmapOffset = 0;
+};
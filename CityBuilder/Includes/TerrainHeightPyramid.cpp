@@ -0,0 +1,217 @@
+#include "TerrainHeightPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TerrainHeightPyramid::Build(const Terrain &terrain)
+{
+	m_levels.clear();
+	const int cellCount = terrain.GetSize() - 1;
+	if (cellCount < 1)
+		return;
+
+	int width = cellCount;
+	int height = cellCount;
+	while (true)
+	{
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.ranges.resize(width * height);
+		m_levels.push_back(std::move(level));
+		if (width == 1 && height == 1)
+			break;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+
+	Update(terrain, TerrainRect{0, 0, terrain.GetSize(), terrain.GetSize()});
+}
+
+void TerrainHeightPyramid::Update(const Terrain &terrain, const TerrainRect &rect)
+{
+	if (m_levels.empty() || rect.IsEmpty())
+		return;
+
+	// A texel is a corner of the cells left of and above it too
+	int minX = std::max(rect.minX - 1, 0);
+	int minY = std::max(rect.minY - 1, 0);
+	int maxX = std::min(rect.maxX, m_levels[0].width);
+	int maxY = std::min(rect.maxY, m_levels[0].height);
+
+	const int size = terrain.GetSize();
+	const float *heights = terrain.GetHeightData();
+	Level &base = m_levels[0];
+	for (int y = minY; y < maxY; ++y)
+	{
+		for (int x = minX; x < maxX; ++x)
+		{
+			const float *corner = heights + y * size + x;
+			float h00 = corner[0], h10 = corner[1], h01 = corner[size], h11 = corner[size + 1];
+			base.ranges[y * base.width + x] = glm::vec2(std::min(std::min(h00, h10), std::min(h01, h11)),
+																									std::max(std::max(h00, h10), std::max(h01, h11)));
+		}
+	}
+
+	for (int level = 1; level < GetLevelCount(); ++level)
+	{
+		minX /= 2;
+		minY /= 2;
+		maxX = (maxX + 1) / 2;
+		maxY = (maxY + 1) / 2;
+		for (int y = minY; y < maxY; ++y)
+		{
+			for (int x = minX; x < maxX; ++x)
+				UpdateCell(level, x, y);
+		}
+	}
+}
+
+void TerrainHeightPyramid::UpdateCell(int level, int x, int y)
+{
+	const Level &below = m_levels[level - 1];
+	glm::vec2 range(INFINITY, -INFINITY);
+	for (int childY = 2 * y; childY < std::min(2 * y + 2, below.height); ++childY)
+	{
+		for (int childX = 2 * x; childX < std::min(2 * x + 2, below.width); ++childX)
+		{
+			const glm::vec2 &child = below.ranges[childY * below.width + childX];
+			range = glm::vec2(std::min(range.x, child.x), std::max(range.y, child.y));
+		}
+	}
+	m_levels[level].ranges[y * m_levels[level].width + x] = range;
+}
+
+bool TerrainHeightPyramid::Raycast(const Terrain &terrain, const TerrainQuadtree::WorldMapping &mapping, const glm::vec3 &origin,
+																	 const glm::vec3 &direction, glm::vec3 &hit) const
+{
+	if (m_levels.empty())
+		return false;
+
+	// Into map space, which is affine to world space, so the ray parameter t stays the same
+	const float texelsPerUnit = (terrain.GetSize() - 1) / mapping.worldSize;
+	Ray ray;
+	ray.origin = glm::vec3((origin.x + mapping.worldSize * 0.5f) * texelsPerUnit, (origin.y - mapping.heightOffset) / mapping.heightScale,
+												 (origin.z + mapping.worldSize * 0.5f) * texelsPerUnit);
+	ray.direction = glm::vec3(direction.x * texelsPerUnit, direction.y / mapping.heightScale, direction.z * texelsPerUnit);
+	ray.inverseDirection = 1.0f / ray.direction;
+
+	float t = INFINITY;
+	if (!IntersectCell(terrain, ray, GetLevelCount() - 1, 0, 0, t))
+		return false;
+
+	hit = origin + t * direction;
+	return true;
+}
+
+bool TerrainHeightPyramid::IntersectBox(const Ray &ray, const glm::vec3 &min, const glm::vec3 &max, float tMax, float &tEnter, float &tExit)
+{
+	tEnter = 0.0f;
+	tExit = tMax;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		// A ray parallel to the slab is inside it everywhere or nowhere
+		if (ray.direction[axis] == 0.0f)
+		{
+			if (ray.origin[axis] < min[axis] || ray.origin[axis] > max[axis])
+				return false;
+			continue;
+		}
+
+		float t0 = (min[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+		float t1 = (max[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+		tEnter = std::max(tEnter, std::min(t0, t1));
+		tExit = std::min(tExit, std::max(t0, t1));
+	}
+	return tEnter <= tExit && tEnter < tMax;
+}
+
+bool TerrainHeightPyramid::IntersectCell(const Terrain &terrain, const Ray &ray, int level, int x, int y, float &t) const
+{
+	const Level &cells = m_levels[level];
+	const glm::vec2 &range = cells.ranges[y * cells.width + x];
+	const int cellSize = 1 << level;
+	const int baseWidth = m_levels[0].width;
+	const int baseHeight = m_levels[0].height;
+
+	glm::vec3 boxMin(static_cast<float>(x * cellSize), range.x, static_cast<float>(y * cellSize));
+	glm::vec3 boxMax(static_cast<float>(std::min((x + 1) * cellSize, baseWidth)), range.y, static_cast<float>(std::min((y + 1) * cellSize, baseHeight)));
+	float tEnter, tExit;
+	if (!IntersectBox(ray, boxMin, boxMax, t, tEnter, tExit))
+		return false;
+
+	if (level > 0)
+	{
+		// Children nearest to the ray's origin first, a hit in them lowers t and so skips the ones behind it
+		bool found = false;
+		const Level &below = m_levels[level - 1];
+		const int flipX = ray.direction.x < 0.0f ? 1 : 0;
+		const int flipY = ray.direction.z < 0.0f ? 1 : 0;
+		for (int child = 0; child < 4; ++child)
+		{
+			int childX = 2 * x + ((child & 1) ^ flipX);
+			int childY = 2 * y + ((child >> 1) ^ flipY);
+			if (childX < below.width && childY < below.height)
+				found |= IntersectCell(terrain, ray, level - 1, childX, childY, t);
+		}
+		return found;
+	}
+
+	// From where the ray enters the cell the bilinear surface is a quadratic in s = t - tEnter:
+	// h(s) = h0 + h1 s + h2 s^2. Starting inside the cell keeps the terms small, far from it they cancel out
+	const int size = terrain.GetSize();
+	const float *corner = terrain.GetHeightData() + y * size + x;
+	float h00 = corner[0], h10 = corner[1], h01 = corner[size], h11 = corner[size + 1];
+	float a = h10 - h00;
+	float b = h01 - h00;
+	float c = h00 - h10 - h01 + h11;
+
+	glm::vec3 entry = ray.origin + tEnter * ray.direction;
+	float u0 = entry.x - x;
+	float v0 = entry.z - y;
+	float du = ray.direction.x;
+	float dv = ray.direction.z;
+	float h0 = h00 + a * u0 + b * v0 + c * u0 * v0;
+	float h1 = a * du + b * dv + c * (u0 * dv + v0 * du);
+	float h2 = c * du * dv;
+
+	// Roots of (entry.y + s direction.y) - h(s), the smaller one inside the cell wins
+	float qa = -h2;
+	float qb = ray.direction.y - h1;
+	float qc = entry.y - h0;
+	float roots[2];
+	int rootCount = 0;
+	if (std::abs(qa) < 1e-12f)
+	{
+		if (qb != 0.0f)
+			roots[rootCount++] = -qc / qb;
+	}
+	else
+	{
+		float discriminant = qb * qb - 4.0f * qa * qc;
+		if (discriminant < 0.0f)
+			return false;
+		float root = std::sqrt(discriminant);
+		// The numerically stable pair of roots
+		float q = -0.5f * (qb + std::copysign(root, qb));
+		roots[rootCount++] = q / qa;
+		if (q != 0.0f)
+			roots[rootCount++] = qc / q;
+	}
+
+	// Only where the ray goes down through the surface, a ray entering the map below it sees its underside first.
+	// A little slack keeps the roots on the border between two cells, which rounding may push out of both
+	const float length = tExit - tEnter;
+	const float slack = 1e-3f * length;
+	bool found = false;
+	for (int i = 0; i < rootCount; ++i)
+	{
+		float hit = tEnter + std::max(std::min(roots[i], length), 0.0f);
+		if (roots[i] >= -slack && roots[i] <= length + slack && hit < t && 2.0f * qa * roots[i] + qb <= 0.0f)
+		{
+			t = hit;
+			found = true;
+		}
+	}
+	return found;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Terrain.h"
+#include "TerrainQuadtree.h"
+
+// Min/max pyramid of the CPU heightmap for ray casts. Level 0 holds the height range of every cell between four
+// texels, each further level the range of 2x2 cells of the level below. A ray descends only into the cells whose
+// box it crosses before the nearest hit so far, and meets the surface in a cell of level 0, where the height is
+// bilinear between the four corners as the GPU samples it.
+class TerrainHeightPyramid
+{
+public:
+	void Build(const Terrain &terrain);
+
+	// Refresh the cells over a changed rectangle of the heightmap
+	void Update(const Terrain &terrain, const TerrainRect &rect);
+
+	// Nearest hit of a world space ray with the terrain, false if it misses. direction need not be normalized
+	bool Raycast(const Terrain &terrain, const TerrainQuadtree::WorldMapping &mapping, const glm::vec3 &origin, const glm::vec3 &direction, glm::vec3 &hit) const;
+
+	inline int GetLevelCount() const noexcept { return static_cast<int>(m_levels.size()); }
+
+private:
+	struct Level
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<glm::vec2> ranges; // Min and max height of every cell
+	};
+
+	struct Ray
+	{
+		glm::vec3 origin; // In map space: x and z in texels, y in normalized height
+		glm::vec3 direction;
+		glm::vec3 inverseDirection;
+	};
+
+	// Range of cell (x, y) of level from the four cells below it
+	void UpdateCell(int level, int x, int y);
+
+	// Entry and exit of the ray through the box, false if it misses it or only enters at or after tMax
+	static bool IntersectBox(const Ray &ray, const glm::vec3 &min, const glm::vec3 &max, float tMax, float &tEnter, float &tExit);
+
+	// Lowers t to the ray's hit in cell (x, y) of level, returns true if it found one
+	bool IntersectCell(const Terrain &terrain, const Ray &ray, int level, int x, int y, float &t) const;
+
+	std::vector<Level> m_levels;
+};
@@ -0,0 +1,313 @@
+#include "TerrainJournal.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t RUN_BIT = 0x80000000u;
+
+	// Runs shorter than this are cheaper as part of a literal
+	constexpr std::size_t MIN_RUN_LENGTH = 3;
+}
+
+void TerrainJournal::SetLimits(std::size_t maxEdits, std::size_t maxBytes)
+{
+	m_maxEdits = std::max<std::size_t>(1, maxEdits);
+	m_maxBytes = maxBytes;
+	EnforceLimits();
+}
+
+void TerrainJournal::Clear()
+{
+	m_edits.clear();
+	m_nextEdit = 0;
+	m_bytes = 0;
+	m_pending = Edit();
+	m_recording = false;
+}
+
+void TerrainJournal::BeginEdit()
+{
+	m_pending = Edit();
+	m_recording = true;
+}
+
+void TerrainJournal::AddHeights(const Terrain &terrain, const TerrainRect &rect, const float *before)
+{
+	if (!m_recording || rect.IsEmpty())
+		return;
+
+	static_assert(sizeof(float) == sizeof(uint32_t), "Heights are stored as their bits");
+	m_scratch.resize(rect.GetWidth() * rect.GetHeight());
+	std::memcpy(m_scratch.data(), before, m_scratch.size() * sizeof(float));
+	AddBlock(terrain, rect, false, m_scratch.data());
+}
+
+void TerrainJournal::AddSplat(const Terrain &terrain, const TerrainRect &rect, const glm::vec4 *before)
+{
+	if (!m_recording || rect.IsEmpty())
+		return;
+
+	m_scratch.resize(rect.GetWidth() * rect.GetHeight());
+	std::transform(before, before + m_scratch.size(), m_scratch.begin(), PackSplat);
+	AddBlock(terrain, rect, true, m_scratch.data());
+}
+
+void TerrainJournal::AddHeights(const Terrain &terrain, const TerrainRect &rect, const float *before, ThreadPool &threadPool)
+{
+	if (m_recording && !rect.IsEmpty())
+		AddTiles(terrain, rect, false, before, threadPool);
+}
+
+void TerrainJournal::AddSplat(const Terrain &terrain, const TerrainRect &rect, const glm::vec4 *before, ThreadPool &threadPool)
+{
+	if (m_recording && !rect.IsEmpty())
+		AddTiles(terrain, rect, true, before, threadPool);
+}
+
+void TerrainJournal::AddBuildingChange(const BuildingChange &change)
+{
+	if (m_recording)
+		m_pending.buildings.push_back(change);
+}
+
+void TerrainJournal::CommitEdit()
+{
+	if (!m_recording)
+		return;
+	m_recording = false;
+
+	if (m_pending.blocks.empty() && m_pending.buildings.empty())
+		return;
+
+	// A new edit makes the undone ones unreachable
+	while (m_edits.size() > m_nextEdit)
+	{
+		m_bytes -= m_edits.back().bytes;
+		m_edits.pop_back();
+	}
+
+	m_pending.bytes = m_pending.buildings.size() * sizeof(BuildingChange);
+	for (const Block &block : m_pending.blocks)
+		m_pending.bytes += sizeof(Block) + (block.before.size() + block.after.size()) * sizeof(uint32_t);
+
+	m_bytes += m_pending.bytes;
+	m_edits.push_back(std::move(m_pending));
+	m_nextEdit = m_edits.size();
+	m_pending = Edit();
+
+	EnforceLimits();
+}
+
+std::vector<BuildingChange> *TerrainJournal::PeekUndo()
+{
+	return m_nextEdit > 0 ? &m_edits[m_nextEdit - 1].buildings : nullptr;
+}
+
+std::vector<BuildingChange> *TerrainJournal::PeekRedo()
+{
+	return m_nextEdit < m_edits.size() ? &m_edits[m_nextEdit].buildings : nullptr;
+}
+
+bool TerrainJournal::Undo(Terrain &terrain)
+{
+	if (m_nextEdit == 0)
+		return false;
+
+	--m_nextEdit;
+	Apply(terrain, m_edits[m_nextEdit], false);
+	return true;
+}
+
+bool TerrainJournal::Redo(Terrain &terrain)
+{
+	if (m_nextEdit == m_edits.size())
+		return false;
+
+	Apply(terrain, m_edits[m_nextEdit], true);
+	++m_nextEdit;
+	return true;
+}
+
+void TerrainJournal::Encode(const uint32_t *words, std::size_t count, std::vector<uint32_t> &encoded)
+{
+	encoded.clear();
+	std::size_t literalStart = 0;
+
+	auto flushLiteral = [&](std::size_t end)
+	{
+		if (end > literalStart)
+		{
+			encoded.push_back(static_cast<uint32_t>(end - literalStart));
+			encoded.insert(encoded.end(), words + literalStart, words + end);
+		}
+	};
+
+	std::size_t i = 0;
+	while (i < count)
+	{
+		std::size_t runEnd = i + 1;
+		while (runEnd < count && words[runEnd] == words[i])
+			++runEnd;
+
+		if (runEnd - i >= MIN_RUN_LENGTH)
+		{
+			flushLiteral(i);
+			encoded.push_back(RUN_BIT | static_cast<uint32_t>(runEnd - i));
+			encoded.push_back(words[i]);
+			literalStart = runEnd;
+		}
+		i = runEnd;
+	}
+	flushLiteral(count);
+
+	encoded.shrink_to_fit();
+}
+
+void TerrainJournal::Decode(const std::vector<uint32_t> &encoded, uint32_t *words)
+{
+	std::size_t i = 0;
+	while (i < encoded.size())
+	{
+		uint32_t header = encoded[i++];
+		uint32_t count = header & ~RUN_BIT;
+		if (header & RUN_BIT)
+		{
+			words = std::fill_n(words, count, encoded[i++]);
+		}
+		else
+		{
+			words = std::copy_n(encoded.data() + i, count, words);
+			i += count;
+		}
+	}
+}
+
+void TerrainJournal::AddBlock(const Terrain &terrain, const TerrainRect &rect, bool splat, const uint32_t *before)
+{
+	Block block;
+	block.rect = rect;
+	block.splat = splat;
+	Encode(before, rect.GetWidth() * rect.GetHeight(), block.before);
+
+	// The terrain already holds the state after the edit
+	std::vector<uint32_t> after(rect.GetWidth() * rect.GetHeight());
+	if (splat)
+	{
+		m_splatScratch.resize(after.size());
+		terrain.CopySplat(rect, m_splatScratch.data());
+		std::transform(m_splatScratch.begin(), m_splatScratch.end(), after.begin(), PackSplat);
+	}
+	else
+	{
+		m_heightScratch.resize(after.size());
+		terrain.CopyHeights(rect, m_heightScratch.data());
+		std::memcpy(after.data(), m_heightScratch.data(), after.size() * sizeof(float));
+	}
+	Encode(after.data(), after.size(), block.after);
+
+	m_pending.blocks.push_back(std::move(block));
+}
+
+void TerrainJournal::AddTiles(const Terrain &terrain, const TerrainRect &rect, bool splat, const void *before, ThreadPool &threadPool)
+{
+	const int tilesX = (rect.GetWidth() + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY = (rect.GetHeight() + TILE_SIZE - 1) / TILE_SIZE;
+	std::vector<Block> tiles(tilesX * tilesY);
+
+	threadPool.ParallelFor(static_cast<int>(tiles.size()), 4, [&](int begin, int end)
+												 {
+		std::vector<uint32_t> beforeWords;
+		std::vector<uint32_t> afterWords;
+		for (int i = begin; i < end; ++i)
+		{
+			TerrainRect tileRect;
+			tileRect.minX = rect.minX + (i % tilesX) * TILE_SIZE;
+			tileRect.minY = rect.minY + (i / tilesX) * TILE_SIZE;
+			tileRect.maxX = std::min(tileRect.minX + TILE_SIZE, rect.maxX);
+			tileRect.maxY = std::min(tileRect.minY + TILE_SIZE, rect.maxY);
+
+			// Row by row out of the copy of rect and out of the terrain, as the words a Block stores
+			const int width = tileRect.GetWidth();
+			beforeWords.resize(width * tileRect.GetHeight());
+			afterWords.resize(beforeWords.size());
+			for (int y = tileRect.minY; y < tileRect.maxY; ++y)
+			{
+				std::size_t sourceOffset = (y - rect.minY) * rect.GetWidth() + (tileRect.minX - rect.minX);
+				std::size_t mapOffset = y * terrain.GetSize() + tileRect.minX;
+				uint32_t *beforeRow = beforeWords.data() + (y - tileRect.minY) * width;
+				uint32_t *afterRow = afterWords.data() + (y - tileRect.minY) * width;
+				if (splat)
+				{
+					const glm::vec4 *beforeSplat = static_cast<const glm::vec4 *>(before) + sourceOffset;
+					std::transform(beforeSplat, beforeSplat + width, beforeRow, PackSplat);
+					std::transform(terrain.GetSplatData() + mapOffset, terrain.GetSplatData() + mapOffset + width, afterRow, PackSplat);
+				}
+				else
+				{
+					std::memcpy(beforeRow, static_cast<const float *>(before) + sourceOffset, width * sizeof(float));
+					std::memcpy(afterRow, terrain.GetHeightData() + mapOffset, width * sizeof(float));
+				}
+			}
+
+			if (beforeWords == afterWords)
+				continue;
+
+			Block &block = tiles[i];
+			block.rect = tileRect;
+			block.splat = splat;
+			Encode(beforeWords.data(), beforeWords.size(), block.before);
+			Encode(afterWords.data(), afterWords.size(), block.after);
+		} });
+
+	for (Block &block : tiles)
+	{
+		if (!block.rect.IsEmpty())
+			m_pending.blocks.push_back(std::move(block));
+	}
+}
+
+void TerrainJournal::Apply(Terrain &terrain, const Edit &edit, bool after)
+{
+	// Blocks may overlap, so undo walks them backwards
+	for (std::size_t i = 0; i < edit.blocks.size(); ++i)
+	{
+		const Block &block = edit.blocks[after ? i : edit.blocks.size() - 1 - i];
+		m_scratch.resize(block.rect.GetWidth() * block.rect.GetHeight());
+		Decode(after ? block.after : block.before, m_scratch.data());
+
+		if (block.splat)
+		{
+			m_splatScratch.resize(m_scratch.size());
+			std::transform(m_scratch.begin(), m_scratch.end(), m_splatScratch.begin(), UnpackSplat);
+			terrain.WriteSplat(block.rect, m_splatScratch.data());
+		}
+		else
+		{
+			m_heightScratch.resize(m_scratch.size());
+			std::memcpy(m_heightScratch.data(), m_scratch.data(), m_scratch.size() * sizeof(float));
+			terrain.WriteHeights(block.rect, m_heightScratch.data());
+		}
+	}
+}
+
+void TerrainJournal::EnforceLimits()
+{
+	// The oldest done edit goes first, then redo history if nothing else is left
+	while (!m_edits.empty() && (m_edits.size() > m_maxEdits || m_bytes > m_maxBytes))
+	{
+		if (m_nextEdit > 0)
+		{
+			m_bytes -= m_edits.front().bytes;
+			m_edits.pop_front();
+			--m_nextEdit;
+		}
+		else
+		{
+			m_bytes -= m_edits.back().bytes;
+			m_edits.pop_back();
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Buildings.hpp"
+#include "Terrain.h"
+
+class ThreadPool;
+
+// A building an edit created or demolished, for the caller to recreate or remove on undo and redo
+struct BuildingChange
+{
+	enum class Kind
+	{
+		Placed,
+		Demolished
+	};
+
+	Kind kind = Kind::Placed;
+	uint32_t id = 0; // BuildingRegistry ID, updated by the caller when undo or redo recreates the building
+	BuildingType type = 0;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 color = glm::vec3(1.0f);
+	glm::vec2 footprint = glm::vec2(0.0f);
+
+	// Terrain the building flattened and painted, backed up again when it is recreated
+	TerrainRect heightRect;
+	TerrainRect splatRect;
+};
+
+// Undo and redo history of terrain edits. Every edit keeps the before and after state of the
+// rectangles it touched, run-length encoded: flattened ground compresses to a single run, and
+// splat weights are quantized to RGBA8 first. The oldest edits are dropped to stay within the caps.
+class TerrainJournal
+{
+public:
+	void SetLimits(std::size_t maxEdits, std::size_t maxBytes);
+	void Clear();
+
+	// Record an edit: hand over the state of each rectangle from before the change, after changing the terrain
+	void BeginEdit();
+	void AddHeights(const Terrain &terrain, const TerrainRect &rect, const float *before);
+	void AddSplat(const Terrain &terrain, const TerrainRect &rect, const glm::vec4 *before);
+	void AddBuildingChange(const BuildingChange &change);
+
+	// Same for a large rectangle, cut into tiles that are encoded on the pool. Tiles the edit left as they were are not kept
+	void AddHeights(const Terrain &terrain, const TerrainRect &rect, const float *before, ThreadPool &threadPool);
+	void AddSplat(const Terrain &terrain, const TerrainRect &rect, const glm::vec4 *before, ThreadPool &threadPool);
+	void CommitEdit();
+
+	// Buildings of the edit the next Undo or Redo applies, nullptr if there is none
+	std::vector<BuildingChange> *PeekUndo();
+	std::vector<BuildingChange> *PeekRedo();
+
+	// Write the before or after state of the edit back into the terrain
+	bool Undo(Terrain &terrain);
+	bool Redo(Terrain &terrain);
+
+	inline std::size_t GetUndoCount() const noexcept { return m_nextEdit; }
+	inline std::size_t GetRedoCount() const noexcept { return m_edits.size() - m_nextEdit; }
+	inline std::size_t GetMemoryUsage() const noexcept { return m_bytes; }
+
+	// Run-length encoding of 32-bit words: a header with the top bit set is followed by one word
+	// repeated (header & 0x7FFFFFFF) times, otherwise by header literal words
+	static void Encode(const uint32_t *words, std::size_t count, std::vector<uint32_t> &encoded);
+	static void Decode(const std::vector<uint32_t> &encoded, uint32_t *words);
+
+private:
+	struct Block
+	{
+		TerrainRect rect;
+		bool splat = false; // Heights as float bits otherwise, splat as PackSplat values
+		std::vector<uint32_t> before;
+		std::vector<uint32_t> after;
+	};
+
+	struct Edit
+	{
+		std::vector<Block> blocks;
+		std::vector<BuildingChange> buildings;
+		std::size_t bytes = 0;
+	};
+
+	static constexpr int TILE_SIZE = 64;
+
+	void AddBlock(const Terrain &terrain, const TerrainRect &rect, bool splat, const uint32_t *before);
+
+	// before is a float or glm::vec4 copy of rect, depending on splat
+	void AddTiles(const Terrain &terrain, const TerrainRect &rect, bool splat, const void *before, ThreadPool &threadPool);
+	void Apply(Terrain &terrain, const Edit &edit, bool after);
+	void EnforceLimits();
+
+	std::deque<Edit> m_edits;
+	std::size_t m_nextEdit = 0; // Edits before this are done, the rest can be redone
+	std::size_t m_bytes = 0;
+
+	Edit m_pending;
+	bool m_recording = false;
+
+	std::size_t m_maxEdits = 256;
+	std::size_t m_maxBytes = 64 * 1024 * 1024;
+
+	std::vector<uint32_t> m_scratch;
+	std::vector<float> m_heightScratch;
+	std::vector<glm::vec4> m_splatScratch;
+};
@@ -0,0 +1,229 @@
+#include "TerrainQuadtree.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// Fraction of a level's range after which its vertices start morphing into the coarser level
+	constexpr float MORPH_START_RATIO = 0.7f;
+}
+
+void TerrainQuadtree::Build(const Terrain &terrain, int lodCount)
+{
+	Build(lodCount, glm::vec2(0.0f));
+
+	int leavesPerSide = 1 << (lodCount - 1);
+	for (int y = 0; y < leavesPerSide; ++y)
+	{
+		for (int x = 0; x < leavesPerSide; ++x)
+		{
+			ComputeLeafBounds(terrain, x, y);
+		}
+	}
+	PropagateBounds();
+}
+
+void TerrainQuadtree::Build(int lodCount, const glm::vec2 &heightRange)
+{
+	m_lodCount = lodCount;
+	m_bounds.resize(lodCount);
+	for (int depth = 0; depth < lodCount; ++depth)
+	{
+		int nodesPerSide = 1 << depth;
+		m_bounds[depth].assign(nodesPerSide * nodesPerSide, heightRange);
+	}
+}
+
+void TerrainQuadtree::UpdateBounds(const Terrain &terrain, const TerrainRect &rect)
+{
+	if (m_lodCount == 0 || rect.IsEmpty())
+		return;
+
+	// Leaves share their border texels, so widen by one leaf to catch the neighbours too
+	int leavesPerSide = 1 << (m_lodCount - 1);
+	float texelsPerLeaf = (terrain.GetSize() - 1) / static_cast<float>(leavesPerSide);
+	int minX = std::max(0, static_cast<int>(rect.minX / texelsPerLeaf) - 1);
+	int minY = std::max(0, static_cast<int>(rect.minY / texelsPerLeaf) - 1);
+	int maxX = std::min(leavesPerSide - 1, static_cast<int>((rect.maxX - 1) / texelsPerLeaf) + 1);
+	int maxY = std::min(leavesPerSide - 1, static_cast<int>((rect.maxY - 1) / texelsPerLeaf) + 1);
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		for (int x = minX; x <= maxX; ++x)
+		{
+			ComputeLeafBounds(terrain, x, y);
+		}
+	}
+	PropagateBounds();
+}
+
+void TerrainQuadtree::ComputeLeafBounds(const Terrain &terrain, int x, int y)
+{
+	int leavesPerSide = 1 << (m_lodCount - 1);
+	float texelsPerLeaf = (terrain.GetSize() - 1) / static_cast<float>(leavesPerSide);
+
+	// Every texel the bilinear filter may read for this leaf
+	int minX = static_cast<int>(std::floor(x * texelsPerLeaf));
+	int minY = static_cast<int>(std::floor(y * texelsPerLeaf));
+	int maxX = std::min(terrain.GetSize() - 1, static_cast<int>(std::ceil((x + 1) * texelsPerLeaf)));
+	int maxY = std::min(terrain.GetSize() - 1, static_cast<int>(std::ceil((y + 1) * texelsPerLeaf)));
+
+	glm::vec2 bounds(FLT_MAX, -FLT_MAX);
+	for (int ty = minY; ty <= maxY; ++ty)
+	{
+		for (int tx = minX; tx <= maxX; ++tx)
+		{
+			float height = terrain.GetHeight(tx, ty);
+			bounds.x = std::min(bounds.x, height);
+			bounds.y = std::max(bounds.y, height);
+		}
+	}
+
+	m_bounds[m_lodCount - 1][y * leavesPerSide + x] = bounds;
+}
+
+void TerrainQuadtree::PropagateBounds()
+{
+	for (int depth = m_lodCount - 2; depth >= 0; --depth)
+	{
+		int nodesPerSide = 1 << depth;
+		const std::vector<glm::vec2> &children = m_bounds[depth + 1];
+		for (int y = 0; y < nodesPerSide; ++y)
+		{
+			for (int x = 0; x < nodesPerSide; ++x)
+			{
+				glm::vec2 bounds(FLT_MAX, -FLT_MAX);
+				for (int q = 0; q < 4; ++q)
+				{
+					const glm::vec2 &child = children[(2 * y + (q >> 1)) * 2 * nodesPerSide + 2 * x + (q & 1)];
+					bounds.x = std::min(bounds.x, child.x);
+					bounds.y = std::max(bounds.y, child.y);
+				}
+				m_bounds[depth][y * nodesPerSide + x] = bounds;
+			}
+		}
+	}
+}
+
+void TerrainQuadtree::Select(const glm::mat4 &viewProj, const glm::vec3 &eye, const WorldMapping &mapping, std::vector<TerrainPatch> &patches)
+{
+	patches.clear();
+	m_culledCount = 0;
+	if (m_lodCount == 0)
+		return;
+
+	m_eye = eye;
+	m_mapping = mapping;
+
+	// Gribb-Hartmann plane extraction, the planes point into the frustum
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+	m_frustumPlanes[0] = rows[3] + rows[0];
+	m_frustumPlanes[1] = rows[3] - rows[0];
+	m_frustumPlanes[2] = rows[3] + rows[1];
+	m_frustumPlanes[3] = rows[3] - rows[1];
+	m_frustumPlanes[4] = rows[3] + rows[2];
+	m_frustumPlanes[5] = rows[3] - rows[2];
+
+	SelectNode(0, 0, 0, patches);
+}
+
+bool TerrainQuadtree::SelectNode(int depth, int x, int y, std::vector<TerrainPatch> &patches)
+{
+	int lod = m_lodCount - 1 - depth;
+	Box box = GetNodeBox(depth, x, y);
+
+	auto intersectsRange = [&](float range)
+	{
+		glm::vec3 closest = glm::clamp(m_eye, box.min, box.max);
+		glm::vec3 toClosest = closest - m_eye;
+		return glm::dot(toClosest, toClosest) <= range * range;
+	};
+
+	// Too far for this level, the parent covers the area at its own resolution
+	if (!intersectsRange(GetLodRange(lod)))
+		return false;
+
+	if (!IsVisible(box))
+	{
+		++m_culledCount;
+		return true;
+	}
+
+	float size = 1.0f / (1 << depth);
+	glm::vec2 offset = glm::vec2(x, y) * size;
+
+	if (lod == 0 || !intersectsRange(GetLodRange(lod - 1)))
+	{
+		patches.push_back({offset, size, lod, -1});
+		return true;
+	}
+
+	// Children within the finer range draw themselves, the rest of the node stays at this level quadrant by quadrant
+	for (int q = 0; q < 4; ++q)
+	{
+		int childX = 2 * x + (q & 1);
+		int childY = 2 * y + (q >> 1);
+		if (SelectNode(depth + 1, childX, childY, patches))
+			continue;
+
+		if (IsVisible(GetNodeBox(depth + 1, childX, childY)))
+			patches.push_back({offset, size, lod, q});
+		else
+			++m_culledCount;
+	}
+	return true;
+}
+
+TerrainQuadtree::Box TerrainQuadtree::GetNodeBox(int depth, int x, int y) const
+{
+	int nodesPerSide = 1 << depth;
+	float size = 1.0f / nodesPerSide;
+	const glm::vec2 &bounds = m_bounds[depth][y * nodesPerSide + x];
+
+	Box box;
+	box.min = glm::vec3((x * size - 0.5f) * m_mapping.worldSize,
+											bounds.x * m_mapping.heightScale + m_mapping.heightOffset,
+											(y * size - 0.5f) * m_mapping.worldSize);
+	box.max = glm::vec3(((x + 1) * size - 0.5f) * m_mapping.worldSize,
+											bounds.y * m_mapping.heightScale + m_mapping.heightOffset,
+											((y + 1) * size - 0.5f) * m_mapping.worldSize);
+	return box;
+}
+
+bool TerrainQuadtree::IsVisible(const Box &box) const
+{
+	for (const glm::vec4 &plane : m_frustumPlanes)
+	{
+		// The box corner furthest along the plane normal
+		glm::vec3 corner(plane.x > 0.0f ? box.max.x : box.min.x,
+										 plane.y > 0.0f ? box.max.y : box.min.y,
+										 plane.z > 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+float TerrainQuadtree::GetLodRange(int lod) const
+{
+	// The coarsest level covers everything that is left
+	if (lod >= m_lodCount - 1)
+		return FLT_MAX;
+	return m_lodDistance * static_cast<float>(1 << lod);
+}
+
+glm::vec2 TerrainQuadtree::GetMorphRange(int lod) const
+{
+	// Never morphs, but keep end > start so the shader does not divide by zero
+	if (lod >= m_lodCount - 1)
+		return glm::vec2(FLT_MAX * 0.5f, FLT_MAX);
+
+	float end = GetLodRange(lod);
+	float start = lod > 0 ? GetLodRange(lod - 1) : 0.0f;
+	return glm::vec2(start + (end - start) * MORPH_START_RATIO, end);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Terrain.h"
+
+// A patch to draw: the area of a quadtree node, or one quadrant of it, at the node's LOD
+struct TerrainPatch
+{
+	glm::vec2 offset; // Node corner in heightmap UV
+	float size;				// Node edge length in heightmap UV
+	int lod;					// 0 is the finest level
+	int quadrant;			// 0..3 to draw only that quarter, -1 for the whole node
+};
+
+// CDLOD quadtree over the heightmap. Every node is drawn with the same grid patch, scaled to the node,
+// and vertices morph towards the next coarser grid as they approach the end of their LOD range, so
+// neighbouring levels meet without cracks. Node bounds come from the heightmap min/max under them.
+class TerrainQuadtree
+{
+public:
+	// Mapping from heightmap space to world space: x/z = (uv - 0.5) * worldSize, y = height * heightScale + heightOffset
+	struct WorldMapping
+	{
+		float worldSize = 100.0f;
+		float heightScale = 1.0f;
+		float heightOffset = 0.0f;
+	};
+
+	// lodCount levels, the finest nodes cover 1 / 2^(lodCount - 1) of the map
+	void Build(const Terrain &terrain, int lodCount);
+	// Every node spans heightRange, for a heightmap that is not on the CPU yet. Nothing is culled too early
+	void Build(int lodCount, const glm::vec2 &heightRange);
+
+	// Refresh the bounds of the nodes over a changed rectangle of the heightmap
+	void UpdateBounds(const Terrain &terrain, const TerrainRect &rect);
+
+	// Distance up to which the finest level is used, every coarser level doubles it
+	inline void SetLodDistance(float distance) noexcept { m_lodDistance = distance; }
+
+	// Pick the patches to draw for this camera, skipping the ones outside the frustum
+	void Select(const glm::mat4 &viewProj, const glm::vec3 &eye, const WorldMapping &mapping, std::vector<TerrainPatch> &patches);
+
+	// Distance range over which vertices of the given level morph into the next coarser level
+	glm::vec2 GetMorphRange(int lod) const;
+
+	inline int GetLodCount() const noexcept { return m_lodCount; }
+	inline int GetCulledCount() const noexcept { return m_culledCount; }
+
+private:
+	struct Box
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// Select for the node at (x, y) of depth level depth. Returns false if the node is beyond its LOD range
+	bool SelectNode(int depth, int x, int y, std::vector<TerrainPatch> &patches);
+	Box GetNodeBox(int depth, int x, int y) const;
+	bool IsVisible(const Box &box) const;
+	float GetLodRange(int lod) const;
+
+	void ComputeLeafBounds(const Terrain &terrain, int x, int y);
+	void PropagateBounds();
+
+	int m_lodCount = 0;
+	float m_lodDistance = 8.0f;
+
+	// Height min/max of every node, one row-major grid per depth level (0 is the root)
+	std::vector<std::vector<glm::vec2>> m_bounds;
+
+	// Selection state
+	glm::vec4 m_frustumPlanes[6];
+	glm::vec3 m_eye;
+	WorldMapping m_mapping;
+	int m_culledCount = 0;
+};
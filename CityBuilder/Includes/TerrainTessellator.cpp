@@ -0,0 +1,177 @@
+#include "TerrainTessellator.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+TerrainTessellator::~TerrainTessellator()
+{
+	Destroy();
+}
+
+void TerrainTessellator::Create(const Terrain &terrain, int patchesPerSide)
+{
+	Create(patchesPerSide, glm::vec2(0.0f));
+
+	float maxRoughness = 0.0f;
+	for (int y = 0; y < patchesPerSide; ++y)
+	{
+		for (int x = 0; x < patchesPerSide; ++x)
+		{
+			glm::vec4 &info = m_patchInfo[y * patchesPerSide + x];
+			info = ComputePatchInfo(terrain, x, y);
+			maxRoughness = std::max(maxRoughness, info.r);
+		}
+	}
+
+	m_roughnessScale = maxRoughness > 0.0f ? 1.0f / maxRoughness : 1.0f;
+	for (glm::vec4 &info : m_patchInfo)
+		info.r *= m_roughnessScale;
+
+	glTextureSubImage2D(m_patchInfoTexture, 0, 0, 0, patchesPerSide, patchesPerSide, GL_RGBA, GL_FLOAT, m_patchInfo.data());
+}
+
+void TerrainTessellator::Create(int patchesPerSide, const glm::vec2 &heightRange)
+{
+	Destroy();
+	m_patchesPerSide = patchesPerSide;
+
+	// Control points on a (patchesPerSide + 1)^2 grid of heightmap UVs, four per patch
+	const int gridSize = patchesPerSide + 1;
+	std::vector<glm::vec2> vertices;
+	std::vector<GLuint> indices;
+
+	for (int z = 0; z < gridSize; ++z)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			vertices.emplace_back(x / (float)patchesPerSide, z / (float)patchesPerSide);
+		}
+	}
+
+	// Patch i is at (i % patchesPerSide, i / patchesPerSide), the control shader relies on this order
+	for (int z = 0; z < patchesPerSide; ++z)
+	{
+		for (int x = 0; x < patchesPerSide; ++x)
+		{
+			indices.push_back(z * gridSize + x);
+			indices.push_back(z * gridSize + x + 1);
+			indices.push_back((z + 1) * gridSize + x + 1);
+			indices.push_back((z + 1) * gridSize + x);
+		}
+	}
+	m_indexCount = static_cast<GLsizei>(indices.size());
+
+	glCreateVertexArrays(1, &m_vao);
+	glCreateBuffers(1, &m_vbo);
+	glCreateBuffers(1, &m_ibo);
+	glNamedBufferStorage(m_vbo, vertices.size() * sizeof(glm::vec2), vertices.data(), 0);
+	glNamedBufferStorage(m_ibo, indices.size() * sizeof(GLuint), indices.data(), 0);
+
+	glVertexArrayVertexBuffer(m_vao, 0, m_vbo, 0, sizeof(glm::vec2));
+	glVertexArrayElementBuffer(m_vao, m_ibo);
+	glEnableVertexArrayAttrib(m_vao, 0);
+	glVertexArrayAttribFormat(m_vao, 0, 2, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(m_vao, 0, 0);
+
+	// Roughness is sampled halfway between patch centers on shared edges, so both sides see the same value
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_patchInfoTexture);
+	glTextureStorage2D(m_patchInfoTexture, 1, GL_RGBA32F, patchesPerSide, patchesPerSide);
+	glTextureParameteri(m_patchInfoTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_patchInfoTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_patchInfoTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_patchInfoTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	m_roughnessScale = 1.0f;
+	m_patchInfo.assign(patchesPerSide * patchesPerSide, glm::vec4(1.0f, heightRange.x, heightRange.y, 0.0f));
+	glTextureSubImage2D(m_patchInfoTexture, 0, 0, 0, patchesPerSide, patchesPerSide, GL_RGBA, GL_FLOAT, m_patchInfo.data());
+}
+
+void TerrainTessellator::Destroy()
+{
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteBuffers(1, &m_ibo);
+	glDeleteTextures(1, &m_patchInfoTexture);
+
+	m_vao = 0;
+	m_vbo = 0;
+	m_ibo = 0;
+	m_patchInfoTexture = 0;
+	m_indexCount = 0;
+	m_patchesPerSide = 0;
+	m_patchInfo.clear();
+}
+
+void TerrainTessellator::UpdatePatchInfo(const Terrain &terrain, const TerrainRect &rect)
+{
+	if (m_patchesPerSide == 0 || rect.IsEmpty())
+		return;
+
+	// Patches share their border texels, so widen by one patch to catch the neighbours too
+	float texelsPerPatch = (terrain.GetSize() - 1) / static_cast<float>(m_patchesPerSide);
+	int minX = std::max(0, static_cast<int>(rect.minX / texelsPerPatch) - 1);
+	int minY = std::max(0, static_cast<int>(rect.minY / texelsPerPatch) - 1);
+	int maxX = std::min(m_patchesPerSide - 1, static_cast<int>((rect.maxX - 1) / texelsPerPatch) + 1);
+	int maxY = std::min(m_patchesPerSide - 1, static_cast<int>((rect.maxY - 1) / texelsPerPatch) + 1);
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		for (int x = minX; x <= maxX; ++x)
+		{
+			glm::vec4 info = ComputePatchInfo(terrain, x, y);
+			info.r = std::min(1.0f, info.r * m_roughnessScale);
+			m_patchInfo[y * m_patchesPerSide + x] = info;
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, m_patchesPerSide);
+	glTextureSubImage2D(m_patchInfoTexture, 0, minX, minY, maxX - minX + 1, maxY - minY + 1, GL_RGBA, GL_FLOAT,
+											m_patchInfo.data() + minY * m_patchesPerSide + minX);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void TerrainTessellator::Draw() const
+{
+	glPatchParameteri(GL_PATCH_VERTICES, 4);
+	glBindVertexArray(m_vao);
+	glDrawElements(GL_PATCHES, m_indexCount, GL_UNSIGNED_INT, nullptr);
+	glBindVertexArray(0);
+}
+
+glm::vec4 TerrainTessellator::ComputePatchInfo(const Terrain &terrain, int x, int y) const
+{
+	const int size = terrain.GetSize();
+	float texelsPerPatch = (size - 1) / static_cast<float>(m_patchesPerSide);
+
+	int minX = static_cast<int>(std::floor(x * texelsPerPatch));
+	int minY = static_cast<int>(std::floor(y * texelsPerPatch));
+	int maxX = std::min(size - 1, static_cast<int>(std::ceil((x + 1) * texelsPerPatch)));
+	int maxY = std::min(size - 1, static_cast<int>(std::ceil((y + 1) * texelsPerPatch)));
+
+	float minHeight = FLT_MAX;
+	float maxHeight = -FLT_MAX;
+	float curvature = 0.0f;
+	int curvatureSamples = 0;
+
+	for (int ty = minY; ty <= maxY; ++ty)
+	{
+		for (int tx = minX; tx <= maxX; ++tx)
+		{
+			float height = terrain.GetHeight(tx, ty);
+			minHeight = std::min(minHeight, height);
+			maxHeight = std::max(maxHeight, height);
+
+			// A plane needs no extra triangles however steep it is, so measure how much the surface bends
+			if (tx > 0 && ty > 0 && tx < size - 1 && ty < size - 1)
+			{
+				curvature += std::abs(4.0f * height - terrain.GetHeight(tx - 1, ty) - terrain.GetHeight(tx + 1, ty) -
+															terrain.GetHeight(tx, ty - 1) - terrain.GetHeight(tx, ty + 1));
+				++curvatureSamples;
+			}
+		}
+	}
+
+	float roughness = curvatureSamples > 0 ? curvature / curvatureSamples : 0.0f;
+	return glm::vec4(roughness, minHeight, maxHeight, 0.0f);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Terrain.h"
+
+// Coarse patch grid for rendering the terrain with hardware tessellation.
+// Next to the control mesh it keeps a per-patch info texture for the control shader:
+// r = roughness in [0, 1], g/b = min/max height under the patch for frustum culling.
+class TerrainTessellator
+{
+public:
+	TerrainTessellator() = default;
+	~TerrainTessellator();
+
+	TerrainTessellator(const TerrainTessellator &) = delete;
+	TerrainTessellator &operator=(const TerrainTessellator &) = delete;
+
+	void Create(const Terrain &terrain, int patchesPerSide);
+	// For a heightmap that is not on the CPU yet: every patch spans heightRange at the finest tessellation
+	void Create(int patchesPerSide, const glm::vec2 &heightRange);
+	void Destroy();
+
+	// Recompute the info of the patches over a changed rectangle of the heightmap
+	void UpdatePatchInfo(const Terrain &terrain, const TerrainRect &rect);
+
+	inline int GetPatchesPerSide() const noexcept { return m_patchesPerSide; }
+	inline GLuint GetPatchInfoTexture() const noexcept { return m_patchInfoTexture; }
+
+	// Draw the patches with the currently bound tessellation program
+	void Draw() const;
+
+private:
+	glm::vec4 ComputePatchInfo(const Terrain &terrain, int x, int y) const;
+
+	int m_patchesPerSide = 0;
+
+	GLuint m_vao = 0;
+	GLuint m_vbo = 0;
+	GLuint m_ibo = 0;
+	GLsizei m_indexCount = 0;
+
+	std::vector<glm::vec4> m_patchInfo;
+	GLuint m_patchInfoTexture = 0;
+
+	// Roughness is the mean curvature of the heights, divided by the largest patch value at creation
+	float m_roughnessScale = 1.0f;
+};
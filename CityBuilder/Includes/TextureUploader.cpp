@@ -0,0 +1,118 @@
+#include "TextureUploader.h"
+
+#include <cstring>
+
+namespace
+{
+	// Keeps every block aligned for any texel format we upload
+	constexpr std::size_t BLOCK_ALIGNMENT = 16;
+
+	// Waiting longer than this means the GPU is badly behind, give up and overwrite
+	constexpr GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+}
+
+TextureUploader::~TextureUploader()
+{
+	Destroy();
+}
+
+void TextureUploader::Create(std::size_t bytesPerFrame)
+{
+	Destroy();
+
+	m_segmentSize = (bytesPerFrame + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+	const GLsizeiptr totalSize = static_cast<GLsizeiptr>(m_segmentSize * FRAMES_IN_FLIGHT);
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, totalSize, nullptr, flags);
+	m_mapped = static_cast<unsigned char *>(glMapNamedBufferRange(m_buffer, 0, totalSize, flags));
+}
+
+void TextureUploader::Destroy()
+{
+	for (GLsync &fence : m_fences)
+	{
+		if (fence != nullptr)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	if (m_buffer != 0)
+	{
+		glUnmapNamedBuffer(m_buffer);
+		glDeleteBuffers(1, &m_buffer);
+	}
+
+	m_buffer = 0;
+	m_mapped = nullptr;
+	m_segmentSize = 0;
+	m_segment = 0;
+	m_segmentUsed = 0;
+	m_segmentReady = false;
+}
+
+void TextureUploader::Upload(GLuint texture, int x, int y, int width, int height, GLenum format, GLenum type,
+														 const void *source, int rowLength, std::size_t texelSize)
+{
+	const std::size_t rowBytes = width * texelSize;
+	const std::size_t blockBytes = rowBytes * height;
+	const unsigned char *first = static_cast<const unsigned char *>(source) + (static_cast<std::size_t>(y) * rowLength + x) * texelSize;
+
+	++m_uploadCount;
+	m_uploadedBytes += blockBytes;
+
+	if (m_mapped == nullptr || m_segmentUsed + blockBytes > m_segmentSize)
+	{
+		// Too big for the staging buffer (e.g. a whole freshly generated map), upload from client memory
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+		glTextureSubImage2D(texture, 0, x, y, width, height, format, type, first);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		return;
+	}
+
+	if (!m_segmentReady)
+	{
+		WaitForSegment(m_segment);
+		m_segmentReady = true;
+	}
+
+	// Pack the rows tightly into the staging buffer
+	const std::size_t offset = m_segment * m_segmentSize + m_segmentUsed;
+	for (int row = 0; row < height; ++row)
+	{
+		std::memcpy(m_mapped + offset + row * rowBytes, first + static_cast<std::size_t>(row) * rowLength * texelSize, rowBytes);
+	}
+	m_segmentUsed += (blockBytes + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+	glTextureSubImage2D(texture, 0, x, y, width, height, format, type, reinterpret_cast<const void *>(offset));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureUploader::EndFrame()
+{
+	if (m_segmentUsed > 0)
+	{
+		m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_segment = (m_segment + 1) % FRAMES_IN_FLIGHT;
+	}
+	m_segmentUsed = 0;
+	m_segmentReady = false;
+
+	m_lastUploadCount = m_uploadCount;
+	m_lastUploadedBytes = m_uploadedBytes;
+	m_uploadCount = 0;
+	m_uploadedBytes = 0;
+}
+
+void TextureUploader::WaitForSegment(int segment)
+{
+	GLsync &fence = m_fences[segment];
+	if (fence == nullptr)
+		return;
+
+	glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+	glDeleteSync(fence);
+	fence = nullptr;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// Streams texture updates through a persistently mapped pixel unpack buffer.
+// The buffer is split into one segment per frame in flight, each guarded by a fence,
+// so writing the next frame's data never waits on a transfer the GPU is still doing.
+class TextureUploader
+{
+public:
+	TextureUploader() = default;
+	~TextureUploader();
+
+	TextureUploader(const TextureUploader &) = delete;
+	TextureUploader &operator=(const TextureUploader &) = delete;
+
+	void Create(std::size_t bytesPerFrame);
+	void Destroy();
+
+	// Copy a width x height block out of a larger CPU image with rowLength texels per row
+	// into texture at (x, y). Blocks that do not fit in this frame's segment go from client memory.
+	void Upload(GLuint texture, int x, int y, int width, int height, GLenum format, GLenum type,
+							const void *source, int rowLength, std::size_t texelSize);
+
+	// Fence this frame's segment and move on to the next one
+	void EndFrame();
+
+	// Statistics of the last finished frame
+	inline int GetUploadCount() const noexcept { return m_lastUploadCount; }
+	inline std::size_t GetUploadedBytes() const noexcept { return m_lastUploadedBytes; }
+
+private:
+	static constexpr int FRAMES_IN_FLIGHT = 3;
+
+	void WaitForSegment(int segment);
+
+	GLuint m_buffer = 0;
+	unsigned char *m_mapped = nullptr;
+	std::size_t m_segmentSize = 0;
+
+	std::array<GLsync, FRAMES_IN_FLIGHT> m_fences = {};
+	int m_segment = 0;
+	std::size_t m_segmentUsed = 0;
+	bool m_segmentReady = false;
+
+	int m_uploadCount = 0;
+	std::size_t m_uploadedBytes = 0;
+	int m_lastUploadCount = 0;
+	std::size_t m_lastUploadedBytes = 0;
+};
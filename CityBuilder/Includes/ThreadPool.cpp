@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	// The thread calling ParallelFor also works, so one less worker is enough
+	for (unsigned int i = 1; i < threadCount; ++i)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobAvailable.notify_all();
+
+	for (std::thread &worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push(std::move(job));
+	}
+	m_jobAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor(int count, int chunkSize, const std::function<void(int, int)> &job)
+{
+	if (count <= 0)
+		return;
+
+	chunkSize = std::max(1, chunkSize);
+	const int chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	// Nothing to distribute, avoid the queue entirely
+	if (chunkCount == 1 || m_workers.empty())
+	{
+		RunTimed([&]()
+						 { job(0, count); });
+		return;
+	}
+
+	std::atomic<int> remaining(chunkCount);
+	std::mutex doneMutex;
+	std::condition_variable done;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			int begin = chunk * chunkSize;
+			int end = std::min(count, begin + chunkSize);
+			m_jobs.push([&, begin, end]()
+									{
+				job(begin, end);
+				// Decrement under the lock so the waiter cannot return (and destroy these locals) in between
+				std::lock_guard<std::mutex> doneLock(doneMutex);
+				if (remaining.fetch_sub(1) == 1)
+					done.notify_all(); });
+		}
+	}
+	m_jobAvailable.notify_all();
+
+	// Help with the queue instead of idling, then wait for the chunks still running on workers
+	while (remaining.load() > 0 && RunPendingJob())
+	{
+	}
+
+	std::unique_lock<std::mutex> doneLock(doneMutex);
+	done.wait(doneLock, [&]()
+						{ return remaining.load() == 0; });
+}
+
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this]()
+													{ return m_stopping || !m_jobs.empty(); });
+			if (m_stopping && m_jobs.empty())
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop();
+		}
+		RunTimed(job);
+	}
+}
+
+bool ThreadPool::RunPendingJob()
+{
+	std::function<void()> job;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_jobs.empty())
+			return false;
+
+		job = std::move(m_jobs.front());
+		m_jobs.pop();
+	}
+	RunTimed(job);
+	return true;
+}
+
+void ThreadPool::RunTimed(const std::function<void()> &job)
+{
+	auto start = std::chrono::steady_clock::now();
+	job();
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	m_busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads, sized to the machine by default
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	// Number of threads that execute jobs, including the calling thread of ParallelFor
+	inline unsigned int GetThreadCount() const noexcept { return static_cast<unsigned int>(m_workers.size()) + 1; }
+
+	// Queue a job without waiting for it
+	void Submit(std::function<void()> job);
+
+	// Split [0, count) into ranges of at most chunkSize elements and run job(begin, end) on each.
+	// The calling thread takes part in the work and the function returns once every range is done.
+	void ParallelFor(int count, int chunkSize, const std::function<void(int, int)> &job);
+
+	// Summed time the threads spent inside jobs, i.e. what the work would have taken serially
+	inline std::chrono::nanoseconds GetBusyTime() const noexcept { return std::chrono::nanoseconds(m_busyNanoseconds.load()); }
+	inline void ResetBusyTime() noexcept { m_busyNanoseconds = 0; }
+
+private:
+	void WorkerLoop();
+	bool RunPendingJob();
+	void RunTimed(const std::function<void()> &job);
+
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	bool m_stopping = false;
+
+	std::atomic<long long> m_busyNanoseconds{0};
+};
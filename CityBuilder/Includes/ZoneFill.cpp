@@ -0,0 +1,186 @@
+#include "ZoneFill.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	constexpr int TILES_PER_JOB = 8;
+
+	struct ZoneSample
+	{
+		glm::vec2 position;
+		glm::vec2 halfSize;
+		BuildingType type;
+	};
+
+	// The open boxes of BuildingGrid::Overlaps, grown by the padding
+	bool Conflicts(const ZoneSample &a, const glm::vec2 &position, const glm::vec2 &halfSize, float padding)
+	{
+		return std::abs(a.position.x - position.x) < a.halfSize.x + halfSize.x + padding &&
+					 std::abs(a.position.y - position.y) < a.halfSize.y + halfSize.y + padding;
+	}
+}
+
+BuildingZone BuildingZone::FromRectangle(const glm::vec2 &a, const glm::vec2 &b)
+{
+	glm::vec2 min = glm::min(a, b);
+	glm::vec2 max = glm::max(a, b);
+	return {{min, glm::vec2(max.x, min.y), max, glm::vec2(min.x, max.y)}};
+}
+
+bool BuildingZone::Contains(const glm::vec2 &point) const
+{
+	bool inside = false;
+	for (std::size_t i = 0, j = corners.size() - 1; i < corners.size(); j = i++)
+	{
+		const glm::vec2 &a = corners[i];
+		const glm::vec2 &b = corners[j];
+		if ((a.y > point.y) != (b.y > point.y) && point.x < (b.x - a.x) * (point.y - a.y) / (b.y - a.y) + a.x)
+			inside = !inside;
+	}
+	return inside;
+}
+
+bool BuildingZone::Contains(const glm::vec2 &min, const glm::vec2 &max) const
+{
+	return Contains(min) && Contains(max) && Contains(glm::vec2(max.x, min.y)) && Contains(glm::vec2(min.x, max.y));
+}
+
+std::vector<BuildingPlacement> ZoneFill::Sample(const BuildingZone &zone, const Terrain &terrain, const PlacementRules &rules,
+																								const BuildingGrid &buildings, const ZoneFillSettings &settings, ThreadPool &threadPool)
+{
+	if (zone.corners.size() < 3 || settings.types.empty())
+		return {};
+
+	// Bounds of the zone on the map
+	glm::vec2 zoneMin(INFINITY);
+	glm::vec2 zoneMax(-INFINITY);
+	for (const glm::vec2 &corner : zone.corners)
+	{
+		zoneMin = glm::min(zoneMin, corner);
+		zoneMax = glm::max(zoneMax, corner);
+	}
+	zoneMin = glm::max(zoneMin, glm::vec2(-rules.worldSize * 0.5f));
+	zoneMax = glm::min(zoneMax, glm::vec2(rules.worldSize * 0.5f));
+	if (zoneMin.x >= zoneMax.x || zoneMin.y >= zoneMax.y)
+		return {};
+
+	// Two buildings conflict closer than the sum of their half sizes and the padding, a tile is as wide as the largest such distance
+	float maxSize = 0.0f;
+	for (BuildingType type : settings.types)
+	{
+		glm::vec2 size = Buildings::GetBuildingSize(type);
+		maxSize = std::max(maxSize, std::max(size.x, size.y));
+	}
+	const float tileSize = maxSize + settings.padding;
+	const int tilesX = std::max(1, static_cast<int>(std::ceil((zoneMax.x - zoneMin.x) / tileSize)));
+	const int tilesY = std::max(1, static_cast<int>(std::ceil((zoneMax.y - zoneMin.y) / tileSize)));
+	std::vector<std::vector<ZoneSample>> tiles(tilesX * tilesY);
+
+	auto fillTile = [&](int tileX, int tileY)
+	{
+		const int tileIndex = tileY * tilesX + tileX;
+		std::vector<ZoneSample> &samples = tiles[tileIndex];
+		const glm::vec2 tileMin = zoneMin + glm::vec2(tileX, tileY) * tileSize;
+		const glm::vec2 tileMax = glm::min(tileMin + tileSize, zoneMax);
+
+		// Seeded by the tile, not by the thread that happens to run it
+		std::mt19937 rng(settings.seed ^ (static_cast<uint32_t>(tileIndex) * 0x9E3779B9u));
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_int_distribution<std::size_t> typeIndex(0, settings.types.size() - 1);
+
+		// The cheap tests first, the footprint's slope last
+		auto tryAdd = [&](const glm::vec2 &position, BuildingType type)
+		{
+			if (position.x < tileMin.x || position.y < tileMin.y || position.x >= tileMax.x || position.y >= tileMax.y)
+				return false;
+
+			glm::vec2 halfSize = Buildings::GetBuildingSize(type) * 0.5f;
+			if (!zone.Contains(position - halfSize, position + halfSize))
+				return false;
+
+			// Tiles next to this one are either finished or not started yet, the ones of this phase are two tiles away
+			for (int y = std::max(tileY - 1, 0); y <= std::min(tileY + 1, tilesY - 1); ++y)
+			{
+				for (int x = std::max(tileX - 1, 0); x <= std::min(tileX + 1, tilesX - 1); ++x)
+				{
+					for (const ZoneSample &sample : tiles[y * tilesX + x])
+					{
+						if (Conflicts(sample, position, halfSize, settings.padding))
+							return false;
+					}
+				}
+			}
+
+			glm::vec2 paddedHalfSize = halfSize + settings.padding;
+			if (buildings.Overlaps(position - paddedHalfSize, position + paddedHalfSize) ||
+					!BuildingPlacementRules::IsGroundSuitable(terrain, rules, type, position))
+				return false;
+
+			samples.push_back({position, halfSize, type});
+			return true;
+		};
+
+		// A first building anywhere in the tile
+		for (int attempt = 0; attempt < settings.attempts && samples.empty(); ++attempt)
+			tryAdd(tileMin + glm::vec2(unit(rng), unit(rng)) * (tileMax - tileMin), settings.types[typeIndex(rng)]);
+
+		// Then candidates in a ring around a random active building, which retires once none of them fits
+		std::vector<std::size_t> active;
+		for (std::size_t i = 0; i < samples.size(); ++i)
+			active.push_back(i);
+		while (!active.empty())
+		{
+			std::size_t slot = std::uniform_int_distribution<std::size_t>(0, active.size() - 1)(rng);
+			const ZoneSample center = samples[active[slot]];
+
+			bool spawned = false;
+			for (int attempt = 0; attempt < settings.attempts; ++attempt)
+			{
+				BuildingType type = settings.types[typeIndex(rng)];
+				glm::vec2 reach = center.halfSize + Buildings::GetBuildingSize(type) * 0.5f + settings.padding;
+				float radius = std::max(reach.x, reach.y) * (1.0f + unit(rng));
+				float angle = unit(rng) * 6.28318530718f;
+				if (tryAdd(center.position + radius * glm::vec2(std::cos(angle), std::sin(angle)), type))
+				{
+					active.push_back(samples.size() - 1);
+					spawned = true;
+					break;
+				}
+			}
+
+			if (!spawned)
+			{
+				active[slot] = active.back();
+				active.pop_back();
+			}
+		}
+	};
+
+	std::vector<glm::ivec2> phaseTiles;
+	for (int phase = 0; phase < 4; ++phase)
+	{
+		phaseTiles.clear();
+		for (int y = phase / 2; y < tilesY; y += 2)
+		{
+			for (int x = phase % 2; x < tilesX; x += 2)
+				phaseTiles.push_back(glm::ivec2(x, y));
+		}
+
+		threadPool.ParallelFor(static_cast<int>(phaseTiles.size()), TILES_PER_JOB, [&](int begin, int end)
+													 {
+			for (int i = begin; i < end; ++i)
+				fillTile(phaseTiles[i].x, phaseTiles[i].y); });
+	}
+
+	std::vector<BuildingPlacement> placements;
+	for (const std::vector<ZoneSample> &samples : tiles)
+	{
+		for (const ZoneSample &sample : samples)
+			placements.push_back({sample.type, sample.position, settings.color});
+	}
+	return placements;
+}
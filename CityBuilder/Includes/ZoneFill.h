@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BuildingGrid.h"
+#include "BuildingPlacement.h"
+#include "Terrain.h"
+
+class ThreadPool;
+
+// Area on the XZ plane that a zone fill covers, a polygon given by its corners. A dragged rectangle is one with four
+struct BuildingZone
+{
+	std::vector<glm::vec2> corners;
+
+	static BuildingZone FromRectangle(const glm::vec2 &a, const glm::vec2 &b);
+
+	// Even-odd rule, so concave polygons work too
+	bool Contains(const glm::vec2 &point) const;
+	// All four corners of the box are inside
+	bool Contains(const glm::vec2 &min, const glm::vec2 &max) const;
+};
+
+struct ZoneFillSettings
+{
+	std::vector<BuildingType> types; // Every building of the fill is one of these, picked at random
+	glm::vec3 color = glm::vec3(1.0f);
+	float padding = 0.0f; // Free space between two footprints, the same PlaceBuildings keeps
+	int attempts = 30;		// Candidates tried around a building before it stops spawning neighbours
+	uint32_t seed = 0;
+};
+
+// Poisson-disk sampling of building footprints over a zone. The zone is cut into tiles at least as wide as two
+// footprints and their padding, and the tiles are filled in four phases of every other tile in X and Y. Tiles of a
+// phase cannot reach each other's buildings, so the worker threads fill them side by side without locking; each tile
+// grows its buildings outwards from a random seed (Bridson's algorithm) against the finished neighbouring tiles.
+namespace ZoneFill
+{
+	// Buildings whose footprint lies inside zone, on ground the rules accept and clear of the buildings already placed.
+	// The result is deterministic for a seed, whatever the number of threads
+	std::vector<BuildingPlacement> Sample(const BuildingZone &zone, const Terrain &terrain, const PlacementRules &rules,
+																				const BuildingGrid &buildings, const ZoneFillSettings &settings, ThreadPool &threadPool);
+}
@@ -11,10 +11,57 @@
 #include <array>
 #include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <iostream>
+#include <numeric>
+#include <random>
+
+namespace
+{
+	// Concrete look of the ground around a building, applied once per building that covers the texel
+	void PaintConcrete(glm::vec4 &splat)
+	{
+		splat.r *= 0.2f; // Reduce other textures
+		splat.g *= 0.2f;
+		splat.b *= 0.2f;
+		splat.a = 0.8f; // Max concrete weight
+	}
+
+	void GrowRect(TerrainRect &bounds, const TerrainRect &rect)
+	{
+		if (rect.IsEmpty())
+			return;
+		if (bounds.IsEmpty())
+		{
+			bounds = rect;
+			return;
+		}
+		bounds = {std::min(bounds.minX, rect.minX), std::min(bounds.minY, rect.minY), std::max(bounds.maxX, rect.maxX), std::max(bounds.maxY, rect.maxY)};
+	}
+
+	// Copy rect out of a copy of the map area bounds
+	template <typename T>
+	void CopySubRect(const std::vector<T> &source, const TerrainRect &bounds, const TerrainRect &rect, std::vector<T> &target)
+	{
+		target.resize(rect.IsEmpty() ? 0 : rect.GetWidth() * rect.GetHeight());
+		for (int y = rect.minY; y < rect.maxY; ++y)
+		{
+			std::copy_n(source.data() + (y - bounds.minY) * bounds.GetWidth() + (rect.minX - bounds.minX), rect.GetWidth(),
+									target.data() + (y - rect.minY) * rect.GetWidth());
+		}
+	}
+}
 
 CMyApp::CMyApp()
 {
+	// Random world unless SetWorldSeed picks one
+	m_worldSeed = static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count());
+}
+
+void CMyApp::SetWorldSeed(uint32_t seed)
+{
+	m_worldSeed = seed;
+	m_cacheTerrain = true;
 }
 
 CMyApp::~CMyApp()
@@ -40,8 +87,22 @@ void CMyApp::InitShaders()
 {
 	m_programID = glCreateProgram();
 	ProgramBuilder{m_programID}
-			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_PosNormTex.vert")
+			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_BuildingInstanced.vert")
 			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_LightingNoFaceCull.frag")
+			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_BuildingShading.frag")
+			.Link();
+
+	m_impostorBakeProgram = glCreateProgram();
+	ProgramBuilder{m_impostorBakeProgram}
+			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_ImpostorBake.vert")
+			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_ImpostorBake.frag")
+			.Link();
+
+	m_impostorProgram = glCreateProgram();
+	ProgramBuilder{m_impostorProgram}
+			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_BuildingImpostor.vert")
+			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_BuildingImpostor.frag")
+			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_BuildingShading.frag")
 			.Link();
 
 	m_programWaterID = glCreateProgram();
@@ -56,23 +117,59 @@ void CMyApp::InitShaders()
 			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_Skybox.frag")
 			.Link();
 
-	m_pickProgramID = glCreateProgram();
-	ProgramBuilder{m_pickProgramID}
-			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_Pick.vert")
-			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_Pick.frag")
-			.Link();
-
 	m_terrainProgram = glCreateProgram();
 	ProgramBuilder{m_terrainProgram}
 			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_Terrain.vert")
 			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_Terrain.frag")
 			.Link();
 
-	m_ulTerrainWorld = glGetUniformLocation(m_terrainProgram, "world");
-	m_ulTerrainWorldIT = glGetUniformLocation(m_terrainProgram, "worldInvTransp");
-	m_ulTerrainViewProj = glGetUniformLocation(m_terrainProgram, "viewProj");
-	m_ulTerrainHeightScale = glGetUniformLocation(m_terrainProgram, "heightScale");
-	m_ulTerrainTexScale = glGetUniformLocation(m_terrainProgram, "texScale");
+	m_terrainGenProgram = glCreateProgram();
+	ProgramBuilder{m_terrainGenProgram}
+			.ShaderStage(GL_COMPUTE_SHADER, "Shaders/Comp_TerrainGen.comp")
+			.Link();
+
+	// Only the depth of the terrain, for the occlusion culling of the buildings
+	m_terrainDepthProgram = glCreateProgram();
+	ProgramBuilder{m_terrainDepthProgram}
+			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_Terrain.vert")
+			.Link();
+
+	// Object IDs of the terrain and the buildings, see ObjectIdBuffer
+	m_terrainPickProgram = glCreateProgram();
+	ProgramBuilder{m_terrainPickProgram}
+			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_Terrain.vert")
+			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_TerrainPick.frag")
+			.Link();
+
+	m_buildingPickProgram = glCreateProgram();
+	ProgramBuilder{m_buildingPickProgram}
+			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_BuildingPick.vert")
+			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_BuildingPick.frag")
+			.Link();
+
+	m_hiZReduceProgram = glCreateProgram();
+	ProgramBuilder{m_hiZReduceProgram}
+			.ShaderStage(GL_COMPUTE_SHADER, "Shaders/Comp_HiZReduce.comp")
+			.Link();
+
+	m_buildingCullProgram = glCreateProgram();
+	ProgramBuilder{m_buildingCullProgram}
+			.ShaderStage(GL_COMPUTE_SHADER, "Shaders/Comp_BuildingCull.comp")
+			.Link();
+
+	m_terrainTessProgram = glCreateProgram();
+	ProgramBuilder{m_terrainTessProgram}
+			.ShaderStage(GL_VERTEX_SHADER, "Shaders/Vert_TerrainPatch.vert")
+			.ShaderStage(GL_TESS_CONTROL_SHADER, "Shaders/Tesc_Terrain.tesc")
+			.ShaderStage(GL_TESS_EVALUATION_SHADER, "Shaders/Tese_Terrain.tese")
+			.ShaderStage(GL_FRAGMENT_SHADER, "Shaders/Frag_Terrain.frag")
+			.Link();
+
+	// Set for every chunk, so looked up once
+	m_ulTerrainNodeOffset = glGetUniformLocation(m_terrainProgram, "nodeOffset");
+	m_ulTerrainNodeSize = glGetUniformLocation(m_terrainProgram, "nodeSize");
+	m_ulTerrainPatchResolution = glGetUniformLocation(m_terrainProgram, "patchResolution");
+	m_ulTerrainMorphRange = glGetUniformLocation(m_terrainProgram, "morphRange");
 }
 
 void CMyApp::InitTerrainTextures()
@@ -120,110 +217,264 @@ void CMyApp::InitTerrainTextures()
 	glGenerateTextureMipmap(m_concreteTexture);
 }
 
-void CMyApp::GenerateHeightmap()
+void CMyApp::GenerateHeightmap(unsigned seed)
 {
-	const int width = 1000;
-	const int height = 1000;
+	const int width = TERRAIN_MAP_SIZE;
+	const int height = TERRAIN_MAP_SIZE;
 
-	std::vector<float> heightData(width * height);
-
-	unsigned seed = static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count());
+	float *heightData = m_terrain.GetHeightData();
+	const TerrainNoiseParams &noise = m_terrainNoise;
 
 	PerlinNoise pn(seed);
-	for (int y = 0; y < height; ++y)
-	{
-		for (int x = 0; x < width; ++x)
+
+	// Every texel only depends on its own coordinates, so bands of rows can be generated independently
+	m_threadPool.ParallelFor(height, TERRAIN_ROWS_PER_JOB, [&](int rowBegin, int rowEnd)
+													 {
+		std::vector<float> baseNoise(width);
+		std::vector<float> edgeNoise(width);
+
+		for (int y = rowBegin; y < rowEnd; ++y)
 		{
-			double nx = x / (double)width - 0.5;
-			double ny = y / (double)height - 0.5;
+			float ny = y / (float)height - 0.5f;
+
+			// Generate multi-octave Perlin noise for the whole row at once
+			pn.octaveNoiseSpan(baseNoise.data(), width, -0.5f * noise.heightFrequency, noise.heightFrequency / width, ny * noise.heightFrequency,
+												 noise.heightOctaves, noise.persistence);
+
+			// Calculate distance from center (0-1), *2 to normalize to 0-1
+			auto distFromCenter = [&](int x)
+			{ return glm::length(glm::vec2(x / (float)width - 0.5f, ny)) * 2.0f; };
+
+			// The edge noise is only needed outside the coast circle, which leaves a span at each end of the row
+			int innerBegin = 0;
+			while (innerBegin < width && distFromCenter(innerBegin) > noise.coastRadius)
+				++innerBegin;
+			int innerEnd = width;
+			while (innerEnd > innerBegin && distFromCenter(innerEnd - 1) > noise.coastRadius)
+				--innerEnd;
+
+			const float coastStep = noise.coastFrequency / width;
+			pn.octaveNoiseSpan(edgeNoise.data(), innerBegin, -0.5f * noise.coastFrequency, coastStep, ny * noise.coastFrequency,
+												 noise.coastOctaves, noise.persistence);
+			pn.octaveNoiseSpan(edgeNoise.data() + innerEnd, width - innerEnd, (innerEnd / (float)width - 0.5f) * noise.coastFrequency, coastStep,
+												 ny * noise.coastFrequency, noise.coastOctaves, noise.persistence);
+
+			for (int x = 0; x < width; ++x)
+			{
+				// Normalize to 0-1 range
+				float value = (baseNoise[x] + 1.0f) * 0.5f;
 
-			// Calculate distance from center (0-1)
-			float distFromCenter = glm::length(glm::vec2(nx, ny)) * 2.0f; // *2 to normalize to 0-1
+				// Apply island mask - reduce height near edges
+				float islandMask = 1.0f - smoothstep(noise.islandInnerRadius, noise.islandOuterRadius, distFromCenter(x));
+				value *= islandMask;
 
-			// Generate multi-octave Perlin noise
-			double value = pn.octaveNoise(nx * 5, ny * 5, 6, 0.5);
+				// Add some extra noise to the edges to make them more interesting
+				if (x < innerBegin || x >= innerEnd)
+				{
+					value += edgeNoise[x] * noise.coastAmplitude * (1.0f - islandMask);
+				}
 
-			// Normalize to 0-1 range
-			value = (value + 1.0) * 0.5;
+				heightData[y * width + x] = value;
+			}
+		} });
+
+	m_terrain.MarkHeightsDirty(TerrainRect{0, 0, width, height});
+}
+
+void CMyApp::GenerateSplatmap(unsigned seed)
+{
+	const int width = TERRAIN_MAP_SIZE;
+	const int height = TERRAIN_MAP_SIZE;
+
+	glm::vec4 *splatData = m_terrain.GetSplatData();
+	const TerrainNoiseParams &noise = m_terrainNoise;
 
-			// Apply island mask - reduce height near edges
-			float islandMask = 1.0f - smoothstep(0.6f, 1.0f, distFromCenter);
-			value *= islandMask;
+	PerlinNoise pn(seed);
+	m_threadPool.ParallelFor(height, TERRAIN_ROWS_PER_JOB, [&](int rowBegin, int rowEnd)
+													 {
+		std::vector<float> noise1(width);
+		std::vector<float> noise2(width);
+		std::vector<float> noise3(width);
 
-			// Add some extra noise to the edges to make them more interesting
-			if (distFromCenter > 0.7f)
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			float ny = y / (float)height;
+
+			// Generate multiple noise layers
+			pn.octaveNoiseSpan(noise1.data(), width, 0.0f, noise.splatFrequencies.x / width, ny * noise.splatFrequencies.x, noise.splatOctaves.x, noise.persistence);
+			pn.octaveNoiseSpan(noise2.data(), width, 0.0f, noise.splatFrequencies.y / width, ny * noise.splatFrequencies.y, noise.splatOctaves.y, noise.persistence);
+			pn.octaveNoiseSpan(noise3.data(), width, 0.0f, noise.splatFrequencies.z / width, ny * noise.splatFrequencies.z, noise.splatOctaves.z, noise.persistence);
+
+			for (int x = 0; x < width; ++x)
 			{
-				double edgeNoise = pn.octaveNoise(nx * 10, ny * 10, 2, 0.5) * 0.2;
-				value += edgeNoise * (1.0 - islandMask);
+				// Create interesting patterns
+				glm::vec4 weights(0.0f);
+				weights.r = (noise1[x] + 1.0f) * 0.5f;												 // Texture 0
+				weights.g = (noise2[x] + 1.0f) * 0.5f;												 // Texture 1
+				weights.b = (noise3[x] + 1.0f) * 0.5f;												 // Texture 2
+				weights.a = 1.0f - (weights.r + weights.g + weights.b) / 3.0f; // Texture 3
+
+				// Normalize weights
+				float sum = weights.r + weights.g + weights.b + weights.a;
+				weights /= sum;
+
+				splatData[y * width + x] = weights;
 			}
+		} });
 
-			heightData[y * width + x] = static_cast<float>(value);
-		}
-	}
+	m_terrain.MarkSplatDirty(TerrainRect{0, 0, width, height});
+}
+
+void CMyApp::GenerateTerrainMapsGPU(unsigned heightSeed, unsigned splatSeed)
+{
+	const int width = TERRAIN_MAP_SIZE;
+	const int height = TERRAIN_MAP_SIZE;
+
+	// The shader evaluates the same noise as the CPU path, from the same permutation tables
+	PerlinNoise heightNoise(heightSeed);
+	PerlinNoise splatNoise(splatSeed);
+
+	std::array<GLint, 2 * PerlinNoise::PERMUTATION_SIZE> permutations;
+	std::copy_n(heightNoise.permutation(), PerlinNoise::PERMUTATION_SIZE, permutations.begin());
+	std::copy_n(splatNoise.permutation(), PerlinNoise::PERMUTATION_SIZE, permutations.begin() + PerlinNoise::PERMUTATION_SIZE);
+
+	GLuint permutationBuffer = 0;
+	glCreateBuffers(1, &permutationBuffer);
+	glNamedBufferStorage(permutationBuffer, sizeof(permutations), permutations.data(), 0);
+
+	glUseProgram(m_terrainGenProgram);
+	glUniform2i(ul("mapSize"), width, height);
+	const TerrainNoiseParams &noise = m_terrainNoise;
+	glUniform1f(ul("heightFrequency"), noise.heightFrequency);
+	glUniform1i(ul("heightOctaves"), noise.heightOctaves);
+	glUniform2f(ul("islandRadii"), noise.islandInnerRadius, noise.islandOuterRadius);
+	glUniform1f(ul("coastRadius"), noise.coastRadius);
+	glUniform1f(ul("coastFrequency"), noise.coastFrequency);
+	glUniform1i(ul("coastOctaves"), noise.coastOctaves);
+	glUniform1f(ul("coastAmplitude"), noise.coastAmplitude);
+	glUniform3fv(ul("splatFrequencies"), 1, glm::value_ptr(noise.splatFrequencies));
+	glUniform3iv(ul("splatOctaves"), 1, glm::value_ptr(noise.splatOctaves));
+	glUniform1f(ul("persistence"), noise.persistence);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, permutationBuffer);
+	glBindImageTexture(0, m_terrain.GetHeightmapTexture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindImageTexture(1, m_terrain.GetSplatmapTexture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+	const GLuint groupSize = 16; // Matches local_size in Comp_TerrainGen.comp
+	glDispatchCompute((width + groupSize - 1) / groupSize, (height + groupSize - 1) / groupSize, 1);
+
+	// Make the image writes visible to texture sampling and to the readback below
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+	glUseProgram(0);
+	glDeleteBuffers(1, &permutationBuffer);
+}
+
+bool CMyApp::LoadTerrainMapsFromCache(const TerrainGenParams &params)
+{
+	TerrainCache cache;
+	if (!cache.Open(params))
+		return false;
 
-	// Create texture (same as before)
-	glCreateTextures(GL_TEXTURE_2D, 1, &m_heightmapTexture);
-	glTextureStorage2D(m_heightmapTexture, 1, GL_R32F, width, height);
-	glTextureSubImage2D(m_heightmapTexture, 0, 0, 0, width, height, GL_RED, GL_FLOAT, heightData.data());
-	glTextureParameteri(m_heightmapTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTextureParameteri(m_heightmapTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTextureParameteri(m_heightmapTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTextureParameteri(m_heightmapTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// The textures are uploaded straight from the mapping
+	m_terrain.Load(cache.GetHeightmap(), cache.GetSplatmap());
+	return true;
 }
 
-void CMyApp::GenerateSplatmap()
+void CMyApp::GenerateTerrainMaps(bool loadFromCache)
 {
-	const int width = 1000;
-	const int height = 1000;
+	TerrainGenParams params;
+	params.seed = m_worldSeed;
+	params.mapSize = TERRAIN_MAP_SIZE;
+	params.generator = m_generateTerrainOnGPU ? TerrainGenerator::GPU : TerrainGenerator::CPU;
+	params.noise = m_terrainNoise;
 
-	std::vector<glm::vec4> splatData(width * height);
+	// Readbacks of an earlier GPU generation still in flight must not land on these maps
+	const uint32_t generation = ++m_terrainGeneration;
+	m_terrainMapsPending = false;
 
-	unsigned seed = static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count());
+	auto generationStart = std::chrono::steady_clock::now();
 
-	PerlinNoise pn(seed);
-	for (int y = 0; y < height; ++y)
+	if (loadFromCache && LoadTerrainMapsFromCache(params))
 	{
-		for (int x = 0; x < width; ++x)
-		{
-			double nx = x / (double)width;
-			double ny = y / (double)height;
+		std::chrono::duration<double, std::milli> wallTime = std::chrono::steady_clock::now() - generationStart;
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Terrain maps for seed %u loaded from cache in %.1f ms", m_worldSeed, wallTime.count());
+		m_terrainGenerationTimeMs = static_cast<float>(wallTime.count());
+		FinishTerrainMaps(params, false);
+		return;
+	}
 
-			// Generate multiple noise layers
-			double noise1 = pn.octaveNoise(nx * 5, ny * 5, 3, 0.5);
-			double noise2 = pn.octaveNoise(nx * 10, ny * 10, 4, 0.5);
-			double noise3 = pn.octaveNoise(nx * 20, ny * 20, 2, 0.5);
-
-			// Create interesting patterns
-			glm::vec4 weights(0.0f);
-			weights.r = (float)((noise1 + 1) * 0.5);											 // Texture 0
-			weights.g = (float)((noise2 + 1) * 0.5);											 // Texture 1
-			weights.b = (float)((noise3 + 1) * 0.5);											 // Texture 2
-			weights.a = 1.0f - (weights.r + weights.g + weights.b) / 3.0f; // Texture 3
-
-			// Normalize weights
-			float sum = weights.r + weights.g + weights.b + weights.a;
-			weights /= sum;
-
-			splatData[y * width + x] = weights;
-		}
+	if (m_generateTerrainOnGPU)
+	{
+		GenerateTerrainMapsGPU(m_worldSeed, m_worldSeed + 1);
+
+		// The CPU maps are the source of truth, they arrive through the readback a frame or two later. Until then
+		// the terrain is drawn from the textures with bounds spanning every height the noise can reach, and nothing
+		// may pick or edit it. The height pyramid keeps the old map, it is only read once the maps are in
+		m_terrainMapsPending = true;
+		const glm::vec2 heightRange(-m_terrainNoise.coastAmplitude, 1.0f + m_terrainNoise.coastAmplitude);
+		m_terrainQuadtree.Build(TERRAIN_LOD_COUNT, heightRange);
+		m_terrainTessellator.Create(TERRAIN_TESS_PATCHES, heightRange);
+
+		const std::size_t texelCount = TERRAIN_MAP_SIZE * TERRAIN_MAP_SIZE;
+		m_gpuReadback.ReadTexture(m_terrain.GetHeightmapTexture(), 0, GL_RED, GL_FLOAT, texelCount * sizeof(float), [this, generation](const void *data, std::size_t size)
+															{
+			if (generation == m_terrainGeneration)
+				std::memcpy(m_terrain.GetHeightData(), data, size); });
+		m_gpuReadback.ReadTexture(m_terrain.GetSplatmapTexture(), 0, GL_RGBA, GL_FLOAT, texelCount * sizeof(glm::vec4), [this, params, generation, generationStart](const void *data, std::size_t size)
+															{
+			if (generation != m_terrainGeneration)
+				return;
+
+			std::memcpy(m_terrain.GetSplatData(), data, size);
+			m_terrain.UpdateNormals();
+			m_terrainMapsPending = false;
+
+			// Until the maps are on the CPU, so the wall time covers the GPU work too
+			std::chrono::duration<double, std::milli> wallTime = std::chrono::steady_clock::now() - generationStart;
+			SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Terrain maps for seed %u generated on the GPU in %.1f ms", m_worldSeed, wallTime.count());
+			m_terrainGenerationTimeMs = static_cast<float>(wallTime.count());
+			FinishTerrainMaps(params, m_cacheTerrain); });
+		return;
 	}
 
-	glCreateTextures(GL_TEXTURE_2D, 1, &m_splatmapTexture);
-	glTextureStorage2D(m_splatmapTexture, 1, GL_RGBA32F, width, height);
-	glTextureSubImage2D(m_splatmapTexture, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, splatData.data());
-	glTextureParameteri(m_splatmapTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTextureParameteri(m_splatmapTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTextureParameteri(m_splatmapTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTextureParameteri(m_splatmapTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	m_threadPool.ResetBusyTime();
+
+	GenerateHeightmap(m_worldSeed);
+	GenerateSplatmap(m_worldSeed + 1);
+
+	// Busy time is the sum over all threads, which is what the serial loops would have cost
+	std::chrono::duration<double, std::milli> wallTime = std::chrono::steady_clock::now() - generationStart;
+	std::chrono::duration<double, std::milli> busyTime = m_threadPool.GetBusyTime();
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Terrain maps for seed %u generated in %.1f ms on %u threads (%.1f ms of work, %.1fx speedup)",
+							m_worldSeed, wallTime.count(), m_threadPool.GetThreadCount(), busyTime.count(), busyTime.count() / wallTime.count());
+	m_terrainGenerationTimeMs = static_cast<float>(wallTime.count());
+
+	// Random seeds are unlikely to come up again, only chosen worlds are worth the disk space
+	FinishTerrainMaps(params, m_cacheTerrain);
+}
+
+void CMyApp::FinishTerrainMaps(const TerrainGenParams &params, bool writeCache)
+{
+	m_terrainQuadtree.Build(m_terrain, TERRAIN_LOD_COUNT);
+	m_terrainTessellator.Create(m_terrain, TERRAIN_TESS_PATCHES);
+	m_terrainHeightPyramid.Build(m_terrain);
+
+	if (writeCache)
+		TerrainCache::Write(params, m_terrain.GetHeightData(), m_terrain.GetSplatData());
 }
 
 void CMyApp::GenerateTerrain()
 {
-	GenerateHeightmap();
-	GenerateSplatmap();
+	m_terrain.Create(TERRAIN_MAP_SIZE);
+	m_terrainTimer.Create();
+	GenerateTerrainMaps();
 
-	const int gridSize = 256;
-	const float gridSpacing = 1.0f;
+	// Every quadtree node is drawn with this patch, a grid over [0, 1]^2 scaled and offset in the vertex shader
+	const int gridSize = TERRAIN_PATCH_RESOLUTION + 1;
 
 	std::vector<glm::vec2> vertices;
 	std::vector<GLuint> indices;
@@ -239,23 +490,29 @@ void CMyApp::GenerateTerrain()
 		}
 	}
 
-	// Generate indices
-	for (int z = 0; z < gridSize - 1; ++z)
+	// Generate indices quadrant by quadrant, so a quarter of a node can be drawn on its own
+	const int half = TERRAIN_PATCH_RESOLUTION / 2;
+	for (int quadrant = 0; quadrant < 4; ++quadrant)
 	{
-		for (int x = 0; x < gridSize - 1; ++x)
+		int quadrantX = (quadrant & 1) * half;
+		int quadrantZ = (quadrant >> 1) * half;
+		for (int z = quadrantZ; z < quadrantZ + half; ++z)
 		{
-			int topLeft = z * gridSize + x;
-			int topRight = topLeft + 1;
-			int bottomLeft = (z + 1) * gridSize + x;
-			int bottomRight = bottomLeft + 1;
-
-			indices.push_back(topLeft);
-			indices.push_back(bottomLeft);
-			indices.push_back(topRight);
-
-			indices.push_back(topRight);
-			indices.push_back(bottomLeft);
-			indices.push_back(bottomRight);
+			for (int x = quadrantX; x < quadrantX + half; ++x)
+			{
+				int topLeft = z * gridSize + x;
+				int topRight = topLeft + 1;
+				int bottomLeft = (z + 1) * gridSize + x;
+				int bottomRight = bottomLeft + 1;
+
+				indices.push_back(topLeft);
+				indices.push_back(bottomLeft);
+				indices.push_back(topRight);
+
+				indices.push_back(topRight);
+				indices.push_back(bottomLeft);
+				indices.push_back(bottomRight);
+			}
 		}
 	}
 
@@ -283,20 +540,22 @@ void CMyApp::GenerateTerrain()
 
 void CMyApp::RenderTerrain()
 {
-	glUseProgram(m_terrainProgram);
+	// Both render modes share the fragment shader and its uniforms
+	glUseProgram(m_terrainRenderMode == TerrainRenderMode::Tessellated ? m_terrainTessProgram : m_terrainProgram);
 
-	glUniform1f(glGetUniformLocation(m_terrainProgram, "verticalOffset"), m_terrainVerticalOffset);
+	glUniform1f(ul("verticalOffset"), m_terrainVerticalOffset);
 
 	// Set texture unit indices first
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "splatmap"), 1);
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "groundTextures[0]"), 2);
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "groundTextures[1]"), 3);
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "groundTextures[2]"), 4);
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "groundTextures[3]"), 5);
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "rockTexture"), 6);
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "sandTexture"), 7);
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "snowTexture"), 8);
-	glUniform1i(glGetUniformLocation(m_terrainProgram, "concreteTexture"), 9);
+	glUniform1i(ul("splatmap"), 1);
+	glUniform1i(ul("groundTextures[0]"), 2);
+	glUniform1i(ul("groundTextures[1]"), 3);
+	glUniform1i(ul("groundTextures[2]"), 4);
+	glUniform1i(ul("groundTextures[3]"), 5);
+	glUniform1i(ul("rockTexture"), 6);
+	glUniform1i(ul("sandTexture"), 7);
+	glUniform1i(ul("snowTexture"), 8);
+	glUniform1i(ul("concreteTexture"), 9);
+	glUniform1i(ul("normalMap"), 10);
 
 	// Sky and light colors
 	glUniform3fv(ul("sunColor"), 1, glm::value_ptr(m_sunColor));
@@ -313,15 +572,16 @@ void CMyApp::RenderTerrain()
 	glm::mat4 world = glm::mat4(1.0f);
 	world = glm::scale(world, glm::vec3(100.0f, 1.0f, 100.0f));
 
-	glUniformMatrix4fv(m_ulTerrainWorld, 1, GL_FALSE, glm::value_ptr(world));
-	glUniformMatrix4fv(m_ulTerrainWorldIT, 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::inverse(world))));
-	glUniformMatrix4fv(m_ulTerrainViewProj, 1, GL_FALSE, glm::value_ptr(m_camera.GetViewProj()));
-	glUniform1f(m_ulTerrainHeightScale, m_terrainHeightScale);
-	glUniform1f(m_ulTerrainTexScale, m_terrainTexScale);
+	glUniformMatrix4fv(ul("world"), 1, GL_FALSE, glm::value_ptr(world));
+	glUniformMatrix4fv(ul("worldInvTransp"), 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::inverse(world))));
+	glUniformMatrix4fv(ul("viewProj"), 1, GL_FALSE, glm::value_ptr(m_camera.GetViewProj()));
+	glUniform1f(ul("heightScale"), m_terrainHeightScale);
+	glUniform1f(ul("texScale"), m_terrainTexScale);
+	glUniform3fv(ul("cameraPos"), 1, glm::value_ptr(m_camera.GetEye()));
 
 	// Bind textures to correct units
-	glBindTextureUnit(0, m_heightmapTexture);
-	glBindTextureUnit(1, m_splatmapTexture);
+	glBindTextureUnit(0, m_terrain.GetHeightmapTexture());
+	glBindTextureUnit(1, m_terrain.GetSplatmapTexture());
 	for (int i = 0; i < 4; ++i)
 	{
 		glBindTextureUnit(2 + i, m_groundTextures[i]);
@@ -330,6 +590,7 @@ void CMyApp::RenderTerrain()
 	glBindTextureUnit(7, m_sandTexture);
 	glBindTextureUnit(8, m_snowTexture);
 	glBindTextureUnit(9, m_concreteTexture);
+	glBindTextureUnit(10, m_terrain.GetNormalTexture());
 
 	// Bind samplers
 	for (int i = 0; i < 9; ++i)
@@ -340,10 +601,12 @@ void CMyApp::RenderTerrain()
 	// Set lighting uniforms
 	SetLightingUniforms(32.0f, glm::vec3(0.1f), glm::vec3(1.0f), glm::vec3(0.5f));
 
-	// Draw terrain
-	glBindVertexArray(m_terrainVAO);
-	glDrawElements(GL_TRIANGLES, m_terrainIndexCount, GL_UNSIGNED_INT, nullptr);
-	glBindVertexArray(0);
+	m_terrainTimer.Begin();
+	if (m_terrainRenderMode == TerrainRenderMode::Tessellated)
+		RenderTerrainTessellated();
+	else
+		RenderTerrainChunked();
+	m_terrainTimer.End();
 
 	// Unbind textures and samplers
 	for (int i = 0; i < 9; ++i)
@@ -351,6 +614,149 @@ void CMyApp::RenderTerrain()
 		glBindTextureUnit(i, 0);
 		glBindSampler(i, 0);
 	}
+	glBindTextureUnit(10, 0);
+}
+
+TerrainQuadtree::WorldMapping CMyApp::GetTerrainMapping() const
+{
+	TerrainQuadtree::WorldMapping mapping;
+	mapping.worldSize = 100.0f;
+	mapping.heightScale = m_terrainHeightScale;
+	mapping.heightOffset = m_terrainVerticalOffset - m_terrainHeightScale / 2.0f;
+	return mapping;
+}
+
+void CMyApp::SelectTerrainPatches()
+{
+	// Pick the visible quadtree nodes and their detail for this view
+	m_terrainQuadtree.SetLodDistance(m_terrainLodDistance);
+	m_terrainQuadtree.Select(m_camera.GetViewProj(), m_camera.GetEye(), GetTerrainMapping(), m_terrainPatches);
+}
+
+void CMyApp::RenderTerrainChunked()
+{
+	SelectTerrainPatches();
+	glUniform1f(m_ulTerrainPatchResolution, static_cast<float>(TERRAIN_PATCH_RESOLUTION));
+	DrawTerrainPatches(m_ulTerrainNodeOffset, m_ulTerrainNodeSize, m_ulTerrainMorphRange);
+}
+
+void CMyApp::DrawTerrainPatches(GLint ulNodeOffset, GLint ulNodeSize, GLint ulMorphRange)
+{
+	const GLsizei quadrantIndexCount = static_cast<GLsizei>(m_terrainIndexCount / 4);
+	glBindVertexArray(m_terrainVAO);
+	for (const TerrainPatch &patch : m_terrainPatches)
+	{
+		glUniform2fv(ulNodeOffset, 1, glm::value_ptr(patch.offset));
+		glUniform1f(ulNodeSize, patch.size);
+		glUniform2fv(ulMorphRange, 1, glm::value_ptr(m_terrainQuadtree.GetMorphRange(patch.lod)));
+
+		if (patch.quadrant < 0)
+			glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_terrainIndexCount), GL_UNSIGNED_INT, nullptr);
+		else
+			glDrawElements(GL_TRIANGLES, quadrantIndexCount, GL_UNSIGNED_INT, reinterpret_cast<const void *>(patch.quadrant * quadrantIndexCount * sizeof(GLuint)));
+	}
+	glBindVertexArray(0);
+}
+
+void CMyApp::DrawTerrainDepth()
+{
+	glm::mat4 world = glm::scale(glm::vec3(100.0f, 1.0f, 100.0f));
+	glUniformMatrix4fv(ul("world"), 1, GL_FALSE, glm::value_ptr(world));
+	glUniformMatrix4fv(ul("viewProj"), 1, GL_FALSE, glm::value_ptr(m_camera.GetViewProj()));
+	glUniform1f(ul("heightScale"), m_terrainHeightScale);
+	glUniform1f(ul("verticalOffset"), m_terrainVerticalOffset);
+	glUniform3fv(ul("cameraPos"), 1, glm::value_ptr(m_camera.GetEye()));
+	glUniform1f(ul("patchResolution"), static_cast<float>(TERRAIN_PATCH_RESOLUTION));
+
+	glBindTextureUnit(0, m_terrain.GetHeightmapTexture());
+	glBindSampler(0, m_SamplerID);
+
+	SelectTerrainPatches();
+	DrawTerrainPatches(ul("nodeOffset"), ul("nodeSize"), ul("morphRange"));
+
+	glBindTextureUnit(0, 0);
+	glBindSampler(0, 0);
+}
+
+void CMyApp::RenderTerrainOccluders()
+{
+	// The chunked mesh of the terrain in either render mode, the tessellated one only differs in small detail
+	m_terrainHiZ.BeginDepthPass();
+	glUseProgram(m_terrainDepthProgram);
+	DrawTerrainDepth();
+	m_terrainHiZ.EndDepthPass();
+
+	glUseProgram(m_hiZReduceProgram);
+	m_terrainHiZ.BuildPyramid();
+}
+
+void CMyApp::RenderTerrainTessellated()
+{
+	int viewportWidth, viewportHeight;
+	GetViewportSize(viewportWidth, viewportHeight);
+
+	glUniform1i(ul("patchInfo"), 11);
+	glUniform1i(ul("patchesPerSide"), m_terrainTessellator.GetPatchesPerSide());
+	glUniform1f(ul("pixelsPerUnit"), m_camera.GetProj()[1][1] * viewportHeight * 0.5f);
+	glUniform1f(ul("targetEdgePixels"), m_terrainTessEdgePixels);
+	glUniform1f(ul("maxTessLevel"), 64.0f);
+
+	glBindTextureUnit(11, m_terrainTessellator.GetPatchInfoTexture());
+	m_terrainTessellator.Draw();
+	glBindTextureUnit(11, 0);
+}
+
+void CMyApp::UpdateTerrainBenchmark()
+{
+	if (m_terrainBenchmarkFrame < 0)
+		return;
+
+	// Every mode gets the same number of frames, the first ones are skipped because
+	// the timer reports results a few frames late and the previous mode may still show up
+	const int modeIndex = m_terrainBenchmarkFrame / TERRAIN_BENCHMARK_FRAMES;
+	const int modeFrame = m_terrainBenchmarkFrame % TERRAIN_BENCHMARK_FRAMES;
+	if (modeFrame >= TERRAIN_BENCHMARK_WARMUP_FRAMES && m_terrainTimer.GetResultCount() != m_terrainBenchmarkLastResult)
+	{
+		m_terrainBenchmarkTimeMs[modeIndex] += m_terrainTimer.GetLastMs();
+		++m_terrainBenchmarkSamples[modeIndex];
+	}
+	m_terrainBenchmarkLastResult = m_terrainTimer.GetResultCount();
+
+	++m_terrainBenchmarkFrame;
+	if (m_terrainBenchmarkFrame == TERRAIN_BENCHMARK_FRAMES)
+	{
+		m_terrainRenderMode = TerrainRenderMode::Tessellated;
+		return;
+	}
+	if (m_terrainBenchmarkFrame < 2 * TERRAIN_BENCHMARK_FRAMES)
+		return;
+
+	const char *names[2] = {"Terrain chunked (CDLOD)", "Terrain tessellated"};
+	m_benchmarkResults.clear();
+	for (int i = 0; i < 2; ++i)
+	{
+		double averageMs = m_terrainBenchmarkTimeMs[i] / std::max(1, m_terrainBenchmarkSamples[i]);
+		BenchmarkResult result;
+		result.name = names[i];
+		result.unit = "frames";
+		result.itemsPerSecond = averageMs > 0.0 ? 1000.0 / averageMs : 0.0;
+		result.speedup = m_benchmarkResults.empty() || result.itemsPerSecond == 0.0 ? 1.0 : result.itemsPerSecond / m_benchmarkResults[0].itemsPerSecond;
+		m_benchmarkResults.push_back(result);
+	}
+	LogBenchmarkResults("Terrain rendering (GPU time)", m_benchmarkResults);
+
+	m_terrainRenderMode = m_terrainModeBeforeBenchmark;
+	m_terrainBenchmarkFrame = -1;
+}
+
+void CMyApp::StartTerrainBenchmark()
+{
+	m_terrainModeBeforeBenchmark = m_terrainRenderMode;
+	m_terrainRenderMode = TerrainRenderMode::Chunked;
+	m_terrainBenchmarkFrame = 0;
+	m_terrainBenchmarkTimeMs[0] = m_terrainBenchmarkTimeMs[1] = 0.0;
+	m_terrainBenchmarkSamples[0] = m_terrainBenchmarkSamples[1] = 0;
+	m_terrainBenchmarkLastResult = m_terrainTimer.GetResultCount();
 }
 
 void CMyApp::CleanShaders()
@@ -358,6 +764,15 @@ void CMyApp::CleanShaders()
 	glDeleteProgram(m_programID);
 	glDeleteProgram(m_programWaterID);
 	glDeleteProgram(m_programSkyboxID);
+	glDeleteProgram(m_terrainGenProgram);
+	glDeleteProgram(m_terrainTessProgram);
+	glDeleteProgram(m_buildingCullProgram);
+	glDeleteProgram(m_impostorBakeProgram);
+	glDeleteProgram(m_impostorProgram);
+	glDeleteProgram(m_terrainDepthProgram);
+	glDeleteProgram(m_hiZReduceProgram);
+	glDeleteProgram(m_terrainPickProgram);
+	glDeleteProgram(m_buildingPickProgram);
 }
 
 struct Param
@@ -532,20 +947,12 @@ void CMyApp::InitTextures()
 	glGenerateTextureMipmap(m_waterTextureID);
 
 	InitSkyboxTextures();
-
-	// Load building texture
-	ImageRGBA buildingImage = ImageFromFile("Assets/House1_Diffuse.png");
-	glCreateTextures(GL_TEXTURE_2D, 1, &m_buildingTextureID);
-	glTextureStorage2D(m_buildingTextureID, NumberOfMIPLevels(buildingImage), GL_RGBA8, buildingImage.width, buildingImage.height);
-	glTextureSubImage2D(m_buildingTextureID, 0, 0, 0, buildingImage.width, buildingImage.height, GL_RGBA, GL_UNSIGNED_BYTE, buildingImage.data());
-	glGenerateTextureMipmap(m_buildingTextureID);
 }
 
 void CMyApp::CleanTextures()
 {
 	glDeleteTextures(1, &m_waterTextureID);
 	glDeleteTextures(1, &m_SkyboxTextureID);
-	glDeleteTextures(1, &m_buildingTextureID);
 	glDeleteSamplers(1, &m_SamplerID);
 }
 
@@ -594,13 +1001,21 @@ bool CMyApp::Init()
 	m_moonLd = glm::vec3(0.2f, 0.2f, 0.3f);
 	m_moonLs = glm::vec3(0.3f, 0.3f, 0.4f);
 
+	m_gpuReadback.Create(READBACK_SLOT_SIZE);
 	InitTerrainTextures();
 	GenerateTerrain();
 
-	Buildings::Initialize();
-	m_pickData = new glm::vec3;
+	if (!Buildings::Initialize(m_threadPool))
+		return false;
+	m_buildingRenderer.Create();
+	glUseProgram(m_impostorBakeProgram);
+	m_buildingImpostors.Bake();
+	glUseProgram(0);
+	m_buildingGrid.Create(glm::vec2(-50.0f), glm::vec2(50.0f), BUILDING_GRID_CELL_SIZE);
+	m_terrainJournal.SetLimits(m_terrainJournalMaxEdits, TERRAIN_JOURNAL_MAX_BYTES);
 	m_buildingColor = glm::vec3(1.0f, 1.0f, 1.0f); // Default white
-	CreateFrameBuffer(800, 600);
+	m_terrainHiZ.Resize(800, 600);
+	m_objectIds.Resize(800, 600);
 
 	return true;
 }
@@ -609,14 +1024,15 @@ void CMyApp::Clean()
 {
 	CleanShaders();
 	CleanGeometry();
+	m_terrain.Destroy();
+	m_terrainTessellator.Destroy();
+	m_terrainTimer.Destroy();
+	m_buildingRenderer.Destroy();
+	m_buildingImpostors.Destroy();
+	m_terrainHiZ.Destroy();
+	m_objectIds.Destroy();
 	Buildings::Cleanup();
-	delete m_pickData;
-	if (m_frameBufferCreated)
-	{
-		glDeleteRenderbuffers(1, &m_depthBuffer);
-		glDeleteTextures(1, &m_colorBuffer);
-		glDeleteFramebuffers(1, &m_frameBuffer);
-	}
+	m_gpuReadback.Destroy();
 	CleanTextures();
 }
 
@@ -662,26 +1078,38 @@ void CMyApp::SetLightingUniforms(float Shininess, glm::vec3 Ka, glm::vec3 Kd, gl
 
 void CMyApp::Render()
 {
-	// First pass - render to FBO for picking
-	glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
-	// Clear the framebuffer (GL_COLOR_BUFFER_BIT)...
-	// ... and the depth Z-buffer (GL_DEPTH_BUFFER_BIT)
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// Readbacks that finished since the last frame
+	m_gpuReadback.Update();
 
-	// Render terrain to FBO with pick shader
-	glUseProgram(m_pickProgramID);
-	glm::mat4 world = glm::mat4(1.0f);
-	world = glm::scale(world, glm::vec3(100.0f, 1.0f, 100.0f));
-	world = glm::translate(world, glm::vec3(-0.5f, 0.0f, -0.5f));
+	// Terrain edits since the last frame
+	for (const TerrainRect &rect : m_terrain.GetDirtyHeightRects())
+	{
+		m_terrainQuadtree.UpdateBounds(m_terrain, rect);
+		m_terrainTessellator.UpdatePatchInfo(m_terrain, rect);
+		m_terrainHeightPyramid.Update(m_terrain, rect);
+		m_objectIdsStale = true;
+		m_cursorMoved = true; // The ground under a resting cursor may have moved
+	}
+	m_terrain.UploadDirty();
 
-	glUniformMatrix4fv(glGetUniformLocation(m_pickProgramID, "world"), 1, GL_FALSE, glm::value_ptr(world));
-	glUniformMatrix4fv(glGetUniformLocation(m_pickProgramID, "viewProj"), 1, GL_FALSE, glm::value_ptr(m_camera.GetViewProj()));
+	// Terrain under the mouse, if the cursor, the camera or the terrain changed since the last frame
+	UpdatePick();
 
-	glBindVertexArray(m_terrainVAO);
-	glDrawElements(GL_TRIANGLES, m_terrainIndexCount, GL_UNSIGNED_INT, nullptr);
+	// Objects under the clicks the last ID buffer could not answer
+	if (!m_pendingObjectPicks.empty() && !m_objectIdsInFlight)
+	{
+		if (AreObjectIdsCurrent())
+		{
+			for (const ObjectPick &pick : m_pendingObjectPicks)
+				HandleObjectPick(pick);
+			m_pendingObjectPicks.clear();
+		}
+		else
+		{
+			RenderObjectIds();
+		}
+	}
 
-	// Second pass - normal rendering to screen
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	// =========== SKYBOX ===========
@@ -742,26 +1170,21 @@ void CMyApp::Render()
 
 	// =========== TERRAIN ===========
 	RenderTerrain();
+	UpdateTerrainBenchmark();
 
 	// =========== BUILDINGS ===========
-	// Render building preview if active
-	if (m_showBuildingPreview)
-	{
-		glUseProgram(m_programID);
-		glm::mat4 previewWorld = glm::translate(m_buildingPreviewPos);
-		glUniformMatrix4fv(ul("world"), 1, GL_FALSE, glm::value_ptr(previewWorld));
-		glUniformMatrix4fv(ul("worldInvTransp"), 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::inverse(previewWorld))));
-
-		const BuildingData &data = Buildings::GetBuildingData(m_selectedBuildingType);
-		glBindVertexArray(data.vao);
-		glDrawArrays(GL_TRIANGLES, 0, data.vertexCount);
-	}
-
-	// Render all placed buildings
+	// Render all placed buildings and the preview
 	RenderBuildings();
 
 	// ===========================
 
+	// The scene without the GUI, which is drawn after Render
+	if (m_screenshotRequested)
+	{
+		TakeScreenshot();
+		m_screenshotRequested = false;
+	}
+
 	// Disable shader
 	glUseProgram(0);
 
@@ -813,25 +1236,153 @@ void CMyApp::RenderGUI()
 	}
 	ImGui::End();
 
+	DrawZoneOutline();
+	RenderSelectionGUI();
+
 	if (ImGui::Begin("Building Settings"))
 	{
-		const char *buildingTypes[] = {
-				"Studio Flat",
-				"Small House",
-				"Family House",
-				"Tower",
-				"Apartment Block"};
-
-		int currentType = static_cast<int>(m_selectedBuildingType);
-		if (ImGui::Combo("Building Type", &currentType, buildingTypes, IM_ARRAYSIZE(buildingTypes)))
+		// The types come from the catalogue file
+		if (ImGui::BeginCombo("Building Type", Buildings::GetBuildingData(m_selectedBuildingType).name.c_str()))
 		{
-			m_selectedBuildingType = static_cast<BuildingType>(currentType);
+			for (BuildingType type = 0; type < Buildings::GetTypeCount(); ++type)
+			{
+				bool selected = type == m_selectedBuildingType;
+				if (ImGui::Selectable(Buildings::GetBuildingData(type).name.c_str(), selected))
+					m_selectedBuildingType = type;
+				if (selected)
+					ImGui::SetItemDefaultFocus();
+			}
+			ImGui::EndCombo();
 		}
 
 		ImGui::ColorEdit3("Building Color", &m_buildingColor[0]);
 
 		ImGui::Text("Ctrl + Left click to place building");
-		ImGui::Text("Buildings placed: %d", m_buildings.size());
+		ImGui::Text("Shift + Left click to demolish building");
+		ImGui::Text("Left click to select a building, Delete to demolish it");
+		ImGui::Text("Shift + Left drag to select an area, Shift + Enter to select the polygon");
+		ImGui::Text("Buildings placed: %d", static_cast<int>(m_buildings.GetCount()));
+		ImGui::Text("Cursor ray: %.1f us, readbacks in flight: %d", m_pickTimeUs, static_cast<int>(m_gpuReadback.GetPendingCount()));
+		ImGui::Text("Object ID passes: %d at %dx%d", m_objectIdPassCount, m_objectIds.GetWidth(), m_objectIds.GetHeight());
+		ImGui::SliderFloat("Max slope", &m_buildingMaxSlope, 0.05f, 2.0f, "%.2f");
+		if (ImGui::Button("Scatter 10k buildings"))
+			ScatterBuildings(10000);
+		if (m_lastBulkPlacement.candidateCount > 0)
+		{
+			ImGui::Text("Last batch: %d of %d placed in %.1f ms", static_cast<int>(m_lastBulkPlacement.placedCount),
+									static_cast<int>(m_lastBulkPlacement.candidateCount), m_lastBulkPlacement.milliseconds);
+		}
+
+		ImGui::Text("Alt + Left drag to fill a rectangle with buildings");
+		ImGui::Text("Alt + Right click polygon corners, Enter to fill it");
+		ImGui::Checkbox("Fill with every type", &m_zoneFillAllTypes);
+		ImGui::SliderInt("Fill attempts", &m_zoneFillAttempts, 1, 60);
+		if (m_lastZoneFill.sampleCount > 0)
+			ImGui::Text("Last zone: %d sampled in %.1f ms", static_cast<int>(m_lastZoneFill.sampleCount), m_lastZoneFill.samplingMilliseconds);
+		ImGui::SliderFloat("Cull distance", &m_buildingCullDistance, 0.0f, 200.0f, m_buildingCullDistance > 0.0f ? "%.0f" : "off");
+		ImGui::SliderFloat("Impostor distance", &m_buildingImpostorDistance, 0.0f, 200.0f, m_buildingImpostorDistance > 0.0f ? "%.0f" : "off");
+		ImGui::Checkbox("Terrain occlusion culling", &m_buildingOcclusionCulling);
+		ImGui::Text("Visible: %u (%u impostors), culled: %u", m_buildingRenderer.GetVisibleCount(),
+								m_buildingRenderer.GetImpostorCount(), m_buildingRenderer.GetCulledCount());
+		unsigned int placedCount = m_buildingRenderer.GetVisibleCount() + m_buildingRenderer.GetCulledCount();
+		ImGui::Text("Hidden by terrain: %u (%.1f%%)", m_buildingRenderer.GetOccludedCount(),
+								placedCount > 0 ? 100.0f * m_buildingRenderer.GetOccludedCount() / placedCount : 0.0f);
+
+		if (ImGui::Button("Undo (Ctrl+Z)"))
+			UndoEdit();
+		ImGui::SameLine();
+		if (ImGui::Button("Redo (Ctrl+Y)"))
+			RedoEdit();
+		if (ImGui::SliderInt("History size", &m_terrainJournalMaxEdits, 1, 1024))
+			m_terrainJournal.SetLimits(m_terrainJournalMaxEdits, TERRAIN_JOURNAL_MAX_BYTES);
+		ImGui::Text("History: %d edits, %.1f KB", static_cast<int>(m_terrainJournal.GetUndoCount() + m_terrainJournal.GetRedoCount()),
+								m_terrainJournal.GetMemoryUsage() / 1024.0f);
+	}
+	ImGui::End();
+
+	if (ImGui::Begin("Terrain"))
+	{
+		ImGui::InputScalar("Seed", ImGuiDataType_U32, &m_worldSeed);
+		ImGui::Checkbox("Generate on GPU", &m_generateTerrainOnGPU);
+
+		bool randomSeed = ImGui::Button("Random seed");
+		ImGui::SameLine();
+		bool regenerate = ImGui::Button("Regenerate terrain");
+		if (randomSeed || regenerate)
+		{
+			if (randomSeed)
+				m_worldSeed = static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count());
+			m_cacheTerrain = regenerate;
+
+			// Placed buildings belong to the old ground, so they go with it
+			m_buildings.Clear();
+			m_buildingRenderer.Clear();
+			m_buildingGrid.Clear();
+			m_buildingBvh.Clear();
+			m_objectIdsStale = true;
+			m_selectedBuildings.clear();
+			m_hoveredBuilding = BuildingRegistry::INVALID_ID;
+			if (ObjectIdBuffer::IsBuilding(m_selectedObject))
+				m_selectedObject = ObjectIdBuffer::NO_OBJECT;
+			m_terrainJournal.Clear();
+
+			// Regenerate means generate, the cached copy is replaced instead of loaded
+			GenerateTerrainMaps(!regenerate);
+		}
+		ImGui::Text("Last generation: %.1f ms", m_terrainGenerationTimeMs);
+		const char *renderModes[] = {"Chunked (CDLOD)", "Tessellated"};
+		int renderMode = static_cast<int>(m_terrainRenderMode);
+		if (ImGui::Combo("Render mode", &renderMode, renderModes, IM_ARRAYSIZE(renderModes)))
+			m_terrainRenderMode = static_cast<TerrainRenderMode>(renderMode);
+
+		if (m_terrainRenderMode == TerrainRenderMode::Chunked)
+		{
+			ImGui::SliderFloat("LOD distance", &m_terrainLodDistance, 2.0f, 40.0f);
+			ImGui::Text("Terrain patches: %d drawn, %d culled", static_cast<int>(m_terrainPatches.size()), m_terrainQuadtree.GetCulledCount());
+		}
+		else
+		{
+			ImGui::SliderFloat("Target edge (px)", &m_terrainTessEdgePixels, 2.0f, 64.0f);
+		}
+		ImGui::Text("Terrain GPU time: %.2f ms", m_terrainTimer.GetLastMs());
+		ImGui::Text("Texture uploads last frame: %d (%.1f KB)", m_terrain.GetUploadCount(), m_terrain.GetUploadedBytes() / 1024.0f);
+	}
+	ImGui::End();
+
+	if (ImGui::Begin("Benchmarks"))
+	{
+		if (ImGui::Button("Perlin noise"))
+		{
+			m_benchmarkResults = BenchmarkPerlinNoise();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Terrain rendering") && m_terrainBenchmarkFrame < 0)
+		{
+			StartTerrainBenchmark();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Building grid"))
+		{
+			m_benchmarkResults = BenchmarkBuildingGrid();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Building BVH"))
+		{
+			m_benchmarkResults = BenchmarkBuildingBvh();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Building registry"))
+		{
+			m_benchmarkResults = BenchmarkBuildingRegistry();
+		}
+
+		if (m_terrainBenchmarkFrame >= 0)
+			ImGui::Text("Measuring terrain rendering...");
+
+		for (const BenchmarkResult &result : m_benchmarkResults)
+		{
+			ImGui::Text("%s", FormatBenchmarkResult(result).c_str());
+		}
 	}
 	ImGui::End();
 }
@@ -850,6 +1401,8 @@ void CMyApp::KeyboardDown(const SDL_KeyboardEvent &key)
 			CleanShaders();
 			InitShaders();
 		}
+		if (key.keysym.sym == SDLK_F12)
+			m_screenshotRequested = true;
 		if (key.keysym.sym == SDLK_F1)
 		{
 			GLint polygonModeFrontAndBack[2] = {};
@@ -860,6 +1413,37 @@ void CMyApp::KeyboardDown(const SDL_KeyboardEvent &key)
 			glPolygonMode(GL_FRONT_AND_BACK, polygonMode); // Set the new mode
 		}
 	}
+	if (key.keysym.mod & KMOD_CTRL)
+	{
+		if (key.keysym.sym == SDLK_z)
+			UndoEdit();
+		if (key.keysym.sym == SDLK_y)
+			RedoEdit();
+	}
+	if (key.keysym.sym == SDLK_RETURN && !(key.keysym.mod & KMOD_ALT) && m_zoneCorners.size() >= 3)
+	{
+		// The polygon selects the buildings whose center it holds instead of filling
+		if (key.keysym.mod & KMOD_SHIFT)
+		{
+			m_selectedBuildings.clear();
+			m_buildingBvh.QueryZone({m_zoneCorners}, m_selectedBuildings);
+			m_selectedObject = ObjectIdBuffer::NO_OBJECT;
+		}
+		else
+		{
+			FillZone({m_zoneCorners});
+		}
+		m_zoneCorners.clear();
+	}
+	if (key.keysym.sym == SDLK_BACKSPACE && !m_zoneCorners.empty())
+		m_zoneCorners.pop_back();
+	if (key.keysym.sym == SDLK_DELETE)
+	{
+		if (!m_selectedBuildings.empty())
+			DemolishSelectedBuildings();
+		else if (ObjectIdBuffer::IsBuilding(m_selectedObject))
+			DemolishBuilding(ObjectIdBuffer::GetBuildingId(m_selectedObject));
+	}
 	m_cameraManipulator.KeyboardDown(key);
 }
 
@@ -872,72 +1456,233 @@ void CMyApp::KeyboardUp(const SDL_KeyboardEvent &key)
 
 void CMyApp::MouseMove(const SDL_MouseMotionEvent &mouse)
 {
-	m_cameraManipulator.MouseMove(mouse);
+	// The camera stays put while a zone or a selection is dragged
+	if (!m_zoneDragging && !m_areaSelecting)
+		m_cameraManipulator.MouseMove(mouse);
 
-	int viewportWidth, viewportHeight;
-	GetViewportSize(viewportWidth, viewportHeight);
+	// Picked in the next Render, however many motion events arrive until then
+	m_cursor = glm::ivec2(mouse.x, mouse.y);
+	m_cursorMoved = true;
+}
+
+// https://wiki.libsdl.org/SDL2/SDL_MouseButtonEvent
 
-	// Read from FBO for building preview
-	glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
-	glReadPixels(mouse.x, viewportHeight - mouse.y - 1, 1, 1, GL_RGB, GL_FLOAT, m_pickData);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void CMyApp::MouseDown(const SDL_MouseButtonEvent &mouse)
+{
+	// A click may come before the frame that would pick its position
+	m_cursor = glm::ivec2(mouse.x, mouse.y);
+	m_cursorMoved = true;
+	UpdatePick();
 
-	if (m_pickData->z < 0.1f)
+	// Selection waits for the release, a press that turns into a drag turns the camera instead
+	if (mouse.button == SDL_BUTTON_LEFT && !(SDL_GetModState() & (KMOD_ALT | KMOD_CTRL | KMOD_SHIFT)))
 	{
-		float u = m_pickData->x;
-		float v = m_pickData->y;
+		m_selectPressCursor = m_cursor;
+		return;
+	}
 
-		// Convert UV to world coordinates (terrain spans -50 to 50 on X and Z)
-		glm::vec3 worldPos(
-				(u * 100.0f) - 50.0f, // X: [0,1] -> [-50,50]
-				0.0f,									// Temporary Y, will be set properly
-				(v * 100.0f) - 50.0f	// Z: [0,1] -> [-50,50]
-		);
+	// A click demolishes whichever building covers the pixel, a drag over the ground selects an area
+	if (mouse.button == SDL_BUTTON_LEFT && (SDL_GetModState() & KMOD_SHIFT))
+	{
+		if (m_cursorOnTerrain)
+		{
+			m_areaSelecting = true;
+			m_areaSelectStartCursor = m_cursor;
+			m_areaSelectStart = m_cursorTerrainPosition;
+		}
+		else
+		{
+			PickObject(m_cursor, ObjectPickAction::Demolish);
+		}
+		return;
+	}
+
+	if (!m_cursorOnTerrain)
+		return;
 
-		UpdateBuildingPreview(worldPos);
+	// Zone fill
+	if (SDL_GetModState() & KMOD_ALT)
+	{
+		if (mouse.button == SDL_BUTTON_LEFT)
+		{
+			m_zoneDragging = true;
+			m_zoneDragStart = m_cursorTerrainPosition;
+			m_zoneCorners.clear();
+		}
+		else if (mouse.button == SDL_BUTTON_RIGHT)
+		{
+			m_zoneCorners.push_back(m_cursorTerrainPosition);
+		}
+		return;
 	}
-	else if (!(SDL_GetModState() & KMOD_CTRL))
+
+	if (mouse.button == SDL_BUTTON_LEFT && (SDL_GetModState() & KMOD_CTRL))
 	{
-		m_showBuildingPreview = false;
+		// Place building with proper height
+		PlaceBuilding(m_cursorTerrainHit);
 	}
 }
 
-// https://wiki.libsdl.org/SDL2/SDL_MouseButtonEvent
-
-void CMyApp::MouseDown(const SDL_MouseButtonEvent &mouse)
+void CMyApp::MouseUp(const SDL_MouseButtonEvent &mouse)
 {
-	if (mouse.button == SDL_BUTTON_LEFT && (SDL_GetModState() & KMOD_CTRL))
+	if (mouse.button != SDL_BUTTON_LEFT)
+		return;
+
+	m_cursor = glm::ivec2(mouse.x, mouse.y);
+	m_cursorMoved = true;
+
+	if (m_selectPressCursor.x >= 0)
 	{
-		int viewportWidth, viewportHeight;
-		GetViewportSize(viewportWidth, viewportHeight);
+		glm::ivec2 distance = glm::abs(m_cursor - m_selectPressCursor);
+		if (distance.x <= SELECT_CLICK_TOLERANCE && distance.y <= SELECT_CLICK_TOLERANCE)
+			PickObject(m_cursor, ObjectPickAction::Select);
+		m_selectPressCursor = glm::ivec2(-1);
+	}
 
-		// Read from FBO
-		glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
-		glReadPixels(mouse.x, viewportHeight - mouse.y - 1, 1, 1,
-								 GL_RGB, GL_FLOAT, m_pickData);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (m_areaSelecting)
+	{
+		UpdatePick();
+		m_areaSelecting = false;
 
-		// If we hit terrain (z coordinate is 0 in our pick shader)
-		if (m_pickData->z < 0.1f)
+		// Every building whose box reaches into the rectangle, at any height
+		glm::ivec2 distance = glm::abs(m_cursor - m_areaSelectStartCursor);
+		if (distance.x <= SELECT_CLICK_TOLERANCE && distance.y <= SELECT_CLICK_TOLERANCE)
+		{
+			PickObject(m_cursor, ObjectPickAction::Demolish);
+		}
+		else if (m_cursorOnTerrain)
 		{
-			float u = m_pickData->x;
-			float v = m_pickData->y;
-
-			// Convert UV to world coordinates (match terrain scale)
-			glm::vec3 worldPos(
-					(u - 0.5f) * 100.0f, // X coordinate
-					0.0f,								 // Temporary Y, will be set properly
-					(v - 0.5f) * 100.0f	 // Z coordinate
-			);
-
-			// Place building with proper height
-			PlaceBuilding(worldPos);
+			glm::vec2 min = glm::min(m_areaSelectStart, m_cursorTerrainPosition);
+			glm::vec2 max = glm::max(m_areaSelectStart, m_cursorTerrainPosition);
+			m_selectedBuildings.clear();
+			m_buildingBvh.QueryBox(glm::vec3(min.x, -INFINITY, min.y), glm::vec3(max.x, INFINITY, max.y), m_selectedBuildings);
+			m_selectedObject = ObjectIdBuffer::NO_OBJECT;
 		}
+		return;
 	}
+
+	if (!m_zoneDragging)
+		return;
+
+	UpdatePick();
+
+	m_zoneDragging = false;
+	if (m_cursorTerrainPosition.x != m_zoneDragStart.x && m_cursorTerrainPosition.y != m_zoneDragStart.y)
+		FillZone(BuildingZone::FromRectangle(m_zoneDragStart, m_cursorTerrainPosition));
 }
 
-void CMyApp::MouseUp(const SDL_MouseButtonEvent &mouse)
+bool CMyApp::AreObjectIdsCurrent() const
+{
+	return m_objectIds.HasValues() && !m_objectIdsInFlight && !m_objectIdsStale && m_objectIdViewProj == m_camera.GetViewProj();
+}
+
+void CMyApp::PickObject(const glm::ivec2 &cursor, ObjectPickAction action)
+{
+	if (AreObjectIdsCurrent())
+		HandleObjectPick({cursor, action});
+	else
+		m_pendingObjectPicks.push_back({cursor, action});
+}
+
+void CMyApp::RenderObjectIds()
 {
+	// Buildings added since the last frame have to be on the GPU
+	m_buildingRenderer.Upload();
+	m_objectIdViewProj = m_camera.GetViewProj();
+	m_objectIdsStale = false;
+
+	m_objectIds.BeginPass();
+	glUseProgram(m_terrainPickProgram);
+	DrawTerrainDepth();
+	glUseProgram(m_buildingPickProgram);
+	glUniformMatrix4fv(ul("viewProj"), 1, GL_FALSE, glm::value_ptr(m_objectIdViewProj));
+	m_buildingRenderer.DrawIds();
+	glUseProgram(0);
+	m_objectIds.EndPass();
+	++m_objectIdPassCount;
+
+	// The clicks so far are answered by this pass, later ones by its copy if that still shows their view
+	m_objectIdsInFlight = true;
+	std::vector<ObjectPick> picks = std::move(m_pendingObjectPicks);
+	m_pendingObjectPicks.clear();
+	m_objectIds.ReadBack(m_gpuReadback, [this, picks]()
+											 {
+		m_objectIdsInFlight = false;
+
+		// Buildings or terrain changed while the copy was on its way, its IDs may name what is gone or a
+		// recycled ID. Clicks on a view that is still shown wait for the next pass, the rest are dropped
+		if (m_objectIdsStale)
+		{
+			if (m_objectIdViewProj == m_camera.GetViewProj())
+				m_pendingObjectPicks.insert(m_pendingObjectPicks.begin(), picks.begin(), picks.end());
+			return;
+		}
+
+		for (const ObjectPick &pick : picks)
+			HandleObjectPick(pick); });
+}
+
+void CMyApp::HandleObjectPick(const ObjectPick &pick)
+{
+	uint32_t object = m_objectIds.GetObject(pick.cursor);
+	if (ObjectIdBuffer::IsBuilding(object) && !m_buildings.Contains(ObjectIdBuffer::GetBuildingId(object)))
+		return;
+
+	if (pick.action == ObjectPickAction::Select)
+	{
+		m_selectedObject = object;
+		m_selectedBuildings.clear();
+	}
+	else if (pick.action == ObjectPickAction::Demolish && ObjectIdBuffer::IsBuilding(object))
+	{
+		DemolishBuilding(ObjectIdBuffer::GetBuildingId(object));
+	}
+}
+
+void CMyApp::GetCursorRay(const glm::ivec2 &cursor, glm::vec3 &origin, glm::vec3 &direction)
+{
+	int viewportWidth, viewportHeight;
+	GetViewportSize(viewportWidth, viewportHeight);
+
+	// Window to normalized device coordinates at the pixel's center, then back through the camera
+	glm::vec2 ndc((cursor.x + 0.5f) / viewportWidth * 2.0f - 1.0f, 1.0f - (cursor.y + 0.5f) / viewportHeight * 2.0f);
+	glm::mat4 inverseViewProj = glm::inverse(m_camera.GetViewProj());
+	glm::vec4 nearPoint = inverseViewProj * glm::vec4(ndc, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProj * glm::vec4(ndc, 1.0f, 1.0f);
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	direction = glm::vec3(farPoint) / farPoint.w - origin;
+}
+
+void CMyApp::UpdatePick()
+{
+	// Terrain edits and building changes set m_cursorMoved as well
+	if (!m_cursorMoved && m_camera.GetViewProj() == m_pickViewProj)
+		return;
+	m_cursorMoved = false;
+	m_pickViewProj = m_camera.GetViewProj();
+
+	auto pickStart = std::chrono::steady_clock::now();
+	glm::vec3 origin, direction;
+	GetCursorRay(m_cursor, origin, direction);
+	m_cursorOnTerrain = !m_terrainMapsPending && m_terrainHeightPyramid.Raycast(m_terrain, GetTerrainMapping(), origin, direction, m_cursorTerrainHit);
+
+	// Buildings behind the ground are hidden, in front of the far plane otherwise
+	float terrainT = m_cursorOnTerrain ? glm::dot(m_cursorTerrainHit - origin, direction) / glm::dot(direction, direction) : 1.0f;
+	float buildingT;
+	if (!m_buildingBvh.Raycast(origin, direction, terrainT, m_hoveredBuilding, buildingT))
+		m_hoveredBuilding = BuildingRegistry::INVALID_ID;
+	std::chrono::duration<float, std::micro> pickTime = std::chrono::steady_clock::now() - pickStart;
+	m_pickTimeUs = pickTime.count();
+
+	if (m_cursorOnTerrain)
+	{
+		m_cursorTerrainPosition = glm::vec2(m_cursorTerrainHit.x, m_cursorTerrainHit.z);
+		UpdateBuildingPreview(m_cursorTerrainHit);
+	}
+	else if (!(SDL_GetModState() & KMOD_CTRL))
+	{
+		m_showBuildingPreview = false;
+	}
 }
 
 // https://wiki.libsdl.org/SDL2/SDL_MouseWheelEvent
@@ -952,7 +1697,8 @@ void CMyApp::Resize(int _w, int _h)
 {
 	glViewport(0, 0, _w, _h);
 	m_camera.SetAspect(static_cast<float>(_w) / _h);
-	CreateFrameBuffer(_w, _h);
+	m_terrainHiZ.Resize(_w, _h);
+	m_objectIds.Resize(_w, _h);
 }
 
 // Handling unprocessed, uncommon events
@@ -962,6 +1708,30 @@ void CMyApp::OtherEvent(const SDL_Event &ev)
 {
 }
 
+void CMyApp::TakeScreenshot()
+{
+	int width, height;
+	GetViewportSize(width, height);
+
+	// Written to disk when the pixels arrive, the frame goes on without waiting for them
+	m_gpuReadback.ReadPixels(0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<std::size_t>(width) * height * 4,
+													 [width, height](const void *data, std::size_t size)
+													 {
+		// GL rows go bottom up
+		std::vector<unsigned char> pixels(size);
+		const std::size_t rowBytes = static_cast<std::size_t>(width) * 4;
+		for (int y = 0; y < height; ++y)
+			std::memcpy(pixels.data() + y * rowBytes, static_cast<const unsigned char *>(data) + (height - 1 - y) * rowBytes, rowBytes);
+
+		std::string path = "Screenshot_" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + ".bmp";
+		SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels.data(), width, height, 32, static_cast<int>(rowBytes), SDL_PIXELFORMAT_ABGR8888);
+		if (surface == nullptr || SDL_SaveBMP(surface, path.c_str()) != 0)
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "Cannot save screenshot %s: %s", path.c_str(), SDL_GetError());
+		else
+			SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Saved screenshot %s", path.c_str());
+		SDL_FreeSurface(surface); });
+}
+
 void CMyApp::GetViewportSize(int &width, int &height)
 {
 	GLint viewport[4];
@@ -1107,208 +1877,591 @@ float CMyApp::smoothstep(float edge0, float edge1, float x)
 	return x * x * (3.0f - 2.0f * x);
 }
 
-void CMyApp::CreateFrameBuffer(int width, int height)
+float CMyApp::SampleHeightmap(const glm::vec2 &uv)
 {
-	// Clean up if this function is not being called for the first time
-	if (m_frameBufferCreated)
-	{
-		glDeleteRenderbuffers(1, &m_depthBuffer);
-		glDeleteTextures(1, &m_colorBuffer);
-		glDeleteFramebuffers(1, &m_frameBuffer);
-	}
+	// Apply terrain scaling and offset
+	return (m_terrain.SampleHeight(uv) * m_terrainHeightScale) + m_terrainVerticalOffset - 25;
+}
 
-	glGenFramebuffers(1, &m_frameBuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+void CMyApp::UpdateBuildingPreview(const glm::vec3 &pos)
+{
+	// Calculate UV coordinates from world position
+	glm::vec2 uv(
+			(pos.x + 50.0f) / 100.0f, // Convert from [-50,50] to [0,1]
+			(pos.z + 50.0f) / 100.0f	// Convert from [-50,50] to [0,1]
+	);
 
-	glGenTextures(1, &m_colorBuffer);
-	glBindTexture(GL_TEXTURE_2D, m_colorBuffer);
+	// Sample height from heightmap
+	float height = SampleHeightmap(uv);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// Only show preview where PlaceBuilding would accept the ground
+	m_showBuildingPreview = BuildingPlacementRules::IsGroundSuitable(m_terrain, GetPlacementRules(), m_selectedBuildingType, glm::vec2(pos.x, pos.z));
 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorBuffer, 0);
-	if (glGetError() != GL_NO_ERROR)
+	if (m_showBuildingPreview)
 	{
-		std::cout << "Error creating color attachment" << std::endl;
-		exit(1);
+		m_buildingPreviewPos = glm::vec3(pos.x, height, pos.z);
+
+		// Check for collisions using building dimensions
+		if (CollidesWithBuildings(pos, m_selectedBuildingType))
+		{
+			m_showBuildingPreview = false;
+		}
 	}
+}
+
+void CMyApp::PlaceBuilding(const glm::vec3 &pos)
+{
+	if (m_terrainMapsPending)
+		return;
 
-	glGenRenderbuffers(1, &m_depthBuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
-	if (glGetError() != GL_NO_ERROR)
+	// Get building dimensions based on type
+	glm::vec2 buildingSize = Buildings::GetBuildingSize(m_selectedBuildingType);
+
+	// Check for collisions with existing buildings
+	if (CollidesWithBuildings(pos, m_selectedBuildingType))
 	{
-		std::cout << "Error creating depth attachment" << std::endl;
-		exit(1);
+		return; // Don't place if collision detected
 	}
 
-	// -- Completeness check
-	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	if (status != GL_FRAMEBUFFER_COMPLETE)
+	// The same map edge, water and slope rules as PlaceBuildings, before any terrain is touched
+	if (!BuildingPlacementRules::IsGroundSuitable(m_terrain, GetPlacementRules(), m_selectedBuildingType, glm::vec2(pos.x, pos.z)))
+		return;
+
+	// Calculate UV coordinates from world position
+	glm::vec2 uv(
+			(pos.x + 50.0f) / 100.0f,
+			(pos.z + 50.0f) / 100.0f);
+
+	m_terrainJournal.BeginEdit();
+
+	// Apply concrete texture around the building
+	std::vector<glm::vec4> originalSplat;
+	TerrainRect concreteRect = ApplyConcreteTexture(uv, m_selectedBuildingType, originalSplat);
+	m_terrainJournal.AddSplat(m_terrain, concreteRect, originalSplat.data());
+
+	// Sample height from heightmap and smooth the terrain
+	TerrainRect flattenedRect;
+	std::vector<float> originalHeights;
+	float height = SmoothTerrainUnderBuilding(uv, buildingSize, flattenedRect, originalHeights);
+	m_terrainJournal.AddHeights(m_terrain, flattenedRect, originalHeights.data());
+
+	// Register the new building at the correct height
+	glm::vec3 position(pos.x, height, pos.z);
+	uint32_t id = AddBuilding(m_selectedBuildingType, position, m_buildingColor);
+	m_buildings.SetTerrainBackup(id, flattenedRect, originalHeights.data(), concreteRect, originalSplat.data());
+
+	m_terrainJournal.AddBuildingChange({BuildingChange::Kind::Placed, id, m_selectedBuildingType, position, m_buildingColor,
+																			 buildingSize, flattenedRect, concreteRect});
+	m_terrainJournal.CommitEdit();
+}
+
+std::size_t CMyApp::PlaceBuildings(const std::vector<BuildingPlacement> &candidates)
+{
+	if (m_terrainMapsPending)
+		return 0;
+
+	auto startTime = std::chrono::steady_clock::now();
+	const PlacementRules rules = GetPlacementRules();
+	const BuildingType typeCount = Buildings::GetTypeCount();
+
+	// What every candidate would do on its own, in parallel: the ground and the buildings already placed decide
+	// whether it fits, and like PlaceBuilding it takes the height of a building nearby or flattens the ground
+	std::vector<PlacementEvaluation> evaluations(candidates.size());
+	m_threadPool.ParallelFor(static_cast<int>(candidates.size()), PLACEMENTS_PER_JOB, [&](int begin, int end)
+													 {
+		for (int i = begin; i < end; ++i)
+		{
+			const BuildingPlacement &candidate = candidates[i];
+			PlacementEvaluation &evaluation = evaluations[i];
+			evaluation.valid = candidate.type < typeCount &&
+												 BuildingPlacementRules::IsGroundSuitable(m_terrain, rules, candidate.type, candidate.position) &&
+												 !CollidesWithBuildings(glm::vec3(candidate.position.x, 0.0f, candidate.position.y), candidate.type);
+			if (!evaluation.valid)
+				continue;
+
+			glm::vec2 uv = BuildingPlacementRules::ToUV(rules, candidate.position);
+			evaluation.heightRect = GetFlattenRect(uv, Buildings::GetBuildingSize(candidate.type));
+			evaluation.splatRect = GetConcreteRect(uv, candidate.type);
+
+			uint32_t closestBuilding;
+			evaluation.flatten = !m_buildingGrid.FindNearest(candidate.position, BUILDING_HEIGHT_MATCH_DISTANCE, closestBuilding);
+			if (evaluation.flatten)
+			{
+				evaluation.flatHeight = GetFlattenedHeight(evaluation.heightRect);
+				evaluation.height = std::max(BuildingPlacementRules::ToWorldHeight(rules, evaluation.flatHeight), WATER_LEVEL);
+			}
+			else
+			{
+				evaluation.height = std::max(m_buildings.GetPositions()[m_buildings.GetIndex(closestBuilding)].y, WATER_LEVEL);
+			}
+		} });
+
+	// In input order, a candidate loses against the earlier ones it collides with. Flattened areas of the batch
+	// never overlap, so they can be written in parallel and each one's original heights are those of the map now
+	BuildingGrid batchGrid;
+	BuildingGrid flattenGrid;
+	batchGrid.Create(glm::vec2(-50.0f), glm::vec2(50.0f), BUILDING_GRID_CELL_SIZE);
+	flattenGrid.Create(glm::vec2(-50.0f), glm::vec2(50.0f), BUILDING_GRID_CELL_SIZE);
+	const float texelSize = 100.0f / (m_terrain.GetSize() - 1);
+
+	std::vector<uint32_t> accepted;
+	for (uint32_t i = 0; i < candidates.size(); ++i)
 	{
-		std::cout << "Incomplete framebuffer (";
-		switch (status)
+		const BuildingPlacement &candidate = candidates[i];
+		PlacementEvaluation &evaluation = evaluations[i];
+		if (!evaluation.valid)
+			continue;
+
+		glm::vec2 footprint = Buildings::GetBuildingSize(candidate.type);
+		glm::vec2 halfSize = footprint * 0.5f + BUILDING_PADDING;
+		if (batchGrid.Overlaps(candidate.position - halfSize, candidate.position + halfSize))
+			continue;
+
+		uint32_t closestCandidate;
+		if (evaluation.flatten && batchGrid.FindNearest(candidate.position, BUILDING_HEIGHT_MATCH_DISTANCE, closestCandidate))
 		{
-		case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
-			std::cout << "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
-			break;
-		case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
-			std::cout << "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
-			break;
-		case GL_FRAMEBUFFER_UNSUPPORTED:
-			std::cout << "GL_FRAMEBUFFER_UNSUPPORTED";
-			break;
+			evaluation.flatten = false;
+			evaluation.height = evaluations[closestCandidate].height;
 		}
-		std::cout << ")" << std::endl;
-		char ch;
-		std::cin >> ch;
-		exit(1);
+		else if (evaluation.flatten)
+		{
+			const TerrainRect &rect = evaluation.heightRect;
+			glm::vec2 flattenMin = glm::vec2(rect.minX, rect.minY) * texelSize - 50.0f;
+			glm::vec2 flattenMax = glm::vec2(rect.maxX, rect.maxY) * texelSize - 50.0f;
+			if (flattenGrid.Overlaps(flattenMin, flattenMax))
+				continue;
+			flattenGrid.Insert(i, (flattenMin + flattenMax) * 0.5f, flattenMax - flattenMin);
+		}
+
+		batchGrid.Insert(i, candidate.position, footprint);
+		accepted.push_back(i);
 	}
 
-	// -- Unbind framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	m_frameBufferCreated = true;
-}
+	if (accepted.empty())
+		return 0;
 
-float CMyApp::SampleHeightmap(const glm::vec2 &uv)
-{
-	// Clamp UV coordinates to avoid edge artifacts
-	glm::vec2 clampedUV = glm::clamp(uv, 0.0f, 1.0f);
+	// One rectangle of each map covers the whole batch, for the journal and the texture upload
+	TerrainRect heightBounds;
+	TerrainRect splatBounds;
+	for (uint32_t i : accepted)
+	{
+		if (evaluations[i].flatten)
+			GrowRect(heightBounds, evaluations[i].heightRect);
+		GrowRect(splatBounds, evaluations[i].splatRect);
+	}
 
-	// Bind heightmap texture
-	glBindTexture(GL_TEXTURE_2D, m_heightmapTexture);
+	// Each band of rows is copied for the journal and then written by one job. Concrete areas overlap, a texel gets
+	// painted once per building covering it, as often as placing the buildings one by one would have painted it
+	std::vector<float> heightsBefore(heightBounds.GetWidth() * heightBounds.GetHeight());
+	std::vector<glm::vec4> splatBefore(splatBounds.GetWidth() * splatBounds.GetHeight());
+	TerrainRect bounds = splatBounds;
+	GrowRect(bounds, heightBounds);
+	const int bandCount = (bounds.GetHeight() + PLACEMENT_BAND_ROWS - 1) / PLACEMENT_BAND_ROWS;
+	std::vector<std::vector<uint32_t>> bands(bandCount);
+	for (uint32_t i : accepted)
+	{
+		TerrainRect rect = evaluations[i].splatRect;
+		if (evaluations[i].flatten)
+			GrowRect(rect, evaluations[i].heightRect);
+		int lastBand = (rect.maxY - 1 - bounds.minY) / PLACEMENT_BAND_ROWS;
+		for (int band = (rect.minY - bounds.minY) / PLACEMENT_BAND_ROWS; band <= lastBand; ++band)
+			bands[band].push_back(i);
+	}
 
-	// Get texture dimensions
-	GLint width, height;
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	float *heights = m_terrain.GetHeightData();
+	glm::vec4 *splat = m_terrain.GetSplatData();
+	const int mapSize = m_terrain.GetSize();
+	m_threadPool.ParallelFor(bandCount, 1, [&](int begin, int end)
+													 {
+		std::vector<uint8_t> paintCounts;
+		for (int band = begin; band < end; ++band)
+		{
+			int minY = bounds.minY + band * PLACEMENT_BAND_ROWS;
+			int maxY = std::min(minY + PLACEMENT_BAND_ROWS, bounds.maxY);
+			paintCounts.assign((maxY - minY) * bounds.GetWidth(), 0);
 
-	// Calculate exact texture coordinates
-	float x = clampedUV.x * (width - 1);
-	float y = clampedUV.y * (height - 1);
+			for (int y = std::max(minY, heightBounds.minY); y < std::min(maxY, heightBounds.maxY); ++y)
+			{
+				std::copy_n(heights + y * mapSize + heightBounds.minX, heightBounds.GetWidth(),
+										heightsBefore.data() + (y - heightBounds.minY) * heightBounds.GetWidth());
+			}
+			for (int y = std::max(minY, splatBounds.minY); y < std::min(maxY, splatBounds.maxY); ++y)
+			{
+				std::copy_n(splat + y * mapSize + splatBounds.minX, splatBounds.GetWidth(),
+										splatBefore.data() + (y - splatBounds.minY) * splatBounds.GetWidth());
+			}
 
-	// Read single pixel from heightmap
-	float pixelValue;
-	glGetTextureSubImage(m_heightmapTexture, 0,
-											 static_cast<int>(x), static_cast<int>(y), 0,
-											 1, 1, 1,
-											 GL_RED, GL_FLOAT,
-											 sizeof(float), &pixelValue);
+			for (uint32_t i : bands[band])
+			{
+				const PlacementEvaluation &evaluation = evaluations[i];
+				const TerrainRect &heightRect = evaluation.heightRect;
+				for (int y = std::max(minY, heightRect.minY); evaluation.flatten && y < std::min(maxY, heightRect.maxY); ++y)
+					std::fill_n(heights + y * mapSize + heightRect.minX, heightRect.GetWidth(), evaluation.flatHeight);
+
+				const TerrainRect &splatRect = evaluation.splatRect;
+				for (int y = std::max(minY, splatRect.minY); y < std::min(maxY, splatRect.maxY); ++y)
+				{
+					uint8_t *counts = paintCounts.data() + (y - minY) * bounds.GetWidth() - bounds.minX;
+					for (int x = splatRect.minX; x < splatRect.maxX; ++x)
+						++counts[x];
+				}
+			}
 
-	// Apply terrain scaling and offset
-	return (pixelValue * m_terrainHeightScale) + m_terrainVerticalOffset - 25;
+			for (int y = minY; y < maxY; ++y)
+			{
+				const uint8_t *counts = paintCounts.data() + (y - minY) * bounds.GetWidth() - bounds.minX;
+				for (int x = bounds.minX; x < bounds.maxX; ++x)
+				{
+					for (uint8_t n = 0; n < counts[x]; ++n)
+						PaintConcrete(splat[y * mapSize + x]);
+				}
+			}
+		} });
+
+	m_terrain.MarkHeightsDirty(heightBounds);
+	m_terrain.MarkSplatDirty(splatBounds);
+
+	// A single edit, so one undo takes the whole batch back
+	m_terrainJournal.BeginEdit();
+	m_terrainJournal.AddHeights(m_terrain, heightBounds, heightsBefore.data(), m_threadPool);
+	m_terrainJournal.AddSplat(m_terrain, splatBounds, splatBefore.data(), m_threadPool);
+
+	// Like a building placed on its own, a splat backup holds the concrete of the buildings accepted before it:
+	// the ground from before the batch, painted once for every earlier building covering the texel. Flattened
+	// areas are disjoint, so the heights need no such care
+	std::vector<uint8_t> splatPaintCounts(splatBounds.GetWidth() * splatBounds.GetHeight(), 0);
+	std::vector<float> originalHeights;
+	std::vector<glm::vec4> originalSplat;
+	for (uint32_t i : accepted)
+	{
+		const BuildingPlacement &candidate = candidates[i];
+		const PlacementEvaluation &evaluation = evaluations[i];
+		TerrainRect heightRect = evaluation.flatten ? evaluation.heightRect : TerrainRect();
+		CopySubRect(heightsBefore, heightBounds, heightRect, originalHeights);
+		CopySubRect(splatBefore, splatBounds, evaluation.splatRect, originalSplat);
+
+		const TerrainRect &splatRect = evaluation.splatRect;
+		for (int y = splatRect.minY; y < splatRect.maxY; ++y)
+		{
+			uint8_t *counts = splatPaintCounts.data() + (y - splatBounds.minY) * splatBounds.GetWidth() - splatBounds.minX;
+			glm::vec4 *original = originalSplat.data() + (y - splatRect.minY) * splatRect.GetWidth() - splatRect.minX;
+			for (int x = splatRect.minX; x < splatRect.maxX; ++x)
+			{
+				for (uint8_t n = 0; n < counts[x]; ++n)
+					PaintConcrete(original[x]);
+				++counts[x];
+			}
+		}
+
+		glm::vec3 position(candidate.position.x, evaluation.height, candidate.position.y);
+		uint32_t id = AddBuilding(candidate.type, position, candidate.color);
+		m_buildings.SetTerrainBackup(id, heightRect, originalHeights.data(), evaluation.splatRect, originalSplat.data());
+		m_terrainJournal.AddBuildingChange({BuildingChange::Kind::Placed, id, candidate.type, position, candidate.color,
+																				 Buildings::GetBuildingSize(candidate.type), heightRect, evaluation.splatRect});
+	}
+	m_terrainJournal.CommitEdit();
+
+	std::chrono::duration<double, std::milli> placeTime = std::chrono::steady_clock::now() - startTime;
+	m_lastBulkPlacement = {candidates.size(), accepted.size(), placeTime.count()};
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Placed %d of %d buildings in %.1f ms", static_cast<int>(accepted.size()),
+							static_cast<int>(candidates.size()), placeTime.count());
+	return accepted.size();
 }
 
-void CMyApp::UpdateBuildingPreview(const glm::vec3 &pos)
+void CMyApp::ScatterBuildings(int count)
 {
-	// Calculate UV coordinates from world position
-	glm::vec2 uv(
-			(pos.x + 50.0f) / 100.0f, // Convert from [-50,50] to [0,1]
-			(pos.z + 50.0f) / 100.0f	// Convert from [-50,50] to [0,1]
-	);
+	// Random types and spots all over the map, for load tests of the bulk placement
+	std::mt19937 rng(m_worldSeed + static_cast<uint32_t>(m_buildings.GetCount()));
+	std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+	std::uniform_int_distribution<BuildingType> type(0, Buildings::GetTypeCount() - 1);
 
-	// Sample height from heightmap
-	float height = SampleHeightmap(uv);
+	std::vector<BuildingPlacement> candidates(count);
+	for (BuildingPlacement &candidate : candidates)
+	{
+		candidate.type = type(rng);
+		candidate.position = glm::vec2(coordinate(rng), coordinate(rng));
+		candidate.color = m_buildingColor;
+	}
+	PlaceBuildings(candidates);
+}
+
+void CMyApp::FillZone(const BuildingZone &zone)
+{
+	ZoneFillSettings settings;
+	if (m_zoneFillAllTypes)
+	{
+		for (BuildingType type = 0; type < Buildings::GetTypeCount(); ++type)
+			settings.types.push_back(type);
+	}
+	else
+	{
+		settings.types.push_back(m_selectedBuildingType);
+	}
+	settings.color = m_buildingColor;
+	settings.padding = BUILDING_PADDING;
+	settings.attempts = m_zoneFillAttempts;
+	settings.seed = m_worldSeed + static_cast<uint32_t>(m_buildings.GetCount());
+
+	auto startTime = std::chrono::steady_clock::now();
+	std::vector<BuildingPlacement> placements = ZoneFill::Sample(zone, m_terrain, GetPlacementRules(), m_buildingGrid, settings, m_threadPool);
+	std::chrono::duration<double, std::milli> samplingTime = std::chrono::steady_clock::now() - startTime;
+	m_lastZoneFill = {placements.size(), samplingTime.count()};
+
+	// The samples already keep their distance, PlaceBuildings flattens the ground and makes them one undoable edit
+	PlaceBuildings(placements);
+}
 
-	// Only show preview if above water
-	m_showBuildingPreview = (height >= WATER_LEVEL);
+void CMyApp::DrawZoneOutline()
+{
+	std::vector<glm::vec2> corners = m_zoneCorners;
+	if (m_zoneDragging)
+		corners = BuildingZone::FromRectangle(m_zoneDragStart, m_cursorTerrainPosition).corners;
+	else if (!corners.empty() && m_cursorOnTerrain)
+		corners.push_back(m_cursorTerrainPosition);
+	if (corners.empty())
+		return;
+
+	DrawGroundOutline(corners, IM_COL32(255, 220, 0, 255));
+}
 
-	if (m_showBuildingPreview)
+void CMyApp::DrawGroundOutline(const std::vector<glm::vec2> &corners, uint32_t color)
+{
+	int viewportWidth, viewportHeight;
+	GetViewportSize(viewportWidth, viewportHeight);
+
+	// Corners on the ground, projected to window pixels
+	std::vector<ImVec2> points;
+	for (const glm::vec2 &corner : corners)
 	{
-		m_buildingPreviewPos = glm::vec3(pos.x, height, pos.z);
+		glm::vec4 clip = m_camera.GetViewProj() * glm::vec4(corner.x, SampleHeightmap(corner / 100.0f + 0.5f), corner.y, 1.0f);
+		if (clip.w <= 0.0f)
+			return;
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		points.push_back(ImVec2((ndc.x * 0.5f + 0.5f) * viewportWidth, (0.5f - ndc.y * 0.5f) * viewportHeight));
+	}
 
-		// Check for collisions using building dimensions
-		glm::vec2 buildingSize = Buildings::GetBuildingSize(m_selectedBuildingType);
+	ImDrawList *drawList = ImGui::GetBackgroundDrawList();
+	drawList->AddPolyline(points.data(), static_cast<int>(points.size()), color, ImDrawFlags_Closed, 2.0f);
+}
 
-		// Create AABB for the new building
-		glm::vec2 newMin = glm::vec2(pos.x, pos.z) - buildingSize * 0.5f;
-		glm::vec2 newMax = glm::vec2(pos.x, pos.z) + buildingSize * 0.5f;
+void CMyApp::DrawBuildingOutline(uint32_t id, uint32_t color)
+{
+	// The box of the mesh, as the renderer places it
+	uint32_t index = m_buildings.GetIndex(id);
+	const BuildingData &data = Buildings::GetBuildingData(m_buildings.GetTypes()[index]);
+	const glm::vec3 &position = m_buildings.GetPositions()[index];
+	glm::vec2 center(position.x, position.z);
+	DrawGroundOutline(BuildingZone::FromRectangle(center + glm::vec2(data.boundsMin.x, data.boundsMin.z), center + glm::vec2(data.boundsMax.x, data.boundsMax.z)).corners, color);
+}
 
-		for (const auto &building : m_buildings)
-		{
-			// Get accurate size for existing building
-			glm::vec2 existingSize = Buildings::GetBuildingSize(m_selectedBuildingType);
+void CMyApp::RenderSelectionGUI()
+{
+	if (m_hoveredBuilding != BuildingRegistry::INVALID_ID && m_buildings.Contains(m_hoveredBuilding))
+		DrawBuildingOutline(m_hoveredBuilding, IM_COL32(255, 255, 255, 160));
+	if (m_areaSelecting && m_cursorOnTerrain)
+		DrawGroundOutline(BuildingZone::FromRectangle(m_areaSelectStart, m_cursorTerrainPosition).corners, IM_COL32(0, 200, 255, 255));
 
-			// Create AABB for existing building
-			glm::vec2 existingMin = glm::vec2(building.position.x, building.position.z) - existingSize * 0.5f;
-			glm::vec2 existingMax = glm::vec2(building.position.x, building.position.z) + existingSize * 0.5f;
+	if (!m_selectedBuildings.empty())
+	{
+		for (uint32_t id : m_selectedBuildings)
+			DrawBuildingOutline(id, IM_COL32(0, 200, 255, 255));
 
-			const float PADDING = 1.2f; // Small padding to prevent buildings from touching
+		if (ImGui::Begin("Selection"))
+		{
+			ImGui::Text("%d buildings selected", static_cast<int>(m_selectedBuildings.size()));
+			if (ImGui::Button("Demolish all (Delete)"))
+				DemolishSelectedBuildings();
+			if (ImGui::Button("Deselect"))
+				m_selectedBuildings.clear();
+		}
+		ImGui::End();
+		return;
+	}
 
-			bool collision = (newMin.x < existingMax.x + PADDING &&
-												newMax.x + PADDING > existingMin.x &&
-												newMin.y < existingMax.y + PADDING &&
-												newMax.y + PADDING > existingMin.y);
+	// The building may have gone without RemoveBuilding, with the whole registry
+	if (ObjectIdBuffer::IsBuilding(m_selectedObject) && !m_buildings.Contains(ObjectIdBuffer::GetBuildingId(m_selectedObject)))
+		m_selectedObject = ObjectIdBuffer::NO_OBJECT;
+	if (m_selectedObject == ObjectIdBuffer::NO_OBJECT)
+		return;
 
-			if (collision)
-			{
-				m_showBuildingPreview = false;
-				break;
-			}
+	if (ImGui::Begin("Selection"))
+	{
+		if (ObjectIdBuffer::IsBuilding(m_selectedObject))
+		{
+			uint32_t id = ObjectIdBuffer::GetBuildingId(m_selectedObject);
+			uint32_t index = m_buildings.GetIndex(id);
+			const glm::vec3 &position = m_buildings.GetPositions()[index];
+			const glm::vec3 &color = m_buildings.GetColors()[index];
+			const glm::vec2 &footprint = m_buildings.GetFootprints()[index];
+
+			ImGui::Text("Building %u: %s", id, Buildings::GetBuildingData(m_buildings.GetTypes()[index]).name.c_str());
+			ImGui::Text("Position: %.1f, %.1f, %.1f", position.x, position.y, position.z);
+			ImGui::Text("Footprint: %.1f x %.1f", footprint.x, footprint.y);
+			ImGui::Text("Color: %.2f, %.2f, %.2f", color.r, color.g, color.b);
+			DrawBuildingOutline(id, IM_COL32(0, 200, 255, 255));
+			if (ImGui::Button("Demolish (Delete)"))
+				DemolishBuilding(id);
+		}
+		else
+		{
+			glm::vec2 uv = ObjectIdBuffer::GetTerrainUV(m_selectedObject);
+			glm::vec2 position = (uv - 0.5f) * 100.0f;
+			ImGui::Text("Ground at %.1f, %.1f, height %.1f", position.x, position.y, SampleHeightmap(uv));
 		}
+		if (ImGui::Button("Deselect"))
+			m_selectedObject = ObjectIdBuffer::NO_OBJECT;
 	}
+	ImGui::End();
 }
 
-void CMyApp::PlaceBuilding(const glm::vec3 &pos)
+uint32_t CMyApp::AddBuilding(BuildingType type, const glm::vec3 &position, const glm::vec3 &color)
 {
-	// Get building dimensions based on type
-	glm::vec2 buildingSize = Buildings::GetBuildingSize(m_selectedBuildingType);
+	glm::vec2 footprint = Buildings::GetBuildingSize(type);
+	uint32_t id = m_buildings.Add(type, position, color, footprint);
+	m_buildingGrid.Insert(id, glm::vec2(position.x, position.z), footprint);
+	const BuildingData &data = Buildings::GetBuildingData(type);
+	m_buildingBvh.Insert(id, position + data.boundsMin, position + data.boundsMax);
+	m_buildingRenderer.Add(id, type, position, color);
+	m_objectIdsStale = true;
+	m_cursorMoved = true; // The building may be under the cursor
+	return id;
+}
 
-	// Create AABB for the new building
-	glm::vec2 newMin = glm::vec2(pos.x, pos.z) - buildingSize * 0.5f;
-	glm::vec2 newMax = glm::vec2(pos.x, pos.z) + buildingSize * 0.5f;
+void CMyApp::RemoveBuilding(uint32_t id)
+{
+	// The ID may come back for another building
+	if (m_selectedObject == (ObjectIdBuffer::BUILDING_BIT | id))
+		m_selectedObject = ObjectIdBuffer::NO_OBJECT;
+	if (!m_selectedBuildings.empty())
+		m_selectedBuildings.erase(std::remove(m_selectedBuildings.begin(), m_selectedBuildings.end(), id), m_selectedBuildings.end());
+	if (m_hoveredBuilding == id)
+		m_hoveredBuilding = BuildingRegistry::INVALID_ID;
+	m_objectIdsStale = true;
+	m_cursorMoved = true;
+	m_buildingGrid.Remove(id);
+	m_buildingBvh.Remove(id);
+	m_buildingRenderer.Remove(id);
+	m_buildings.Remove(id);
+}
 
-	// Check for collisions with existing buildings
-	for (const auto &building : m_buildings)
-	{
-		glm::vec2 existingSize = Buildings::GetBuildingSize(m_selectedBuildingType);
+void CMyApp::StoreTerrainBackup(uint32_t id, const TerrainRect &heightRect, const TerrainRect &splatRect)
+{
+	std::vector<float> heights(heightRect.GetWidth() * heightRect.GetHeight());
+	std::vector<glm::vec4> splat(splatRect.GetWidth() * splatRect.GetHeight());
+	m_terrain.CopyHeights(heightRect, heights.data());
+	m_terrain.CopySplat(splatRect, splat.data());
+	m_buildings.SetTerrainBackup(id, heightRect, heights.data(), splatRect, splat.data());
+}
 
-		glm::vec2 existingMin = glm::vec2(building.position.x, building.position.z) - existingSize * 0.5f;
-		glm::vec2 existingMax = glm::vec2(building.position.x, building.position.z) + existingSize * 0.5f;
+void CMyApp::DemolishBuilding(uint32_t id)
+{
+	DemolishBuildings({id});
+}
 
-		const float PADDING = 1.2f;
-		bool collision = (newMin.x < existingMax.x + PADDING &&
-											newMax.x + PADDING > existingMin.x &&
-											newMin.y < existingMax.y + PADDING &&
-											newMax.y + PADDING > existingMin.y);
+void CMyApp::DemolishSelectedBuildings()
+{
+	// Emptied first, so RemoveBuilding does not search it for every building it removes
+	std::vector<uint32_t> ids = std::move(m_selectedBuildings);
+	m_selectedBuildings.clear();
+	DemolishBuildings(ids);
+}
 
-		if (collision)
+void CMyApp::DemolishBuildings(const std::vector<uint32_t> &ids)
+{
+	bool editing = false;
+	for (uint32_t id : ids)
+	{
+		if (!m_buildings.Contains(id))
+			continue;
+		if (!editing)
 		{
-			return; // Don't place if collision detected
+			m_terrainJournal.BeginEdit();
+			editing = true;
 		}
-	}
 
-	// Calculate UV coordinates from world position
-	glm::vec2 uv(
-			(pos.x + 50.0f) / 100.0f,
-			(pos.z + 50.0f) / 100.0f);
+		uint32_t index = m_buildings.GetIndex(id);
+		BuildingChange change{BuildingChange::Kind::Demolished, id, m_buildings.GetTypes()[index], m_buildings.GetPositions()[index],
+													m_buildings.GetColors()[index], m_buildings.GetFootprints()[index],
+													m_buildings.GetHeightBackupRect(index), m_buildings.GetSplatBackupRect(index)};
+
+		// Put back the ground from before the building
+		const TerrainRect &heightRect = change.heightRect;
+		std::vector<float> flattenedHeights(heightRect.GetWidth() * heightRect.GetHeight());
+		m_terrain.CopyHeights(heightRect, flattenedHeights.data());
+		m_terrain.WriteHeights(heightRect, m_buildings.GetHeightBackup(index));
+		m_terrainJournal.AddHeights(m_terrain, heightRect, flattenedHeights.data());
+
+		const TerrainRect &splatRect = change.splatRect;
+		std::vector<glm::vec4> concreteSplat(splatRect.GetWidth() * splatRect.GetHeight());
+		std::vector<glm::vec4> originalSplat(concreteSplat.size());
+		m_terrain.CopySplat(splatRect, concreteSplat.data());
+		std::transform(m_buildings.GetSplatBackup(index), m_buildings.GetSplatBackup(index) + originalSplat.size(), originalSplat.begin(), UnpackSplat);
+		m_terrain.WriteSplat(splatRect, originalSplat.data());
+		m_terrainJournal.AddSplat(m_terrain, splatRect, concreteSplat.data());
+
+		RemoveBuilding(id);
+		m_terrainJournal.AddBuildingChange(change);
+	}
 
-	// Apply concrete texture around the building
-	ApplyConcreteTexture(uv, m_selectedBuildingType); // Convert radius to UV space
+	if (editing)
+		m_terrainJournal.CommitEdit();
+}
 
-	// Sample height from heightmap and smooth the terrain
-	float height = SmoothTerrainUnderBuilding(uv, buildingSize);
+void CMyApp::UndoEdit()
+{
+	std::vector<BuildingChange> *changes = m_terrainJournal.PeekUndo();
+	if (changes == nullptr)
+		return;
 
-	// Check if position is underwater
-	if (height < WATER_LEVEL)
+	// Recreated buildings back up the terrain as it is now, before the journal rolls it back
+	for (auto it = changes->rbegin(); it != changes->rend(); ++it)
 	{
-		return; // Don't place building underwater
+		if (it->kind == BuildingChange::Kind::Placed)
+		{
+			RemoveBuilding(it->id);
+		}
+		else
+		{
+			it->id = AddBuilding(it->type, it->position, it->color);
+			StoreTerrainBackup(it->id, it->heightRect, it->splatRect);
+		}
 	}
+	m_terrainJournal.Undo(m_terrain);
+}
+
+void CMyApp::RedoEdit()
+{
+	std::vector<BuildingChange> *changes = m_terrainJournal.PeekRedo();
+	if (changes == nullptr)
+		return;
 
-	// Create new building instance at the correct height
-	BuildingInstance newBuilding;
-	newBuilding.position = glm::vec3(pos.x, height, pos.z);
-	newBuilding.type = m_selectedBuildingType;
-	newBuilding.color = m_buildingColor;
+	for (BuildingChange &change : *changes)
+	{
+		if (change.kind == BuildingChange::Kind::Placed)
+		{
+			change.id = AddBuilding(change.type, change.position, change.color);
+			StoreTerrainBackup(change.id, change.heightRect, change.splatRect);
+		}
+		else
+		{
+			RemoveBuilding(change.id);
+		}
+	}
+	m_terrainJournal.Redo(m_terrain);
+}
 
-	m_buildings.push_back(newBuilding);
+PlacementRules CMyApp::GetPlacementRules() const
+{
+	PlacementRules rules;
+	rules.worldSize = 100.0f;
+	rules.heightScale = m_terrainHeightScale;
+	rules.heightOffset = m_terrainVerticalOffset - 25;
+	rules.waterLevel = WATER_LEVEL;
+	rules.maxSlope = m_buildingMaxSlope;
+	return rules;
 }
 
-float CMyApp::SmoothTerrainUnderBuilding(const glm::vec2 &centerUV, const glm::vec2 &size)
+TerrainRect CMyApp::GetFlattenRect(const glm::vec2 &centerUV, const glm::vec2 &size) const
 {
 	// Determine smoothing area
 	float radiusX = size.x / 100.0f + 0.005f;
@@ -1317,80 +2470,67 @@ float CMyApp::SmoothTerrainUnderBuilding(const glm::vec2 &centerUV, const glm::v
 	glm::vec2 minUV = glm::clamp(centerUV - glm::vec2(radiusX, radiusY), 0.0f, 1.0f);
 	glm::vec2 maxUV = glm::clamp(centerUV + glm::vec2(radiusX, radiusY), 0.0f, 1.0f);
 
-	// Get texture dimensions
-	GLint width, height;
-	glBindTexture(GL_TEXTURE_2D, m_heightmapTexture);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
-
-	int minX = static_cast<int>(minUV.x * (width - 1));
-	int maxX = static_cast<int>(maxUV.x * (width - 1));
-	int minY = static_cast<int>(minUV.y * (height - 1));
-	int maxY = static_cast<int>(maxUV.y * (height - 1));
-
-	// Get current height data
-	std::vector<float> heightData((maxX - minX + 1) * (maxY - minY + 1));
-	glGetTextureSubImage(m_heightmapTexture, 0, minX, minY, 0,
-											 maxX - minX + 1, maxY - minY + 1, 1,
-											 GL_RED, GL_FLOAT, heightData.size() * sizeof(float), heightData.data());
-
-	// Check for nearby buildings and find the closest one
-	float closestBuildingHeight = 0.0f;
-	float minDistance = FLT_MAX;
-	float overlapMargin = 0.02f; // in UV space
+	return m_terrain.GetTexelRect(minUV, maxUV);
+}
 
-	for (const auto &b : m_buildings)
+float CMyApp::GetFlattenedHeight(const TerrainRect &rect) const
+{
+	float sum = 0.0f;
+	for (int y = rect.minY; y < rect.maxY; ++y)
 	{
-		glm::vec2 bCenterUV = glm::vec2(b.position.x, b.position.z);
-		float distance = glm::distance(centerUV, bCenterUV);
-
-		if (distance < minDistance)
-		{
-			minDistance = distance;
-			if (!b.originalTerrainHeights.empty())
-			{
-				float sum = std::accumulate(b.originalTerrainHeights.begin(), b.originalTerrainHeights.end(), 0.0f);
-				closestBuildingHeight = sum / b.originalTerrainHeights.size();
-			}
-		}
+		const float *row = m_terrain.GetHeightData() + y * m_terrain.GetSize();
+		sum = std::accumulate(row + rect.minX, row + rect.maxX, sum);
 	}
+	float averageHeight = sum / (rect.GetWidth() * rect.GetHeight());
+
+	// Ensure the smoothed height is not below water level (convert water level to heightmap space)
+	float waterLevelInHeightmapSpace = (WATER_LEVEL - m_terrainVerticalOffset + 25) / m_terrainHeightScale;
+	return std::max(averageHeight, waterLevelInHeightmapSpace);
+}
 
+float CMyApp::SmoothTerrainUnderBuilding(const glm::vec2 &centerUV, const glm::vec2 &size, TerrainRect &flattenedRect, std::vector<float> &originalHeights)
+{
 	// If we're close to an existing building, use its height
-	const float MAX_DISTANCE_TO_MATCH_HEIGHT = 0.05f; // in UV space
-	if (minDistance < MAX_DISTANCE_TO_MATCH_HEIGHT && !m_buildings.empty())
+	glm::vec2 centerWorld = (centerUV - 0.5f) * 100.0f;
+	uint32_t closestBuilding;
+	if (m_buildingGrid.FindNearest(centerWorld, BUILDING_HEIGHT_MATCH_DISTANCE, closestBuilding))
 	{
 		// Don't modify terrain, just return the closest building's height
-		float finalHeight = (closestBuildingHeight * m_terrainHeightScale) + m_terrainVerticalOffset - 25;
+		float finalHeight = m_buildings.GetPositions()[m_buildings.GetIndex(closestBuilding)].y;
 		// Ensure the height is not below water level
 		return std::max(finalHeight, WATER_LEVEL);
 	}
 
 	// Otherwise, proceed with normal smoothing (for isolated buildings)
-	float sum = std::accumulate(heightData.begin(), heightData.end(), 0.0f);
-	float averageHeight = sum / heightData.size();
-
-	// Ensure the smoothed height is not below water level (convert water level to heightmap space)
-	float waterLevelInHeightmapSpace = (WATER_LEVEL - m_terrainVerticalOffset + 25) / m_terrainHeightScale;
-	averageHeight = std::max(averageHeight, waterLevelInHeightmapSpace);
-
-	std::fill(heightData.begin(), heightData.end(), averageHeight);
+	TerrainRect rect = GetFlattenRect(centerUV, size);
+	std::vector<float> heightData(rect.GetWidth() * rect.GetHeight());
+	m_terrain.CopyHeights(rect, heightData.data());
+	float averageHeight = GetFlattenedHeight(rect);
 
-	// Update texture
-	glTextureSubImage2D(m_heightmapTexture, 0, minX, minY,
-											maxX - minX + 1, maxY - minY + 1, GL_RED, GL_FLOAT, heightData.data());
-
-	// Store original heights for this new building
-	if (!m_buildings.empty())
+	for (int y = rect.minY; y < rect.maxY; ++y)
 	{
-		m_buildings.back().originalTerrainHeights = heightData;
+		std::fill_n(m_terrain.GetHeightData() + y * m_terrain.GetSize() + rect.minX, rect.GetWidth(), averageHeight);
 	}
+	m_terrain.MarkHeightsDirty(rect);
+
+	// Hand the original heights to the new building
+	flattenedRect = rect;
+	originalHeights = std::move(heightData);
 
-	float finalHeight = (averageHeight * m_terrainHeightScale) + m_terrainVerticalOffset - 25;
+	float finalHeight = BuildingPlacementRules::ToWorldHeight(GetPlacementRules(), averageHeight);
 	// Final safety check (shouldn't be needed but just in case)
 	return std::max(finalHeight, WATER_LEVEL);
 }
 
-void CMyApp::ApplyConcreteTexture(const glm::vec2 &centerUV, BuildingType buildingType)
+bool CMyApp::CollidesWithBuildings(const glm::vec3 &pos, BuildingType type) const
+{
+	// Footprint of the new building, grown by the padding on every side
+	glm::vec2 halfSize = Buildings::GetBuildingSize(type) * 0.5f + BUILDING_PADDING;
+	glm::vec2 center(pos.x, pos.z);
+	return m_buildingGrid.Overlaps(center - halfSize, center + halfSize);
+}
+
+TerrainRect CMyApp::GetConcreteRect(const glm::vec2 &centerUV, BuildingType buildingType) const
 {
 	// Get building dimensions from Buildings class
 	glm::vec2 buildingSize = Buildings::GetBuildingSize(buildingType);
@@ -1402,11 +2542,8 @@ void CMyApp::ApplyConcreteTexture(const glm::vec2 &centerUV, BuildingType buildi
 	// Convert size from world units to UV space (100 units = 1.0 in UV)
 	glm::vec2 sizeUV = concreteSize / 100.0f;
 
-	// Rest of your existing implementation...
-	GLint width, height;
-	glBindTexture(GL_TEXTURE_2D, m_splatmapTexture);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	const int width = m_terrain.GetSize();
+	const int height = m_terrain.GetSize();
 
 	int minX = static_cast<int>((centerUV.x - sizeUV.x / 2) * width);
 	int maxX = static_cast<int>((centerUV.x + sizeUV.x / 2) * width);
@@ -1419,80 +2556,83 @@ void CMyApp::ApplyConcreteTexture(const glm::vec2 &centerUV, BuildingType buildi
 	minY = glm::clamp(minY, 0, height - 1);
 	maxY = glm::clamp(maxY, 0, height - 1);
 
-	// Read current splatmap data
-	std::vector<glm::vec4> splatData((maxX - minX + 1) * (maxY - minY + 1));
-	glGetTextureSubImage(m_splatmapTexture, 0,
-											 minX, minY, 0,
-											 maxX - minX + 1, maxY - minY + 1, 1,
-											 GL_RGBA, GL_FLOAT,
-											 splatData.size() * sizeof(glm::vec4), splatData.data());
+	return TerrainRect{minX, minY, maxX + 1, maxY + 1};
+}
+
+TerrainRect CMyApp::ApplyConcreteTexture(const glm::vec2 &centerUV, BuildingType buildingType, std::vector<glm::vec4> &originalSplat)
+{
+	TerrainRect rect = GetConcreteRect(centerUV, buildingType);
+	originalSplat.resize(rect.GetWidth() * rect.GetHeight());
+	m_terrain.CopySplat(rect, originalSplat.data());
 
 	// Modify splatmap data
-	for (int y = minY; y <= maxY; y++)
+	for (int y = rect.minY; y < rect.maxY; y++)
 	{
-		for (int x = minX; x <= maxX; x++)
+		for (int x = rect.minX; x < rect.maxX; x++)
 		{
-			int idx = (y - minY) * (maxX - minX + 1) + (x - minX);
-
-			// Check if the texel is within the square area (no distance calculation)
-			// For a rectangular area, use different radii for X/Y (e.g., radiusX, radiusY)
-			splatData[idx].r *= 0.2f; // Reduce other textures
-			splatData[idx].g *= 0.2f;
-			splatData[idx].b *= 0.2f;
-			splatData[idx].a = 0.8f; // Max concrete weight
+			PaintConcrete(m_terrain.GetSplat(x, y));
 		}
 	}
 
-	// Update texture
-	glTextureSubImage2D(m_splatmapTexture, 0,
-											minX, minY,
-											maxX - minX + 1, maxY - minY + 1,
-											GL_RGBA, GL_FLOAT, splatData.data());
+	m_terrain.MarkSplatDirty(rect);
+	return rect;
 }
 
 void CMyApp::RenderBuildings()
 {
+	// Cull on the GPU, the draw below reads its commands without the CPU looking at any building
+	m_buildingRenderer.Upload();
+	if (m_buildingOcclusionCulling)
+		RenderTerrainOccluders();
+	glUseProgram(m_buildingCullProgram);
+	m_buildingRenderer.Cull(m_camera.GetViewProj(), m_camera.GetEye(), m_buildingCullDistance, m_buildingImpostorDistance,
+													m_buildingOcclusionCulling ? &m_terrainHiZ : nullptr);
+	glm::vec2 impostorRange = BuildingRenderer::GetImpostorRange(m_buildingImpostorDistance);
+
 	glUseProgram(m_programID);
 
-	// Bind building texture
-	glBindTextureUnit(0, m_buildingTextureID);
+	// Bind the building textures, every type picks its layer
+	glBindTextureUnit(0, Buildings::GetTextureArray());
 	glBindSampler(0, m_SamplerID);
 
-	// Render all placed buildings
-	for (const auto &building : m_buildings)
-	{
-		glm::mat4 world = glm::translate(building.position);
-		glUniformMatrix4fv(ul("world"), 1, GL_FALSE, glm::value_ptr(world));
-		glUniformMatrix4fv(ul("worldInvTransp"), 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::inverse(world))));
-		glUniformMatrix4fv(ul("viewProj"), 1, GL_FALSE, glm::value_ptr(m_camera.GetViewProj()));
-
-		// Pass building color to shader
-		glUniform3fv(glGetUniformLocation(m_programID, "buildingColor"), 1, glm::value_ptr(building.color));
+	// Shared by every building, so set once per frame
+	glUniformMatrix4fv(ul("viewProj"), 1, GL_FALSE, glm::value_ptr(m_camera.GetViewProj()));
+	SetLightingUniforms(32.0f, glm::vec3(0.1f), glm::vec3(0.8f), glm::vec3(0.5f));
+	glUniform2fv(ul("impostorRange"), 1, glm::value_ptr(impostorRange));
 
-		// Set material properties for buildings
-		SetLightingUniforms(32.0f, glm::vec3(0.1f), glm::vec3(0.8f), glm::vec3(0.5f));
+	// Render all placed buildings, one indirect draw per type in a single call
+	m_buildingRenderer.Draw();
 
-		const BuildingData &data = Buildings::GetBuildingData(building.type);
-		glBindVertexArray(data.vao);
-		glDrawArrays(GL_TRIANGLES, 0, data.vertexCount);
+	// Render building preview with current color, always as the full mesh
+	if (m_showBuildingPreview)
+	{
+		glUniform2f(ul("impostorRange"), 0.0f, 0.0f);
+		BuildingRenderer::DrawSingle(m_selectedBuildingType, m_buildingPreviewPos, m_buildingColor);
 	}
 
-	// Render building preview with current color
-	if (m_showBuildingPreview)
+	// Far buildings as impostors, from the same culled instances
+	if (impostorRange.y > 0.0f)
 	{
-		glm::mat4 world = glm::translate(m_buildingPreviewPos);
-		glUniformMatrix4fv(ul("world"), 1, GL_FALSE, glm::value_ptr(world));
-		glUniformMatrix4fv(ul("worldInvTransp"), 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::inverse(world))));
+		glUseProgram(m_impostorProgram);
+		glUniformMatrix4fv(ul("viewProj"), 1, GL_FALSE, glm::value_ptr(m_camera.GetViewProj()));
+		SetLightingUniforms(32.0f, glm::vec3(0.1f), glm::vec3(0.8f), glm::vec3(0.5f));
+		glUniform2fv(ul("impostorRange"), 1, glm::value_ptr(impostorRange));
+		glUniform1i(ul("viewsPerSide"), BuildingImpostors::VIEWS_PER_SIDE);
+		glUniform1i(ul("colorAtlas"), 0);
+		glUniform1i(ul("normalDepthAtlas"), 1);
 
-		// Use current building color for preview
-		glUniform3fv(glGetUniformLocation(m_programID, "buildingColor"), 1, glm::value_ptr(m_buildingColor));
+		// The atlases bring their own filtering, which stops at the views' borders
+		glBindSampler(0, 0);
+		glBindTextureUnit(0, m_buildingImpostors.GetColorTexture());
+		glBindTextureUnit(1, m_buildingImpostors.GetNormalDepthTexture());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_buildingImpostors.GetTypeBuffer());
 
-		const BuildingData &data = Buildings::GetBuildingData(m_selectedBuildingType);
-		glBindVertexArray(data.vao);
-		glDrawArrays(GL_TRIANGLES, 0, data.vertexCount);
+		m_buildingRenderer.DrawImpostors();
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+		glBindTextureUnit(1, 0);
 	}
 
-	glBindVertexArray(0);
 	glBindTextureUnit(0, 0);
 	glBindSampler(0, 0);
-}
\ No newline at end of file
+}
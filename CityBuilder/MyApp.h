@@ -19,6 +19,24 @@
 
 #include "Perlin.h"
 #include "buildings.hpp"
+#include "ThreadPool.h"
+#include "Benchmarks.h"
+#include "TerrainCache.h"
+#include "Terrain.h"
+#include "TerrainQuadtree.h"
+#include "TerrainTessellator.h"
+#include "GpuTimer.h"
+#include "BuildingRenderer.h"
+#include "BuildingImpostors.h"
+#include "BuildingGrid.h"
+#include "BuildingBvh.h"
+#include "BuildingPlacement.h"
+#include "BuildingRegistry.h"
+#include "ZoneFill.h"
+#include "TerrainJournal.h"
+#include "TerrainHeightPyramid.h"
+#include "ObjectIdBuffer.h"
+#include "GpuReadback.h"
 
 struct SUpdateInfo
 {
@@ -32,6 +50,9 @@ public:
 	CMyApp();
 	~CMyApp();
 
+	// Generate this world instead of a random one, and cache it on disk for the next launch
+	void SetWorldSeed(uint32_t seed);
+
 	bool Init();
 	void Clean();
 
@@ -52,6 +73,20 @@ public:
 protected:
 	void SetupDebugCallback();
 
+	// Worker threads for CPU-heavy jobs such as terrain generation
+	ThreadPool m_threadPool;
+
+	// GPU to CPU copies of object IDs, screenshots and GPU generated maps, delivered a frame or two after the request
+	static constexpr std::size_t READBACK_SLOT_SIZE = 64 * 1024;
+	GpuReadback m_gpuReadback;
+
+	// F12 saves the next frame to a BMP file
+	bool m_screenshotRequested = false;
+	void TakeScreenshot();
+
+	// Results of the last benchmark started from the GUI
+	std::vector<BenchmarkResult> m_benchmarkResults;
+
 	// Data variables
 
 	float m_ElapsedTimeInSec = 0.0f;
@@ -109,7 +144,6 @@ protected:
 
 	GLuint m_SkyboxTextureID = 0;
 	GLuint m_waterTextureID = 0;
-	GLuint m_buildingTextureID = 0;
 
 	void InitTextures();
 	void CleanTextures();
@@ -134,9 +168,39 @@ protected:
 	GLuint m_terrainIBO = 0;
 	size_t m_terrainIndexCount = 0;
 
+	// Heightmap and splatmap, queried and edited on the CPU
+	static constexpr int TERRAIN_MAP_SIZE = 1000;
+	Terrain m_terrain;
+
+	// Chunked LOD rendering, the finest nodes are 1/32 of the map with 32x32 quads each
+	static constexpr int TERRAIN_LOD_COUNT = 6;
+	static constexpr int TERRAIN_PATCH_RESOLUTION = 32;
+	TerrainQuadtree m_terrainQuadtree;
+	std::vector<TerrainPatch> m_terrainPatches;
+	float m_terrainLodDistance = 8.0f;
+
+	// Hardware tessellated alternative to the chunks
+	enum class TerrainRenderMode
+	{
+		Chunked,
+		Tessellated
+	};
+	static constexpr int TERRAIN_TESS_PATCHES = 64;
+	TerrainRenderMode m_terrainRenderMode = TerrainRenderMode::Chunked;
+	TerrainTessellator m_terrainTessellator;
+	float m_terrainTessEdgePixels = 12.0f;
+
+	// GPU time of the terrain draw, and the benchmark comparing the two render modes on it
+	static constexpr int TERRAIN_BENCHMARK_FRAMES = 120;
+	static constexpr int TERRAIN_BENCHMARK_WARMUP_FRAMES = 10;
+	GpuTimer m_terrainTimer;
+	int m_terrainBenchmarkFrame = -1; // -1 when not running
+	TerrainRenderMode m_terrainModeBeforeBenchmark = TerrainRenderMode::Chunked;
+	double m_terrainBenchmarkTimeMs[2] = {0.0, 0.0};
+	int m_terrainBenchmarkSamples[2] = {0, 0};
+	unsigned int m_terrainBenchmarkLastResult = 0;
+
 	// Textures
-	GLuint m_heightmapTexture = 0;
-	GLuint m_splatmapTexture = 0;
 	GLuint m_groundTextures[4] = {0};
 	GLuint m_rockTexture = 0;
 	GLuint m_sandTexture = 0;
@@ -144,11 +208,10 @@ protected:
 	GLuint m_concreteTexture = 0;
 
 	// Uniform locations
-	GLint m_ulTerrainWorld = -1;
-	GLint m_ulTerrainWorldIT = -1;
-	GLint m_ulTerrainViewProj = -1;
-	GLint m_ulTerrainHeightScale = -1;
-	GLint m_ulTerrainTexScale = -1;
+	GLint m_ulTerrainNodeOffset = -1;
+	GLint m_ulTerrainNodeSize = -1;
+	GLint m_ulTerrainPatchResolution = -1;
+	GLint m_ulTerrainMorphRange = -1;
 
 	// Terrain parameters
 	float m_terrainVerticalOffset = 4.0f;
@@ -157,43 +220,189 @@ protected:
 
 	// Shader program
 	GLuint m_terrainProgram = 0;
+	GLuint m_terrainTessProgram = 0;
+	GLuint m_terrainGenProgram = 0; // Compute shader filling the heightmap and splatmap
+
+	// Seed of the current world, the splatmap uses m_worldSeed + 1
+	uint32_t m_worldSeed = 0;
+	bool m_cacheTerrain = false;
+	bool m_generateTerrainOnGPU = false;
+	TerrainNoiseParams m_terrainNoise;
+	float m_terrainGenerationTimeMs = 0.0f;
+	bool m_terrainMapsPending = false; // GPU generated maps still on their way to the CPU
+	uint32_t m_terrainGeneration = 0;	 // Counts GenerateTerrainMaps calls, readbacks of older ones are ignored
+
+	// Heightmap/splatmap generation is split into jobs of this many rows
+	static constexpr int TERRAIN_ROWS_PER_JOB = 16;
 
 	void GenerateTerrain();
-	void GenerateHeightmap();
-	void GenerateSplatmap();
+	void GenerateTerrainMaps(bool loadFromCache = true); // false regenerates even if a cached copy exists
+	bool LoadTerrainMapsFromCache(const TerrainGenParams &params);
+	void GenerateHeightmap(unsigned seed);
+	void GenerateSplatmap(unsigned seed);
+	void GenerateTerrainMapsGPU(unsigned heightSeed, unsigned splatSeed);
+	void FinishTerrainMaps(const TerrainGenParams &params, bool writeCache); // Quadtree, tessellation patches, height pyramid and cache of the finished maps
 	void InitTerrainTextures();
 	void RenderTerrain();
+	void SelectTerrainPatches();
+	void RenderTerrainChunked();
+	void DrawTerrainPatches(GLint ulNodeOffset, GLint ulNodeSize, GLint ulMorphRange);
+	void DrawTerrainDepth(); // The chunked mesh with the bound Vert_Terrain program, no shading
+	void RenderTerrainOccluders();
+	void RenderTerrainTessellated();
+	void StartTerrainBenchmark();
+	void UpdateTerrainBenchmark();
 	void RenderBuildings();
 
-	struct BuildingInstance
-	{
-		glm::vec3 position;
-		BuildingType type;
-		glm::vec3 color;
-		std::vector<float> originalTerrainHeights; // Stores original terrain heights under building
-	};
-
-	std::vector<BuildingInstance> m_buildings;
-	BuildingType m_selectedBuildingType = SMALL_HOUSE;
-	glm::vec3 *m_pickData = nullptr; // For reading FBO data
+	BuildingRegistry m_buildings;
+	BuildingRenderer m_buildingRenderer; // Instance buffers of m_buildings, one per type
+	BuildingImpostors m_buildingImpostors;
+	BuildingGrid m_buildingGrid;				 // Footprints of m_buildings by ID, for collision and neighbour queries
+	static constexpr float BUILDING_GRID_CELL_SIZE = 2.0f;
+	BuildingBvh m_buildingBvh; // Boxes of the building meshes in world space, for ray casts and area selection
+	static constexpr float BUILDING_PADDING = 1.2f; // Free space kept between footprints
+
+	// Undo/redo history of placements and demolitions with the terrain they changed
+	static constexpr std::size_t TERRAIN_JOURNAL_MAX_BYTES = 64 * 1024 * 1024;
+	TerrainJournal m_terrainJournal;
+	int m_terrainJournalMaxEdits = 256;
+	GLuint m_buildingCullProgram = 0;
+	float m_buildingCullDistance = 0.0f; // 0 draws buildings at any distance
+	GLuint m_impostorBakeProgram = 0;
+	GLuint m_impostorProgram = 0;
+	float m_buildingImpostorDistance = 60.0f; // 0 draws every building as its mesh
+
+	// Depth pyramid of the terrain that buildings behind hills are culled against
+	HiZBuffer m_terrainHiZ;
+	GLuint m_terrainDepthProgram = 0;
+	GLuint m_hiZReduceProgram = 0;
+	bool m_buildingOcclusionCulling = true;
+	BuildingType m_selectedBuildingType = 0;
 	bool m_showBuildingPreview = true;
 	glm::vec3 m_buildingPreviewPos;
 	glm::vec3 m_buildingColor;
 
-	// FBO related
-	bool m_frameBufferCreated = false;
-	GLuint m_depthBuffer;
-	GLuint m_colorBuffer;
-	GLuint m_frameBuffer;
-	GLuint m_pickProgramID;
-
-	void CreateFrameBuffer(int width, int height);
+	// Terrain under the mouse, where the ray through the cursor meets the height pyramid. Motion events only remember
+	// the cursor, the ray is cast at most once a frame and only after the cursor or the camera moved
+	TerrainHeightPyramid m_terrainHeightPyramid;
+	glm::ivec2 m_cursor = glm::ivec2(0); // Window coordinates of the last mouse event
+	bool m_cursorMoved = true; // Or what lies under it changed, either way the ray is cast again
+	glm::mat4 m_pickViewProj = glm::mat4(0.0f); // Camera of the last pick
+	glm::vec3 m_cursorTerrainHit = glm::vec3(0.0f); // World position under the mouse, if m_cursorOnTerrain
+	glm::vec2 m_cursorTerrainPosition = glm::vec2(0.0f); // Its XZ
+	bool m_cursorOnTerrain = false;
+	uint32_t m_hoveredBuilding = BuildingRegistry::INVALID_ID; // First building box the ray hits before the terrain
+	float m_pickTimeUs = 0.0f;
+
+	TerrainQuadtree::WorldMapping GetTerrainMapping() const;
+	// World space ray through a window position, from the near plane towards the far one
+	void GetCursorRay(const glm::ivec2 &cursor, glm::vec3 &origin, glm::vec3 &direction);
+	void UpdatePick();
+
+	// Objects under clicks. A click is answered from the CPU copy of the ID buffer if it still shows this view,
+	// otherwise it waits for the next Render to draw the buffer and for the readback of it
+	enum class ObjectPickAction
+	{
+		Select,
+		Demolish
+	};
+	struct ObjectPick
+	{
+		glm::ivec2 cursor;
+		ObjectPickAction action;
+	};
+	ObjectIdBuffer m_objectIds;
+	GLuint m_buildingPickProgram = 0;
+	GLuint m_terrainPickProgram = 0;
+	glm::mat4 m_objectIdViewProj = glm::mat4(0.0f); // Camera of the last ID pass
+	bool m_objectIdsStale = true;										// Buildings or terrain changed since the last ID pass
+	bool m_objectIdsInFlight = false;
+	int m_objectIdPassCount = 0;
+	std::vector<ObjectPick> m_pendingObjectPicks;
+	glm::ivec2 m_selectPressCursor = glm::ivec2(-1); // Where a plain left press went down, a click if it comes up nearby
+	static constexpr int SELECT_CLICK_TOLERANCE = 3;	// Pixels
+	uint32_t m_selectedObject = ObjectIdBuffer::NO_OBJECT;
+
+	// Area selection: Shift + left drag a rectangle, or click polygon corners as for a zone fill and press Shift + Enter
+	std::vector<uint32_t> m_selectedBuildings;
+	bool m_areaSelecting = false;
+	glm::ivec2 m_areaSelectStartCursor = glm::ivec2(0);
+	glm::vec2 m_areaSelectStart = glm::vec2(0.0f);
+
+	bool AreObjectIdsCurrent() const;
+	void PickObject(const glm::ivec2 &cursor, ObjectPickAction action);
+	void RenderObjectIds();
+	void HandleObjectPick(const ObjectPick &pick);
+	void RenderSelectionGUI();
+	void DrawGroundOutline(const std::vector<glm::vec2> &corners, uint32_t color); // color is an IM_COL32
+	void DrawBuildingOutline(uint32_t id, uint32_t color);
 	void UpdateBuildingPreview(const glm::vec3 &pos);
 	void PlaceBuilding(const glm::vec3 &pos);
+
+	// Place many buildings as one edit: the candidates are validated against the ground and the placed buildings
+	// in parallel, then the terrain, the registry and the instances change in one go. A candidate colliding with
+	// an earlier one of the batch is skipped. Returns the number placed
+	std::size_t PlaceBuildings(const std::vector<BuildingPlacement> &candidates);
+	void ScatterBuildings(int count);
+
+	// A candidate of PlaceBuildings, as placing it alone would go
+	struct PlacementEvaluation
+	{
+		bool valid = false;
+		bool flatten = false; // Flattens heightRect to flatHeight, or takes the height of a building nearby
+		float flatHeight = 0.0f;
+		float height = 0.0f; // World height of the building
+		TerrainRect heightRect;
+		TerrainRect splatRect;
+	};
+
+	struct BulkPlacementStats
+	{
+		std::size_t candidateCount = 0;
+		std::size_t placedCount = 0;
+		double milliseconds = 0.0;
+	};
+	BulkPlacementStats m_lastBulkPlacement;
+	static constexpr int PLACEMENTS_PER_JOB = 256;
+	static constexpr int PLACEMENT_BAND_ROWS = 32;
+	static constexpr float BUILDING_HEIGHT_MATCH_DISTANCE = 5.0f; // Closer buildings share their height instead of flattening
+	float m_buildingMaxSlope = 0.6f;
+
+	// Zone fill: Alt + left drag a rectangle, or Alt + right click the corners of a polygon and press Enter
+	std::vector<glm::vec2> m_zoneCorners; // Polygon clicked so far
+	bool m_zoneDragging = false;
+	glm::vec2 m_zoneDragStart = glm::vec2(0.0f);
+	bool m_zoneFillAllTypes = true;						// Otherwise only the selected type
+	int m_zoneFillAttempts = 30;
+
+	struct ZoneFillStats
+	{
+		std::size_t sampleCount = 0;
+		double samplingMilliseconds = 0.0;
+	};
+	ZoneFillStats m_lastZoneFill;
+
+	void FillZone(const BuildingZone &zone);
+	void DrawZoneOutline();
+
+	PlacementRules GetPlacementRules() const;
+	TerrainRect GetFlattenRect(const glm::vec2 &centerUV, const glm::vec2 &size) const;
+	float GetFlattenedHeight(const TerrainRect &rect) const; // Normalized mean height, not below the water
+	TerrainRect GetConcreteRect(const glm::vec2 &centerUV, BuildingType buildingType) const;
 	void GetViewportSize(int &width, int &height);
 	float SampleHeightmap(const glm::vec2 &uv);
-	void ApplyConcreteTexture(const glm::vec2 &centerUV, BuildingType buildingType);
-	float SmoothTerrainUnderBuilding(const glm::vec2 &centerUV, const glm::vec2 &size);
+	TerrainRect ApplyConcreteTexture(const glm::vec2 &centerUV, BuildingType buildingType, std::vector<glm::vec4> &originalSplat);
+	float SmoothTerrainUnderBuilding(const glm::vec2 &centerUV, const glm::vec2 &size, TerrainRect &flattenedRect, std::vector<float> &originalHeights);
+	bool CollidesWithBuildings(const glm::vec3 &pos, BuildingType type) const;
+	uint32_t AddBuilding(BuildingType type, const glm::vec3 &position, const glm::vec3 &color);
+	void RemoveBuilding(uint32_t id);
+	void StoreTerrainBackup(uint32_t id, const TerrainRect &heightRect, const TerrainRect &splatRect);
+	void DemolishBuilding(uint32_t id);
+	// One undoable edit, the IDs that are gone already are skipped
+	void DemolishBuildings(const std::vector<uint32_t> &ids);
+	void DemolishSelectedBuildings(); // The area selection, which ends with it
+	void UndoEdit();
+	void RedoEdit();
 
 	const float WATER_LEVEL = -0.8f;
 };
@@ -0,0 +1,53 @@
+#version 430
+
+in vec3 worldPosition;
+in vec2 atlasCoords;
+flat in vec3 buildingColor;
+flat in float atlasLayer;
+flat in float impostorFade;
+flat in vec3 viewDirection;
+flat in float radius;
+
+out vec4 outputColor;
+
+uniform sampler2DArray colorAtlas;
+uniform sampler2DArray normalDepthAtlas;
+uniform mat4 viewProj;
+
+// Frag_BuildingShading.frag
+vec4 ShadeBuilding(vec3 position, vec3 normal, vec4 texColor, vec3 buildingColor);
+float CrossFadeThreshold();
+
+// Inverse of the octahedral mapping in Frag_ImpostorBake.frag
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    // The complement of the pixels the mesh keeps in Frag_LightingNoFaceCull.frag
+    if (CrossFadeThreshold() >= impostorFade)
+        discard;
+
+    vec3 atlasCoords3 = vec3(atlasCoords, atlasLayer);
+    vec4 normalDepth = texture(normalDepthAtlas, atlasCoords3);
+    float coverage = normalDepth.a;
+    if (coverage < 0.5)
+        discard;
+
+    // Filtered texels at the silhouette are mixed with the empty background, dividing by the coverage undoes that
+    normalDepth.rgb /= coverage;
+    vec4 texColor = texture(colorAtlas, atlasCoords3) / coverage;
+    vec3 normal = OctDecode(normalDepth.rg * 2.0 - 1.0);
+
+    // The quad goes through the bounding sphere's center, the baked depth runs over its diameter
+    vec3 position = worldPosition + viewDirection * radius * (1.0 - 2.0 * normalDepth.b);
+    vec4 clipPosition = viewProj * vec4(position, 1.0);
+    gl_FragDepth = clipPosition.z / clipPosition.w * 0.5 + 0.5;
+
+    outputColor = ShadeBuilding(position, normal, texColor, buildingColor);
+}
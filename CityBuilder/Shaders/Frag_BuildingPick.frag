@@ -1,11 +1,11 @@
-#version 430 core
+#version 450 core
 
-in vec2 uv;
+// Object ID of a building, see ObjectIdBuffer
 
-layout(location = 0) out vec3 outColor;
+flat in uint buildingId;
 
-uniform int buildingID;
+layout(location = 0) out uint outObject;
 
 void main() {
-    outColor = vec3(uv, float(buildingID + 1)/255.0);
-}
\ No newline at end of file
+    outObject = 0x80000000u | buildingId;
+}
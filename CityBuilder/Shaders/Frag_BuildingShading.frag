@@ -0,0 +1,146 @@
+#version 430
+
+// Lighting of building fragments, linked into the building programs next to their own fragment shader
+
+uniform vec3 cameraPosition;
+
+// Sun light properties
+uniform vec4 lightPosition = vec4(0.0, 1.0, 0.0, 0.0);
+uniform vec3 La = vec3(0.6, 0.6, 0.7);  // Sun ambient (used for day ambient)
+uniform vec3 Ld = vec3(1.0, 1.0, 1.0);
+uniform vec3 Ls = vec3(1.0, 1.0, 1.0);
+
+// Moon light properties
+uniform vec4 moonLightPosition = vec4(0.0, -1.0, 0.0, 0.0);
+uniform vec3 moonLa = vec3(0.1, 0.1, 0.15);  // Moon ambient (used for night ambient)
+uniform vec3 moonLd = vec3(0.2, 0.2, 0.3);
+uniform vec3 moonLs = vec3(0.3, 0.3, 0.4);
+
+// material properties
+uniform vec3 Ka = vec3(1.0);
+uniform vec3 Kd = vec3(1.0);
+uniform vec3 Ks = vec3(1.0);
+uniform float Shininess = 1.0;
+
+struct LightProperties
+{
+    vec4 pos;
+    vec3 La;
+    vec3 Ld;
+    vec3 Ls;
+    float constantAttenuation;
+    float linearAttenuation;
+    float quadraticAttenuation;
+};
+
+struct MaterialProperties
+{
+    vec3 Ka;
+    vec3 Kd;
+    vec3 Ks;
+    float Shininess;
+};
+
+vec3 lighting(LightProperties light, vec3 position, vec3 normal, MaterialProperties material)
+{
+    vec3 ToLight;
+    float LightDistance = 0.0;
+    
+    if (light.pos.w == 0.0) // directional light
+    {
+        ToLight = light.pos.xyz;
+    }
+    else // point light
+    {
+        ToLight = light.pos.xyz - position;
+        LightDistance = length(ToLight);
+    }
+    
+    ToLight = normalize(ToLight);
+    
+    float Attenuation = 1.0 / (light.constantAttenuation + 
+                              light.linearAttenuation * LightDistance + 
+                              light.quadraticAttenuation * LightDistance * LightDistance);
+    
+    // Ambient component
+    vec3 Ambient = light.La * material.Ka;
+
+    // Diffuse component
+    float DiffuseFactor = max(dot(ToLight, normal), 0.0) * Attenuation;
+    vec3 Diffuse = DiffuseFactor * light.Ld * material.Kd;
+    
+    // Specular component
+    vec3 viewDir = normalize(cameraPosition - position);
+    vec3 reflectDir = reflect(-ToLight, normal);
+    float SpecularFactor = pow(max(dot(viewDir, reflectDir), 0.0), material.Shininess) * Attenuation;
+    vec3 Specular = SpecularFactor * light.Ls * material.Ks;
+
+    return Ambient + Diffuse + Specular;
+}
+
+// Lit color of a building fragment, texColor.a masks where the building color applies
+vec4 ShadeBuilding(vec3 position, vec3 normal, vec4 texColor, vec3 buildingColor)
+{
+    // Determine if it's day or night based on sun position
+    bool isDay = lightPosition.y > -0.2; // Sun is above horizon
+    
+    // Use sun's La for day ambient and moon's La for night ambient
+    vec3 globalAmbient = isDay ? La : moonLa;
+
+    // Set up sun light
+    LightProperties sunLight;
+    sunLight.pos = lightPosition;
+    sunLight.La = vec3(0.0); // Using global ambient instead
+    sunLight.Ld = Ld;
+    sunLight.Ls = Ls;
+    sunLight.constantAttenuation = 1.0;
+    sunLight.linearAttenuation = 0.0;
+    sunLight.quadraticAttenuation = 0.0;
+
+    // Set up moon light (only active at night)
+    LightProperties moonLight;
+    moonLight.pos = moonLightPosition;
+    moonLight.La = vec3(0.0); // Using global ambient instead
+    moonLight.Ld = isDay ? vec3(0.0) : moonLd;
+    moonLight.Ls = isDay ? vec3(0.0) : moonLs;
+    moonLight.constantAttenuation = 1.0;
+    moonLight.linearAttenuation = 0.0;
+    moonLight.quadraticAttenuation = 0.0;
+
+    // Material properties
+    MaterialProperties material;
+    material.Ka = Ka;
+    material.Kd = Kd;
+    material.Ks = Ks;
+    material.Shininess = Shininess;
+
+    // Calculate lighting from both sources
+    vec3 sunShading = lighting(sunLight, position, normal, material);
+    vec3 moonShading = lighting(moonLight, position, normal, material);
+    
+    // Combine the lighting results with global ambient
+    vec3 shadedColor = globalAmbient * material.Ka + sunShading + moonShading;
+    
+    // Apply building color based on alpha mask
+    // Where alpha is 0 (windows), use original texture color
+    // Where alpha > 0 (walls, roof), blend between texture and building color
+    float colorBlend = texColor.a; // Use alpha channel as blend factor
+    vec3 finalColor = mix(texColor.rgb * 2.0, texColor.rgb * buildingColor, colorBlend);
+    
+    // Combine with lighting
+    vec4 outputColor = vec4(shadedColor * finalColor, texColor.a);
+    
+    // Ensure minimum visibility even at night
+    float minVisibility = isDay ? 0.15 : 0.05;
+    outputColor.rgb = max(outputColor.rgb, vec3(minVisibility) * finalColor);
+
+    return outputColor;
+}
+
+// Ordered dither threshold of the fragment in (0, 1), the same pixel gets the same value in every pass
+float CrossFadeThreshold()
+{
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+}
@@ -0,0 +1,31 @@
+#version 430
+
+in vec3 normal;
+in vec2 textureCoords;
+flat in float textureLayer;
+
+layout(location = 0) out vec4 outputColor;
+layout(location = 1) out vec4 outputNormalDepth;
+
+uniform sampler2DArray textureImage;
+
+// Octahedral mapping of a unit vector to [-1, 1]^2, the same as in Buildings.cpp
+vec2 OctEncode(vec3 n)
+{
+    vec3 v = n / (abs(n.x) + abs(n.y) + abs(n.z));
+    vec2 e = v.xy;
+    if (v.z < 0.0)
+        e = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+void main()
+{
+    vec3 n = normalize(normal);
+    if (!gl_FrontFacing)
+        n = -n;
+
+    // The orthographic projection of the bake keeps the window depth linear along the view
+    outputColor = texture(textureImage, vec3(textureCoords, textureLayer));
+    outputNormalDepth = vec4(OctEncode(n) * 0.5 + 0.5, gl_FragCoord.z, 1.0);
+}
@@ -2,9 +2,10 @@
 
 in vec2 texCoord;
 in vec3 worldPos;
-in vec3 worldNormal;
 in float heightValue;
 
+uniform mat4 world;
+uniform sampler2D normalMap; // Height differences (left - right, down - up), see Terrain
 uniform sampler2D splatmap;
 uniform sampler2D groundTextures[4];
 uniform sampler2D rockTexture;
@@ -27,6 +28,10 @@ uniform vec3 Kd;
 out vec4 fragColor;
 
 void main() {
+    // Per-fragment normal, so coarse LOD geometry still gets full resolution shading
+    vec2 heightDelta = texture(normalMap, texCoord).rg;
+    vec3 worldNormal = normalize(mat3(world) * normalize(vec3(heightDelta.x, 2.0, heightDelta.y)));
+
     // Sample splatmap to get texture weights
     vec4 weights = texture(splatmap, texCoord);
     
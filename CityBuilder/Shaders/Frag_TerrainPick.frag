@@ -0,0 +1,13 @@
+#version 450 core
+
+// Object ID of the terrain, see ObjectIdBuffer: object 0 with the heightmap UV in the other bits,
+// 16 bits of u and 15 bits of v
+
+in vec2 texCoord;
+
+layout(location = 0) out uint outObject;
+
+void main() {
+    uvec2 uv = uvec2(round(clamp(texCoord, 0.0, 1.0) * vec2(65535.0, 32767.0)));
+    outObject = uv.x | (uv.y << 16);
+}
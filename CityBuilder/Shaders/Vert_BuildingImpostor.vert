@@ -0,0 +1,66 @@
+#version 430
+
+// Per-instance attributes, see BuildingRenderer
+layout( location = 3 ) in vec3 instancePosition;
+layout( location = 4 ) in vec3 instanceColor;
+
+// Buildings::GetBoundingSphere of every type, see BuildingImpostors
+layout( std430, binding = 0 ) readonly buffer ImpostorTypes
+{
+	vec4 boundingSpheres[];
+};
+
+out vec3 worldPosition;
+out vec2 atlasCoords;
+flat out vec3 buildingColor;
+flat out float atlasLayer;
+flat out float impostorFade; // 0 full mesh, 1 fully replaced by the impostor
+flat out vec3 viewDirection; // Of the atlas view, from the building towards the camera
+flat out float radius;
+
+uniform mat4 viewProj;
+uniform vec3 cameraPosition;
+uniform vec2 impostorRange; // Cross-fade band between mesh and impostor
+uniform int viewsPerSide;	 // BuildingImpostors::VIEWS_PER_SIDE
+
+// Inverse hemi-octahedral mapping of BuildingImpostors::GetViewDirection
+vec3 HemiOctDecode( vec2 e )
+{
+	vec2 p = vec2( e.x + e.y, e.x - e.y ) * 0.5;
+	return normalize( vec3( p.x, 1.0 - abs( p.x ) - abs( p.y ), p.y ) );
+}
+
+void main()
+{
+	// BuildingRenderer draws the impostors of type t from vertices 4t to 4t + 3
+	int type = gl_VertexID / 4;
+	int corner = gl_VertexID % 4;
+	vec4 sphere = boundingSpheres[type];
+	vec3 center = instancePosition + sphere.xyz;
+
+	// The view whose direction is closest to the camera's, cameras below the horizon get the lowest row
+	vec3 toCamera = cameraPosition - center;
+	toCamera.y = max( toCamera.y, 0.0 );
+	vec3 v = toCamera / max( abs( toCamera.x ) + abs( toCamera.y ) + abs( toCamera.z ), 1e-5 );
+	vec2 e = vec2( v.x + v.z, v.x - v.z );
+	ivec2 view = clamp( ivec2( ( e * 0.5 + 0.5 ) * float( viewsPerSide ) ), ivec2( 0 ), ivec2( viewsPerSide - 1 ) );
+	vec3 direction = HemiOctDecode( ( vec2( view ) + 0.5 ) / float( viewsPerSide ) * 2.0 - 1.0 );
+
+	// Same basis as the bake camera of the view
+	vec3 right = direction.y > 0.999 ? vec3( 1, 0, 0 ) : normalize( cross( vec3( 0, 1, 0 ), direction ) );
+	vec3 up = cross( direction, right );
+
+	vec2 quad = vec2( corner == 1 || corner == 2 ? 1.0 : -1.0, corner >= 2 ? 1.0 : -1.0 );
+	worldPosition = center + ( right * quad.x + up * quad.y ) * sphere.w;
+	atlasCoords = ( vec2( view ) + quad * 0.5 + 0.5 ) / float( viewsPerSide );
+
+	buildingColor = instanceColor;
+	atlasLayer = float( type );
+	viewDirection = direction;
+	radius = sphere.w;
+
+	// Same distance as Comp_BuildingCull.comp uses to pick the LOD
+	impostorFade = clamp( ( distance( instancePosition, cameraPosition ) - impostorRange.x ) / ( impostorRange.y - impostorRange.x ), 0.0, 1.0 );
+
+	gl_Position = viewProj * vec4( worldPosition, 1 );
+}
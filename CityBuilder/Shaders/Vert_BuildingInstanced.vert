@@ -0,0 +1,45 @@
+#version 430
+
+// Mesh attributes, quantized in Buildings::PackedVertex
+layout( location = 0 ) in vec4 inputObjectSpacePosition; // w is the texture layer
+layout( location = 1 ) in vec2 inputOctahedralNormal;
+layout( location = 2 ) in vec2 inputTextureCoords;
+
+// Per-instance attributes, see BuildingRenderer
+layout( location = 3 ) in vec3 instancePosition;
+layout( location = 4 ) in vec3 instanceColor;
+
+out vec3 worldPosition;
+out vec3 worldNormal;
+out vec2 textureCoords;
+flat out vec3 buildingColor;
+flat out float textureLayer;
+flat out float impostorFade; // 0 full mesh, 1 fully replaced by the impostor
+
+uniform mat4 viewProj;
+uniform vec3 cameraPosition;
+uniform vec2 impostorRange; // Cross-fade band between mesh and impostor, y = 0 disables impostors
+
+// Inverse of the octahedral mapping in Buildings.cpp
+vec3 OctDecode( vec2 e )
+{
+	vec3 n = vec3( e, 1.0 - abs( e.x ) - abs( e.y ) );
+	if ( n.z < 0.0 )
+		n.xy = ( 1.0 - abs( n.yx ) ) * vec2( n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0 );
+	return normalize( n );
+}
+
+void main()
+{
+	// Buildings are only translated, so the normal needs no transformation
+	worldPosition = inputObjectSpacePosition.xyz + instancePosition;
+	worldNormal = OctDecode( inputOctahedralNormal );
+	textureCoords = inputTextureCoords;
+	buildingColor = instanceColor;
+	textureLayer = inputObjectSpacePosition.w;
+
+	// Same distance as Comp_BuildingCull.comp uses to pick the LOD
+	impostorFade = impostorRange.y > 0.0 ? clamp( ( distance( instancePosition, cameraPosition ) - impostorRange.x ) / ( impostorRange.y - impostorRange.x ), 0.0, 1.0 ) : 0.0;
+
+	gl_Position = viewProj * vec4( worldPosition, 1 );
+}
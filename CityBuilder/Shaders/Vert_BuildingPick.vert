@@ -0,0 +1,25 @@
+#version 450
+
+// Every placed building for the object ID pass, see BuildingRenderer::DrawIds
+
+// Mesh position of Buildings::PackedVertex, w is the texture layer
+layout( location = 0 ) in vec4 inputObjectSpacePosition;
+
+// Per-instance position, see BuildingRenderer
+layout( location = 3 ) in vec3 instancePosition;
+
+// BuildingRegistry ID of every instance of the drawn type
+layout( std430, binding = 0 ) readonly buffer BuildingIds
+{
+	uint buildingIds[];
+};
+
+flat out uint buildingId;
+
+uniform mat4 viewProj;
+
+void main()
+{
+	buildingId = buildingIds[ gl_InstanceID ];
+	gl_Position = viewProj * vec4( inputObjectSpacePosition.xyz + instancePosition, 1 );
+}
@@ -0,0 +1,29 @@
+#version 430
+
+// Mesh attributes, quantized in Buildings::PackedVertex
+layout( location = 0 ) in vec4 inputObjectSpacePosition; // w is the texture layer
+layout( location = 1 ) in vec2 inputOctahedralNormal;
+layout( location = 2 ) in vec2 inputTextureCoords;
+
+out vec3 normal;
+out vec2 textureCoords;
+flat out float textureLayer;
+
+uniform mat4 viewProj; // One view of BuildingImpostors::Bake
+
+// Inverse of the octahedral mapping in Buildings.cpp
+vec3 OctDecode( vec2 e )
+{
+	vec3 n = vec3( e, 1.0 - abs( e.x ) - abs( e.y ) );
+	if ( n.z < 0.0 )
+		n.xy = ( 1.0 - abs( n.yx ) ) * vec2( n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0 );
+	return normalize( n );
+}
+
+void main()
+{
+	normal = OctDecode( inputOctahedralNormal );
+	textureCoords = inputTextureCoords;
+	textureLayer = inputObjectSpacePosition.w;
+	gl_Position = viewProj * vec4( inputObjectSpacePosition.xyz, 1 );
+}
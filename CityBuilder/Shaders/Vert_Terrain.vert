@@ -1,5 +1,6 @@
 #version 450 core
 
+// Grid position inside the patch, in [0, 1]
 layout(location = 0) in vec2 vtxUV;
 
 uniform mat4 world;
@@ -8,33 +9,42 @@ uniform sampler2D heightmap;
 uniform float heightScale;
 uniform float verticalOffset; // New uniform for vertical movement
 
+// Quadtree node the patch covers, see TerrainQuadtree
+uniform vec2 nodeOffset;
+uniform float nodeSize;
+uniform float patchResolution; // Quads along a patch edge
+uniform vec2 morphRange;       // Distances where morphing to the coarser level starts and ends
+uniform vec3 cameraPos;
+
 out vec2 texCoord;
 out vec3 worldPos;
-out vec3 worldNormal;
 out float heightValue;
 
+vec3 TerrainPosition(vec2 uv, float height) {
+    return vec3(
+        uv.x - 0.5,
+        (height * heightScale - heightScale/2.0) + verticalOffset, // Add offset here
+        uv.y - 0.5
+    );
+}
+
 void main() {
+    // Morph odd grid vertices onto the coarser grid as the distance approaches the end of the LOD range
+    vec2 gridPos = vtxUV * patchResolution;
+    vec2 uv = nodeOffset + vtxUV * nodeSize;
+    vec3 unmorphedPos = (world * vec4(TerrainPosition(uv, texture(heightmap, uv).r), 1.0)).xyz;
+    float morphK = clamp((distance(unmorphedPos, cameraPos) - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    gridPos -= fract(gridPos * 0.5) * 2.0 * morphK;
+    uv = nodeOffset + gridPos / patchResolution * nodeSize;
+
     // Sample heightmap (unchanged)
-    heightValue = texture(heightmap, vtxUV).r;
+    heightValue = texture(heightmap, uv).r;
     
     // Calculate world position with vertical offset
-    vec3 pos = vec3(
-        vtxUV.x - 0.5, 
-        (heightValue * heightScale - heightScale/2.0) + verticalOffset, // Add offset here
-        vtxUV.y - 0.5
-    );
+    vec3 pos = TerrainPosition(uv, heightValue);
     
     worldPos = (world * vec4(pos, 1.0)).xyz;
     
-    // Normal calculation remains unchanged
-    float hL = textureOffset(heightmap, vtxUV, ivec2(-1, 0)).r;
-    float hR = textureOffset(heightmap, vtxUV, ivec2(1, 0)).r;
-    float hD = textureOffset(heightmap, vtxUV, ivec2(0, -1)).r;
-    float hU = textureOffset(heightmap, vtxUV, ivec2(0, 1)).r;
-    
-    vec3 normal = normalize(vec3(hL - hR, 2.0, hD - hU));
-    worldNormal = normalize(mat3(world) * normal);
-    
-    texCoord = vtxUV;
+    texCoord = uv;
     gl_Position = viewProj * vec4(worldPos, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,10 @@
+#version 450 core
+
+// Control point of a tessellated terrain patch, in heightmap UV
+layout(location = 0) in vec2 vtxUV;
+
+out vec2 controlUV;
+
+void main() {
+    controlUV = vtxUV;
+}
@@ -11,6 +11,8 @@
 #include <imgui_impl_opengl3.h>
 
 // Standard
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
@@ -141,6 +143,14 @@ int main(int argc, char *args[])
 
 		// Application instance
 		CMyApp app;
+
+		// --seed <number> selects a reproducible world, which is also cached on disk
+		for (int i = 1; i + 1 < argc; ++i)
+		{
+			if (std::strcmp(args[i], "--seed") == 0)
+				app.SetWorldSeed(static_cast<uint32_t>(std::strtoul(args[i + 1], nullptr, 10)));
+		}
+
 		if (!app.Init())
 		{
 			SDL_GL_DeleteContext(context);